@@ -0,0 +1,390 @@
+/*
+ * Microbenchmarks for the core hot paths, built and run with `make bench`.
+ * Results are printed to stdout as one line of key=value pairs per measurement,
+ * diagnostic output from the core is only shown with the -v flag.
+ * Optionally, the names of the benchmarks to run may be passed as arguments.
+ */
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#define MM_API __attribute__((visibility("default")))
+
+#define BACKEND_NAME "bench"
+#include "midimonster.h"
+#include "core/backend.h"
+#include "core/routing.h"
+#include "core/config.h"
+
+static uint8_t verbose = 0;
+static uint64_t delivered = 0;
+
+MM_API int log_printf(int level, char* module, char* fmt, ...){
+	int rv = 0;
+	va_list args;
+
+	if(!verbose){
+		return 0;
+	}
+
+	va_start(args, fmt);
+	fprintf(stderr, "%s%s\t", (level & MM_LOG_DEBUG) ? "debug/" : "", module);
+	rv = vfprintf(stderr, fmt, args);
+	va_end(args);
+	return rv;
+}
+
+static uint64_t bench_clock_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_result(char* name, char* parameter, uint64_t value, uint64_t ops, uint64_t nsecs){
+	printf("bench=%s %s=%" PRIu64 " ops=%" PRIu64 " nsecs=%" PRIu64 " ns_per_op=%.2f ops_per_sec=%.0f\n",
+			name, parameter, value, ops, nsecs,
+			ops ? (double) nsecs / ops : 0.0,
+			nsecs ? ops * 1000000000.0 / nsecs : 0.0);
+	fflush(stdout);
+}
+
+/* Minimal backend, counting all delivered events */
+static int bench_configure(char* option, char* value){
+	return 0;
+}
+
+static int bench_configure_instance(instance* inst, char* option, char* value){
+	return 0;
+}
+
+static int bench_instance(instance* inst){
+	return 0;
+}
+
+static channel* bench_channel(instance* inst, char* spec, uint8_t flags){
+	return mm_channel(inst, strtoul(spec, NULL, 10), 1);
+}
+
+static channel* bench_channel_restore(instance* inst, uint64_t ident, uint8_t flags){
+	return mm_channel(inst, ident, 1);
+}
+
+static int bench_set(instance* inst, size_t num, channel** c, channel_value* v){
+	delivered += num;
+	return 0;
+}
+
+static int bench_handle(size_t num, managed_fd* fds){
+	return 0;
+}
+
+static int bench_start(size_t n, instance** inst){
+	return 0;
+}
+
+static int bench_shutdown(size_t n, instance** inst){
+	return 0;
+}
+
+static int bench_setup(size_t instances, instance** inst){
+	size_t u;
+	char name[32];
+	backend bench = {
+		.name = BACKEND_NAME,
+		.conf = bench_configure,
+		.create = bench_instance,
+		.conf_instance = bench_configure_instance,
+		.channel = bench_channel,
+		.channel_restore = bench_channel_restore,
+		.handle = bench_set,
+		.process = bench_handle,
+		.start = bench_start,
+		.shutdown = bench_shutdown,
+		.flags = mmbackend_no_polling
+	};
+
+	delivered = 0;
+	if(mm_backend_register(bench)){
+		return 1;
+	}
+
+	for(u = 0; u < instances; u++){
+		inst[u] = mm_instance(backend_match(BACKEND_NAME));
+		if(!inst[u]){
+			return 1;
+		}
+		snprintf(name, sizeof(name), "b%" PRIsize_t, u);
+		inst[u]->name = strdup(name);
+		inst[u]->ident = u;
+	}
+	return 0;
+}
+
+static void bench_teardown(){
+	routing_cleanup();
+	backends_stop();
+}
+
+/* Channel store lookup and creation */
+static int bench_channels(){
+	size_t u, n = 1 << 18;
+	uint64_t start;
+	instance* inst[4];
+
+	if(bench_setup(4, inst)){
+		return 1;
+	}
+
+	start = bench_clock_ns();
+	for(u = 0; u < n; u++){
+		if(!mm_channel(inst[u % 4], u / 4, 1)){
+			return 1;
+		}
+	}
+	bench_result("channel_create", "channels", n, n, bench_clock_ns() - start);
+
+	start = bench_clock_ns();
+	for(u = 0; u < n; u++){
+		if(!mm_channel(inst[(u * 7) % 4], ((u * 7) % n) / 4, 0)){
+			return 1;
+		}
+	}
+	bench_result("channel_lookup", "channels", n, n, bench_clock_ns() - start);
+
+	start = bench_clock_ns();
+	for(u = 0; u < n; u++){
+		if(mm_channel(inst[u % 4], n + u, 0)){
+			return 1;
+		}
+	}
+	bench_result("channel_miss", "channels", n, n, bench_clock_ns() - start);
+
+	bench_teardown();
+	return 0;
+}
+
+/* Routing one source channel to a varying number of destinations, including delivery */
+static int bench_fanout(){
+	size_t u, f, fanout[] = {1, 8, 64, 512};
+	uint64_t start, events = 1 << 18;
+	instance* inst[2];
+	channel* source = NULL;
+	channel_value v = {
+		.normalised = 0.5
+	};
+
+	for(f = 0; f < sizeof(fanout) / sizeof(fanout[0]); f++){
+		if(bench_setup(2, inst)){
+			return 1;
+		}
+
+		source = mm_channel(inst[0], 0, 1);
+		for(u = 0; u < fanout[f]; u++){
+			if(mm_map_channel(source, mm_channel(inst[1], u, 1), NULL)){
+				return 1;
+			}
+		}
+
+		if(routing_compile() || routing_collector_start()){
+			return 1;
+		}
+
+		//deliver in batches, as the core would between iterations
+		start = bench_clock_ns();
+		for(u = 0; u < events / fanout[f]; u++){
+			v.raw.u64 = u;
+			if(mm_channel_event(source, v)){
+				return 1;
+			}
+			if(!(u % 64) && routing_iteration()){
+				return 1;
+			}
+		}
+		while(routing_pending()){
+			if(routing_iteration()){
+				return 1;
+			}
+		}
+		bench_result("channel_event", "fanout", fanout[f], delivered, bench_clock_ns() - start);
+
+		if(delivered != (events / fanout[f]) * fanout[f]){
+			fprintf(stderr, "Fan-out %" PRIsize_t " delivered %" PRIu64 " events, expected %" PRIu64 "\n",
+					fanout[f], delivered, (events / fanout[f]) * fanout[f]);
+			return 1;
+		}
+		bench_teardown();
+	}
+	return 0;
+}
+
+/* Grouping events by instance before calling the backend handlers */
+static int bench_notify(){
+	size_t u, i, rounds, nev = 4096, instances[] = {1, 16, 256};
+	uint64_t start;
+	instance* inst[256];
+	channel** c = calloc(nev, sizeof(channel*));
+	channel_value* v = calloc(nev, sizeof(channel_value));
+
+	if(!c || !v){
+		free(c);
+		free(v);
+		return 1;
+	}
+
+	for(i = 0; i < sizeof(instances) / sizeof(instances[0]); i++){
+		if(bench_setup(instances[i], inst)){
+			return 1;
+		}
+
+		//interleave events for all instances
+		for(u = 0; u < nev; u++){
+			c[u] = mm_channel(inst[u % instances[i]], u, 1);
+		}
+
+		start = bench_clock_ns();
+		for(rounds = 0; rounds < 256; rounds++){
+			if(backends_notify(nev, c, v)){
+				return 1;
+			}
+		}
+		bench_result("backends_notify", "instances", instances[i], rounds * nev, bench_clock_ns() - start);
+		bench_teardown();
+	}
+
+	free(c);
+	free(v);
+	return 0;
+}
+
+/* Parsing and compiling large generated configuration files */
+static int bench_config(){
+	size_t u, l, lines[] = {1000, 10000, 100000};
+	uint64_t start, parsed;
+	char path[] = "/tmp/mmbenchXXXXXX", compiled[] = "/tmp/mmbenchXXXXXX";
+	instance* inst[1];
+	FILE* cfg = NULL;
+	int fd;
+
+	for(l = 0; l < sizeof(lines) / sizeof(lines[0]); l++){
+		fd = mkstemp(path);
+		cfg = (fd >= 0) ? fdopen(fd, "w") : NULL;
+		if(!cfg){
+			fprintf(stderr, "Failed to create temporary configuration file\n");
+			return 1;
+		}
+
+		//one third of the mappings use channel ranges
+		for(u = 0; u < 16; u++){
+			fprintf(cfg, "[bench i%" PRIsize_t "]\n", u);
+		}
+		fprintf(cfg, "[map]\n");
+		for(u = 0; u < lines[l]; u++){
+			if(u % 3){
+				fprintf(cfg, "i%" PRIsize_t ".%" PRIsize_t " > i%" PRIsize_t ".%" PRIsize_t "\n", u % 16, u, (u + 1) % 16, u);
+			}
+			else{
+				fprintf(cfg, "i%" PRIsize_t ".{%" PRIsize_t "..%" PRIsize_t "} > i%" PRIsize_t ".{1..8}\n", u % 16, u * 8, u * 8 + 7, (u + 3) % 16);
+			}
+		}
+		fclose(cfg);
+
+		if(bench_setup(0, inst)){
+			unlink(path);
+			return 1;
+		}
+
+		start = bench_clock_ns();
+		if(config_read(path)){
+			unlink(path);
+			return 1;
+		}
+		parsed = bench_clock_ns() - start;
+		bench_result("config_read", "lines", lines[l], lines[l], parsed);
+
+		start = bench_clock_ns();
+		if(routing_compile()){
+			unlink(path);
+			return 1;
+		}
+		bench_result("routing_compile", "lines", lines[l], lines[l], bench_clock_ns() - start);
+		config_free();
+		bench_teardown();
+
+		//load the same mappings from a compiled configuration
+		fd = mkstemp(compiled);
+		if(fd < 0){
+			fprintf(stderr, "Failed to create temporary compiled configuration\n");
+			unlink(path);
+			return 1;
+		}
+		close(fd);
+
+		if(bench_setup(0, inst) || config_compile(path, compiled)){
+			goto bail;
+		}
+		config_free();
+		bench_teardown();
+
+		if(bench_setup(0, inst)){
+			goto bail;
+		}
+
+		start = bench_clock_ns();
+		if(config_read(compiled)){
+			goto bail;
+		}
+		bench_result("config_load", "lines", lines[l], lines[l], bench_clock_ns() - start);
+
+		start = bench_clock_ns();
+		if(routing_compile()){
+			goto bail;
+		}
+		bench_result("routing_load", "lines", lines[l], lines[l], bench_clock_ns() - start);
+
+		unlink(path);
+		unlink(compiled);
+		strncpy(path, "/tmp/mmbenchXXXXXX", sizeof(path));
+		strncpy(compiled, "/tmp/mmbenchXXXXXX", sizeof(compiled));
+		config_free();
+		bench_teardown();
+	}
+	return 0;
+
+bail:
+	unlink(path);
+	unlink(compiled);
+	return 1;
+}
+
+int main(int argc, char** argv){
+	size_t u;
+	int rv = 0, first, arg, selected;
+	struct {
+		char* name;
+		int (*run)();
+	} benchmarks[] = {
+		{"channels", bench_channels},
+		{"fanout", bench_fanout},
+		{"notify", bench_notify},
+		{"config", bench_config}
+	};
+
+	for(first = 1; first < argc && !strcmp(argv[first], "-v"); first++){
+		verbose = 1;
+	}
+
+	for(u = 0; u < sizeof(benchmarks) / sizeof(benchmarks[0]) && !rv; u++){
+		//run all benchmarks unless specific ones were requested
+		for(selected = (first == argc), arg = first; !selected && arg < argc; arg++){
+			selected = !strcmp(argv[arg], benchmarks[u].name);
+		}
+
+		if(selected){
+			rv = benchmarks[u].run();
+			if(rv){
+				fprintf(stderr, "Benchmark %s failed\n", benchmarks[u].name);
+			}
+		}
+	}
+	return rv;
+}
@@ -10,11 +10,12 @@
 #define MAX_FDS 255
 
 static struct {
-	uint32_t next_frame;
 	uint8_t default_net;
 	size_t fds;
 	artnet_descriptor* fd;
 	uint8_t detect;
+	//instance lookup token
+	size_t instances;
 } global_cfg = {
 	0
 };
@@ -71,11 +72,12 @@ MM_PLUGIN_API int init(){
 		.create = artnet_instance,
 		.conf_instance = artnet_configure_instance,
 		.channel = artnet_channel,
+		.channel_range = artnet_channel_range,
 		.handle = artnet_set,
 		.process = artnet_handle,
 		.start = artnet_start,
-		.interval = artnet_interval,
-		.shutdown = artnet_shutdown
+		.shutdown = artnet_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe
 	};
 
 	if(sizeof(artnet_instance_id) != sizeof(uint64_t)){
@@ -91,13 +93,6 @@ MM_PLUGIN_API int init(){
 	return 0;
 }
 
-static uint32_t artnet_interval(){
-	if(global_cfg.next_frame){
-		return global_cfg.next_frame;
-	}
-	return ARTNET_KEEPALIVE_INTERVAL;
-}
-
 static int artnet_configure(char* option, char* value){
 	char* host = NULL, *port = NULL, *fd_opts = NULL;
 	struct sockaddr_storage announce = {0};
@@ -253,6 +248,34 @@ static channel* artnet_channel(instance* inst, char* spec, uint8_t flags){
 	return data->data.channel + chan_a;
 }
 
+static size_t artnet_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
+	size_t u;
+
+	//wide channels are only handled by the single channel parser
+	if(*prefix || *suffix || !first || first + count - 1 > 512){
+		return 0;
+	}
+	first--;
+
+	//let the single channel parser report mode conflicts
+	for(u = first; u < first + count; u++){
+		if(IS_ACTIVE(data->data.map[u]) && data->data.map[u] != (MAP_SINGLE | u)){
+			return 0;
+		}
+	}
+
+	if((flags & mmchannel_output) && !data->dest_len){
+		LOGPF("Channels %s.%" PRIu64 " to %" PRIu64 " mapped for output, but instance is not configured for output (missing destination)", inst->name, first + 1, first + count);
+	}
+
+	for(u = 0; u < count; u++){
+		data->data.map[first + u] = MAP_SINGLE | (first + u);
+		channels[u] = data->data.channel + first + u;
+	}
+	return count;
+}
+
 static int artnet_transmit(instance* inst, artnet_output_universe* output){
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
 
@@ -280,23 +303,45 @@ static int artnet_transmit(instance* inst, artnet_output_universe* output){
 			return 1;
 		}
 		//reschedule frame output
-		output->mark = 1;
-		if(!global_cfg.next_frame || global_cfg.next_frame > ARTNET_SYNTHESIZE_MARGIN){
-			global_cfg.next_frame = ARTNET_SYNTHESIZE_MARGIN;
+		return mm_timer_add(inst, mm_timestamp() + ARTNET_SYNTHESIZE_MARGIN, artnet_output_timer);
+	}
+
+	inst->stats.bytes_out += sizeof(frame);
+	inst->stats.packets_out++;
+
+	//update last frame timestamp, schedule next keepalive
+	output->last_frame = mm_timestamp_us();
+	return mm_timer_add(inst, mm_timestamp() + ARTNET_KEEPALIVE_INTERVAL, artnet_output_timer);
+}
+
+static artnet_output_universe* artnet_output(instance* inst){
+	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
+	size_t u;
+
+	for(u = 0; u < global_cfg.fd[data->fd_index].output_instances; u++){
+		if(global_cfg.fd[data->fd_index].output_instance[u].label == inst->ident){
+			return global_cfg.fd[data->fd_index].output_instance + u;
 		}
-		return 0;
 	}
+	return NULL;
+}
 
-	//update last frame timestamp
-	output->last_frame = mm_timestamp();
-	output->mark = 0;
+static int artnet_output_timer(instance* inst){
+	artnet_output_universe* output = artnet_output(inst);
+
+	//transmit keepalive or synthesized frame, transient network errors must not stop the keepalives
+	if(output && artnet_transmit(inst, output)){
+		LOGPF("Retrying output for instance %s in %d msec", inst->name, ARTNET_KEEPALIVE_INTERVAL);
+		return mm_timer_add(inst, mm_timestamp() + ARTNET_KEEPALIVE_INTERVAL, artnet_output_timer);
+	}
 	return 0;
 }
 
 static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v){
-	uint32_t frame_delta = 0;
+	uint64_t frame_delta = 0;
 	size_t u, mark = 0, channel_offset = 0;
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
+	artnet_output_universe* output = NULL;
 
 	if(!data->dest_len){
 		LOGPF("Instance %s not enabled for output (%" PRIsize_t " channel events)", inst->name, num);
@@ -326,35 +371,27 @@ static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v)
 
 	if(mark){
 		//find output control data for the instance
-		for(u = 0; u < global_cfg.fd[data->fd_index].output_instances; u++){
-			if(global_cfg.fd[data->fd_index].output_instance[u].label == inst->ident){
-				break;
-			}
-		}
+		output = artnet_output(inst);
 
 		if(!data->realtime){
-			frame_delta = mm_timestamp() - global_cfg.fd[data->fd_index].output_instance[u].last_frame;
+			frame_delta = mm_timestamp_us() - output->last_frame;
 
 			//check output rate limit, request next frame
-			if(frame_delta < ARTNET_FRAME_TIMEOUT){
-				global_cfg.fd[data->fd_index].output_instance[u].mark = 1;
-				if(!global_cfg.next_frame || global_cfg.next_frame > (ARTNET_FRAME_TIMEOUT - frame_delta)){
-					global_cfg.next_frame = (ARTNET_FRAME_TIMEOUT - frame_delta);
-				}
-				return 0;
+			if(frame_delta < ARTNET_FRAME_TIMEOUT * 1000){
+				return mm_timer_add(inst, (output->last_frame + (ARTNET_FRAME_TIMEOUT + ARTNET_SYNTHESIZE_MARGIN) * 1000 + 999) / 1000, artnet_output_timer);
 			}
 		}
-		return artnet_transmit(inst, global_cfg.fd[data->fd_index].output_instance + u);
+		return artnet_transmit(inst, output);
 	}
 
 	return 0;
 }
 
 static inline int artnet_process_dmx(instance* inst, artnet_dmx* frame){
-	size_t p, max_mark = 0;
+	size_t p, max_mark = 0, events = 0;
 	uint16_t wide_val = 0;
-	channel* chan = NULL;
-	channel_value val;
+	channel* chan[512];
+	channel_value val[512];
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
 
 	if(!data->last_input && global_cfg.detect){
@@ -380,9 +417,9 @@ static inline int artnet_process_dmx(instance* inst, artnet_dmx* frame){
 	for(p = 0; p <= max_mark; p++){
 		if(data->data.map[p] & MAP_MARK){
 			data->data.map[p] &= ~MAP_MARK;
-			chan = data->data.channel + p;
+			chan[events] = data->data.channel + p;
 			if(data->data.map[p] & MAP_FINE){
-				chan = data->data.channel + MAPPED_CHANNEL(data->data.map[p]);
+				chan[events] = data->data.channel + MAPPED_CHANNEL(data->data.map[p]);
 			}
 
 			if(IS_WIDE(data->data.map[p])){
@@ -390,21 +427,23 @@ static inline int artnet_process_dmx(instance* inst, artnet_dmx* frame){
 				wide_val = data->data.in[p] << ((data->data.map[p] & MAP_COARSE) ? 8 : 0);
 				wide_val |= data->data.in[MAPPED_CHANNEL(data->data.map[p])] << ((data->data.map[p] & MAP_COARSE) ? 0 : 8);
 
-				val.raw.u64 = wide_val;
-				val.normalised = (double) wide_val / (double) 0xFFFF;
+				val[events].raw.u64 = wide_val;
+				val[events].normalised = (double) wide_val / (double) 0xFFFF;
 			}
 			else{
 				//single channel
-				val.raw.u64 = data->data.in[p];
-				val.normalised = (double) data->data.in[p] / 255.0;
-			}
-
-			if(mm_channel_event(chan, val)){
-				LOG("Failed to push channel event to core");
-				return 1;
+				val[events].raw.u64 = data->data.in[p];
+				val[events].normalised = (double) data->data.in[p] / 255.0;
 			}
+			events++;
 		}
 	}
+
+	//push all events for this frame at once
+	if(events && mm_channel_events(events, chan, val)){
+		LOG("Failed to push channel events to core");
+		return 1;
+	}
 	return 0;
 }
 
@@ -440,7 +479,7 @@ static int artnet_process_poll(uint8_t fd, struct sockaddr* source, socklen_t so
 	frame.port = htole16(be16toh(announce->sin_port));
 
 	//prepare listing of all instances on this socket
-	if(mm_backend_instances(BACKEND_NAME, &n, &instances)){
+	if(mm_backend_instances_borrow(BACKEND_NAME, &n, &instances)){
 		LOG("Failed to query backend instances");
 		return 1;
 	}
@@ -489,38 +528,6 @@ static int artnet_process_poll(uint8_t fd, struct sockaddr* source, socklen_t so
 			i++;
 		}
 	}
-
-	free(instances);
-	return 0;
-}
-
-static int artnet_maintenance(){
-	size_t u, c;
-	uint64_t timestamp = mm_timestamp();
-	uint32_t synthesize_delta = 0;
-	instance* inst = NULL;
-
-	//transmit keepalive & synthesized frames
-	global_cfg.next_frame = 0;
-	for(u = 0; u < global_cfg.fds; u++){
-		for(c = 0; c < global_cfg.fd[u].output_instances; c++){
-			synthesize_delta = timestamp - global_cfg.fd[u].output_instance[c].last_frame;
-			if((global_cfg.fd[u].output_instance[c].mark
-						&& synthesize_delta >= ARTNET_FRAME_TIMEOUT + ARTNET_SYNTHESIZE_MARGIN) //synthesize next frame
-					|| synthesize_delta >= ARTNET_KEEPALIVE_INTERVAL){ //keepalive timeout
-				inst = mm_instance_find(BACKEND_NAME, global_cfg.fd[u].output_instance[c].label);
-				if(inst){
-					artnet_transmit(inst, global_cfg.fd[u].output_instance + c);
-				}
-			}
-
-			//update next_frame
-			if(global_cfg.fd[u].output_instance[c].mark
-					&& (!global_cfg.next_frame || global_cfg.next_frame > ARTNET_FRAME_TIMEOUT + ARTNET_SYNTHESIZE_MARGIN - synthesize_delta)){
-				global_cfg.next_frame = ARTNET_FRAME_TIMEOUT + ARTNET_SYNTHESIZE_MARGIN - synthesize_delta;
-			}
-		}
-	}
 	return 0;
 }
 
@@ -536,10 +543,6 @@ static int artnet_handle(size_t num, managed_fd* fds){
 	instance* inst = NULL;
 	artnet_dmx* frame = (artnet_dmx*) recv_buf;
 
-	if(artnet_maintenance()){
-		return 1;
-	}
-
 	for(u = 0; u < num; u++){
 		do{
 			bytes_read = recvfrom(fds[u].fd, recv_buf, sizeof(recv_buf), 0, (struct sockaddr*) &peer_addr, &peer_len);
@@ -550,7 +553,12 @@ static int artnet_handle(size_t num, managed_fd* fds){
 					inst_id.fields.fd_index = ((uint64_t) fds[u].impl) & 0xFF;
 					inst_id.fields.net = frame->net;
 					inst_id.fields.uni = frame->universe;
-					inst = mm_instance_find(BACKEND_NAME, inst_id.label);
+					inst = mm_instance_lookup(global_cfg.instances, inst_id.label);
+					if(inst){
+						inst->stats.bytes_in += bytes_read;
+						inst->stats.packets_in++;
+					}
+
 					if(inst && artnet_process_dmx(inst, frame)){
 						LOG("Failed to process DMX frame");
 					}
@@ -622,12 +630,22 @@ static int artnet_start(size_t n, instance** inst){
 			}
 			global_cfg.fd[data->fd_index].output_instance[global_cfg.fd[data->fd_index].output_instances].label = id.label;
 			global_cfg.fd[data->fd_index].output_instance[global_cfg.fd[data->fd_index].output_instances].last_frame = 0;
-			global_cfg.fd[data->fd_index].output_instance[global_cfg.fd[data->fd_index].output_instances].mark = 0;
 
 			global_cfg.fd[data->fd_index].output_instances++;
+
+			//send the initial keepalive frame on the first iteration
+			if(mm_timer_add(inst[u], mm_timestamp(), artnet_output_timer)){
+				goto bail;
+			}
 		}
 	}
 
+	//all identifiers are set, index them for the receive path
+	global_cfg.instances = mm_instance_namespace(BACKEND_NAME);
+	if(!global_cfg.instances){
+		goto bail;
+	}
+
 	LOGPF("Registering %" PRIsize_t " descriptors to core", global_cfg.fds);
 	for(u = 0; u < global_cfg.fds; u++){
 		if(mm_manage_fd(global_cfg.fd[u].fd, BACKEND_NAME, 1, (void*) u)){
@@ -4,15 +4,16 @@
 #include "midimonster.h"
 
 MM_PLUGIN_API int init();
-static uint32_t artnet_interval();
 static int artnet_configure(char* option, char* value);
 static int artnet_configure_instance(instance* instance, char* option, char* value);
 static int artnet_instance(instance* inst);
 static channel* artnet_channel(instance* instance, char* spec, uint8_t flags);
+static size_t artnet_channel_range(instance* instance, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
 static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int artnet_handle(size_t num, managed_fd* fds);
 static int artnet_start(size_t n, instance** inst);
 static int artnet_shutdown(size_t n, instance** inst);
+static int artnet_output_timer(instance* inst);
 
 #define ARTNET_PORT "6454"
 #define ARTNET_VERSION 14
@@ -64,8 +65,7 @@ typedef union /*_artnet_instance_id*/ {
 
 typedef struct /*_artnet_fd_universe*/ {
 	uint64_t label;
-	uint64_t last_frame;
-	uint8_t mark;
+	uint64_t last_frame; //in microseconds, see mm_timestamp_us
 } artnet_output_universe;
 
 typedef struct /*_artnet_fd*/ {
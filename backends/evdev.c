@@ -34,7 +34,8 @@ MM_PLUGIN_API int init(){
 		.handle = evdev_set,
 		.process = evdev_handle,
 		.start = evdev_start,
-		.shutdown = evdev_shutdown
+		.shutdown = evdev_shutdown,
+		.flags = mmbackend_no_polling
 	};
 
 	if(sizeof(evdev_channel_ident) != sizeof(uint64_t)){
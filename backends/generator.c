@@ -0,0 +1,346 @@
+#define BACKEND_NAME "generator"
+
+#include <string.h>
+#include "generator.h"
+
+MM_PLUGIN_API int init(){
+	backend generator = {
+		.name = BACKEND_NAME,
+		.conf = generator_configure,
+		.create = generator_instance,
+		.conf_instance = generator_configure_instance,
+		.channel = generator_channel,
+		.channel_range = generator_channel_range,
+		.channel_restore = generator_channel_restore,
+		.handle = generator_set,
+		.process = generator_handle,
+		.start = generator_start,
+		.shutdown = generator_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe | mmbackend_shard_instances
+	};
+
+	//register backend
+	if(mm_backend_register(generator)){
+		LOG("Failed to register backend");
+		return 1;
+	}
+	return 0;
+}
+
+static int generator_configure(char* option, char* value){
+	LOG("This backend does not take global configuration");
+	return 1;
+}
+
+static int generator_configure_instance(instance* inst, char* option, char* value){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+	char* next = value;
+
+	if(!strcmp(option, "channels")){
+		if(data->channel){
+			LOGPF("Channel count for instance %s must be set before mapping any channels", inst->name);
+			return 1;
+		}
+		data->channels = strtoul(value, &next, 10);
+		if(!data->channels || *next){
+			LOGPF("Invalid channel count %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "rate")){
+		data->rate = strtoull(value, &next, 10);
+		if(*next){
+			LOGPF("Invalid event rate %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "pattern")){
+		if(!strcmp(value, "ramp")){
+			data->pattern = pattern_ramp;
+		}
+		else if(!strcmp(value, "random")){
+			data->pattern = pattern_random;
+		}
+		else if(!strcmp(value, "burst")){
+			data->pattern = pattern_burst;
+		}
+		else if(!strcmp(value, "universe")){
+			data->pattern = pattern_universe;
+		}
+		else{
+			LOGPF("Unknown pattern %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "burst")){
+		data->burst = strtoul(value, &next, 10);
+		if(!data->burst || data->burst > GENERATOR_MAX_BATCH || *next){
+			LOGPF("Invalid burst size %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "interval")){
+		data->interval = strtoul(value, &next, 10);
+		if(!data->interval || *next){
+			LOGPF("Invalid interval %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "seed")){
+		data->seed = strtoull(value, &next, 10);
+		if(!data->seed || *next){
+			LOGPF("Invalid random seed %s for instance %s, must be non-zero", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+
+	LOGPF("Unknown instance option %s for instance %s", option, inst->name);
+	return 1;
+}
+
+static int generator_instance(instance* inst){
+	generator_instance_data* data = calloc(1, sizeof(generator_instance_data));
+	if(!data){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	data->channels = GENERATOR_DEFAULT_CHANNELS;
+	data->rate = GENERATOR_DEFAULT_RATE;
+	data->pattern = pattern_ramp;
+	data->interval = 1;
+	data->seed = 1;
+	inst->impl = data;
+	return 0;
+}
+
+static int generator_channels_alloc(instance* inst){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+	size_t u;
+
+	if(data->channel){
+		return 0;
+	}
+
+	data->channel = calloc(data->channels, sizeof(channel));
+	if(!data->channel){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	for(u = 0; u < data->channels; u++){
+		data->channel[u].instance = inst;
+		data->channel[u].ident = u;
+	}
+	return 0;
+}
+
+static channel* generator_channel(instance* inst, char* spec, uint8_t flags){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+	char* next = spec;
+	size_t index = strtoul(spec, &next, 10);
+
+	if(*next || !index || index > data->channels){
+		LOGPF("Invalid channel specification %s for instance %s, valid channels are 1 to %" PRIsize_t, spec, inst->name, data->channels);
+		return NULL;
+	}
+
+	if(flags & mmchannel_output){
+		LOGPF("Channel %s.%s mapped for output, events sent to generator instances are ignored", inst->name, spec);
+	}
+
+	if(generator_channels_alloc(inst)){
+		return NULL;
+	}
+	return data->channel + index - 1;
+}
+
+static size_t generator_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+	size_t u;
+
+	//let the single channel parser report invalid specifications
+	if(*prefix || *suffix || !first || first + count - 1 > data->channels){
+		return 0;
+	}
+
+	if(flags & mmchannel_output){
+		LOGPF("Channels %s.%" PRIu64 " to %" PRIu64 " mapped for output, events sent to generator instances are ignored", inst->name, first, first + count - 1);
+	}
+
+	if(generator_channels_alloc(inst)){
+		return 0;
+	}
+
+	for(u = 0; u < count; u++){
+		channels[u] = data->channel + first - 1 + u;
+	}
+	return count;
+}
+
+static channel* generator_channel_restore(instance* inst, uint64_t ident, uint8_t flags){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+
+	//the identifier is the channel index
+	if(ident >= data->channels){
+		LOGPF("Channel %" PRIu64 " of instance %s is not configured", ident + 1, inst->name);
+		return NULL;
+	}
+
+	if(generator_channels_alloc(inst)){
+		return NULL;
+	}
+	return data->channel + ident;
+}
+
+static int generator_set(instance* inst, size_t num, channel** c, channel_value* v){
+	//output to generator channels is ignored
+	return 0;
+}
+
+static int generator_handle(size_t num, managed_fd* fds){
+	//events are generated from timers
+	return 0;
+}
+
+static uint64_t generator_random(generator_instance_data* data){
+	//xorshift64, reproducible for a given seed
+	data->random ^= data->random << 13;
+	data->random ^= data->random >> 7;
+	data->random ^= data->random << 17;
+	return data->random;
+}
+
+//number of events that are always generated together
+static size_t generator_group(generator_instance_data* data){
+	switch(data->pattern){
+		case pattern_burst:
+			return data->burst ? data->burst : data->channels;
+		case pattern_universe:
+			return data->channels;
+		default:
+			return 1;
+	}
+}
+
+static size_t generator_due(generator_instance_data* data){
+	size_t group = min(generator_group(data), GENERATOR_MAX_BATCH);
+	uint64_t target, due;
+
+	//without a rate limit, one full set of channels is generated per iteration
+	if(!data->rate){
+		due = max(data->channels, group);
+	}
+	else{
+		target = (uint64_t) ((double) data->rate * (mm_timestamp_us() - data->start) / 1000000.0);
+		due = target - data->generated;
+		//do not try to catch up with events that could not be generated in time
+		if(due > data->batch){
+			DBGPF("Generator falling behind by %" PRIu64 " events", due - data->batch);
+			data->generated = target - data->batch;
+			due = data->batch;
+		}
+	}
+
+	//only generate complete groups
+	due = min(due, data->batch);
+	return due - (due % group);
+}
+
+static int generator_timer(instance* inst){
+	generator_instance_data* data = (generator_instance_data*) inst->impl;
+	size_t u, due = generator_due(data);
+	uint64_t step;
+
+	for(u = 0; u < due; u++){
+		if(data->pattern == pattern_random){
+			data->batch_channel[u] = data->channel + (generator_random(data) % data->channels);
+			data->batch_value[u].normalised = (generator_random(data) >> 11) * (1.0 / 9007199254740992.0);
+		}
+		else{
+			//channels are set round-robin, every channel ramps up one step per round
+			step = data->sequence / data->channels;
+			data->batch_channel[u] = data->channel + (data->sequence % data->channels);
+			data->batch_value[u].normalised = (double) (step % GENERATOR_RAMP_STEPS) / (GENERATOR_RAMP_STEPS - 1);
+		}
+		data->sequence++;
+		//the raw value carries a sequence number, which the sink backend can use to verify ordering
+		data->batch_value[u].raw.u64 = data->sequence;
+	}
+
+	if(due){
+		data->generated += due;
+		if(mm_channel_events(due, data->batch_channel, data->batch_value)){
+			return 1;
+		}
+	}
+
+	//reschedule, without a rate limit the timer is dispatched in the next iteration
+	return mm_timer_add(inst, mm_timestamp() + (data->rate ? data->interval : 0), generator_timer);
+}
+
+static int generator_start(size_t n, instance** inst){
+	size_t u;
+	generator_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (generator_instance_data*) inst[u]->impl;
+		if(generator_channels_alloc(inst[u])){
+			return 1;
+		}
+
+		//rate-limited instances may need to catch up after a delayed timer
+		data->batch = data->rate ? GENERATOR_MAX_BATCH : min(max(generator_group(data), data->channels), GENERATOR_MAX_BATCH);
+		data->batch_channel = calloc(data->batch, sizeof(channel*));
+		data->batch_value = calloc(data->batch, sizeof(channel_value));
+		if(!data->batch_channel || !data->batch_value){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+
+		if(data->pattern == pattern_universe && data->channels > GENERATOR_MAX_BATCH){
+			LOGPF("Instance %s generates universes of more than %d channels, reduce the channel count", inst[u]->name, GENERATOR_MAX_BATCH);
+			return 1;
+		}
+
+		data->random = data->seed;
+		data->start = mm_timestamp_us();
+		if(mm_timer_add(inst[u], mm_timestamp() + data->interval, generator_timer)){
+			return 1;
+		}
+
+		if(data->rate){
+			LOGPF("Instance %s generating %" PRIu64 " events per second on %" PRIsize_t " channels", inst[u]->name, data->rate, data->channels);
+		}
+		else{
+			LOGPF("Instance %s generating events on %" PRIsize_t " channels without rate limit", inst[u]->name, data->channels);
+		}
+	}
+	return 0;
+}
+
+static int generator_shutdown(size_t n, instance** inst){
+	size_t u;
+	generator_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (generator_instance_data*) inst[u]->impl;
+		if(data->sequence){
+			LOGPF("Instance %s generated %" PRIu64 " events", inst[u]->name, data->sequence);
+		}
+		free(data->channel);
+		free(data->batch_channel);
+		free(data->batch_value);
+		free(inst[u]->impl);
+		inst[u]->impl = NULL;
+	}
+
+	LOG("Backend shut down");
+	return 0;
+}
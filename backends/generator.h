@@ -0,0 +1,51 @@
+#include "midimonster.h"
+
+MM_PLUGIN_API int init();
+static int generator_configure(char* option, char* value);
+static int generator_configure_instance(instance* inst, char* option, char* value);
+static int generator_instance(instance* inst);
+static channel* generator_channel(instance* inst, char* spec, uint8_t flags);
+static size_t generator_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
+static channel* generator_channel_restore(instance* inst, uint64_t ident, uint8_t flags);
+static int generator_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int generator_handle(size_t num, managed_fd* fds);
+static int generator_start(size_t n, instance** inst);
+static int generator_shutdown(size_t n, instance** inst);
+
+//default number of channels per instance
+#define GENERATOR_DEFAULT_CHANNELS 512
+//default event rate in events per second
+#define GENERATOR_DEFAULT_RATE 1000
+//maximum number of events pushed to the core per timer callback
+#define GENERATOR_MAX_BATCH 65536
+//number of value steps within one ramp
+#define GENERATOR_RAMP_STEPS 256
+
+typedef enum /*_generator_pattern*/ {
+	pattern_ramp = 0,
+	pattern_random,
+	pattern_burst,
+	pattern_universe
+} generator_pattern;
+
+typedef struct /*_generator_instance_data*/ {
+	//configuration
+	size_t channels;
+	uint64_t rate;
+	generator_pattern pattern;
+	size_t burst;
+	uint32_t interval;
+	uint64_t seed;
+
+	//runtime state
+	channel* channel;
+	uint64_t start;
+	uint64_t generated;
+	uint64_t sequence;
+	uint64_t random;
+
+	//event buffers for one batch
+	size_t batch;
+	channel** batch_channel;
+	channel_value* batch_value;
+} generator_instance_data;
@@ -13,7 +13,8 @@ MM_PLUGIN_API int init(){
 		.handle = loopback_set,
 		.process = loopback_handle,
 		.start = loopback_start,
-		.shutdown = loopback_shutdown
+		.shutdown = loopback_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe | mmbackend_shard_instances | mmbackend_echo
 	};
 
 	//register backend
@@ -75,10 +76,8 @@ static channel* loopback_channel(instance* inst, char* spec, uint8_t flags){
 }
 
 static int loopback_set(instance* inst, size_t num, channel** c, channel_value* v){
-	size_t n;
-	for(n = 0; n < num; n++){
-		mm_channel_event(c[n], v[n]);
-	}
+	//reflect all events back to the core at once
+	mm_channel_events(num, c, v);
 	return 0;
 }
 
@@ -36,7 +36,8 @@ MM_PLUGIN_API int init(){
 		.handle = lua_set,
 		.process = lua_handle,
 		.start = lua_start,
-		.shutdown = lua_shutdown
+		.shutdown = lua_shutdown,
+		.flags = mmbackend_feedback
 	};
 
 	//register backend
@@ -584,8 +585,9 @@ static int lua_set(instance* inst, size_t num, channel** c, channel_value* v){
 }
 
 static int lua_handle(size_t num, managed_fd* fds){
-	uint64_t delta = mm_timestamp() - last_timestamp;
-	last_timestamp = mm_timestamp();
+	//track time in microseconds so sub-millisecond remainders do not accumulate as drift
+	uint64_t delta = (mm_timestamp_us() - last_timestamp) / 1000;
+	last_timestamp += delta * 1000;
 	size_t n;
 
 	#ifdef MMBACKEND_LUA_TIMERFD
@@ -701,7 +703,7 @@ static int lua_start(size_t n, instance** inst){
 		return 1;
 	}
 	#endif
-	last_timestamp = mm_timestamp();
+	last_timestamp = mm_timestamp_us();
 	return 0;
 }
 
@@ -18,9 +18,7 @@
 
 static void maweb_disconnect(instance* inst);
 
-static uint64_t last_keepalive = 0;
 static uint64_t update_interval = 0;
-static uint64_t last_update = 0;
 static uint64_t quiet_mode = 0;
 
 static maweb_command_key cmdline_keys[] = {
@@ -87,7 +85,7 @@ MM_PLUGIN_API int init(){
 		.process = maweb_handle,
 		.start = maweb_start,
 		.shutdown = maweb_shutdown,
-		.interval = maweb_interval
+		.flags = mmbackend_no_polling
 	};
 
 	//register backend
@@ -133,13 +131,6 @@ static int channel_comparator(const void* raw_a, const void* raw_b){
 	return a->index - b->index;
 }
 
-static uint32_t maweb_interval(){
-	if(update_interval){
-		return update_interval - (last_update % update_interval);
-	}
-	return 0;
-}
-
 static int maweb_configure(char* option, char* value){
 	if(!strcmp(option, "interval")){
 		update_interval = strtoul(value, NULL, 10);
@@ -1015,7 +1006,7 @@ static int maweb_keepalive(){
 	char xmit_buffer[MAWEB_XMIT_CHUNK];
 
 	//fetch all defined instances
-	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+	if(mm_backend_instances_borrow(BACKEND_NAME, &n, &inst)){
 		LOG("Failed to fetch instance list");
 		return 1;
 	}
@@ -1034,8 +1025,6 @@ static int maweb_keepalive(){
 			}
 		}
 	}
-
-	free(inst);
 	return 0;
 }
 
@@ -1045,7 +1034,7 @@ static int maweb_poll(){
 	maweb_instance_data* data = NULL;
 
 	//fetch all defined instances
-	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+	if(mm_backend_instances_borrow(BACKEND_NAME, &n, &inst)){
 		LOG( "Failed to fetch instance list");
 		return 1;
 	}
@@ -1057,8 +1046,6 @@ static int maweb_poll(){
 			maweb_request_playbacks(inst[u]);
 		}
 	}
-
-	free(inst);
 	return 0;
 }
 
@@ -1081,18 +1068,22 @@ static int maweb_handle(size_t num, managed_fd* fds){
 		rv = 0;
 	}
 
+	return rv;
+}
+
+static int maweb_keepalive_timer(instance* inst){
 	//FIXME all keepalive processing allocates temporary buffers, this might an optimization target
-	if(last_keepalive && mm_timestamp() - last_keepalive >= MAWEB_CONNECTION_KEEPALIVE){
-		rv |= maweb_keepalive();
-		last_keepalive = mm_timestamp();
+	if(maweb_keepalive()){
+		return 1;
 	}
+	return mm_timer_add(NULL, mm_timestamp() + MAWEB_CONNECTION_KEEPALIVE, maweb_keepalive_timer);
+}
 
-	if(update_interval && last_update && mm_timestamp() - last_update >= update_interval){
-		rv |= maweb_poll();
-		last_update = mm_timestamp();
+static int maweb_poll_timer(instance* inst){
+	if(maweb_poll()){
+		return 1;
 	}
-
-	return rv;
+	return mm_timer_add(NULL, mm_timestamp() + update_interval, maweb_poll_timer);
 }
 
 static int maweb_start(size_t n, instance** inst){
@@ -1124,8 +1115,10 @@ static int maweb_start(size_t n, instance** inst){
 	LOGPF("Registering %" PRIsize_t " descriptors to core", n);
 
 	//initialize timeouts
-	last_keepalive = last_update = mm_timestamp();
-	return 0;
+	if(update_interval && mm_timer_add(NULL, mm_timestamp() + update_interval, maweb_poll_timer)){
+		return 1;
+	}
+	return mm_timer_add(NULL, mm_timestamp() + MAWEB_CONNECTION_KEEPALIVE, maweb_keepalive_timer);
 }
 
 static int maweb_shutdown(size_t n, instance** inst){
@@ -9,7 +9,8 @@ static int maweb_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int maweb_handle(size_t num, managed_fd* fds);
 static int maweb_start(size_t n, instance** inst);
 static int maweb_shutdown(size_t n, instance** inst);
-static uint32_t maweb_interval();
+static int maweb_keepalive_timer(instance* inst);
+static int maweb_poll_timer(instance* inst);
 
 //Default login password: MD5("midimonster")
 #define MAWEB_DEFAULT_PASSWORD "2807623134739142b119aff358f8a219"
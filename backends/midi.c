@@ -21,8 +21,11 @@ enum /*_midi_channel_type*/ {
 
 static struct {
 	uint8_t detect;
+	//instance lookup token
+	size_t instances;
 } midi_config = {
-	.detect = 0
+	.detect = 0,
+	.instances = 0
 };
 
 MM_PLUGIN_API int init(){
@@ -32,10 +35,13 @@ MM_PLUGIN_API int init(){
 		.create = midi_instance,
 		.conf_instance = midi_configure_instance,
 		.channel = midi_channel,
+		.channel_range = midi_channel_range,
+		.channel_restore = midi_channel_restore,
 		.handle = midi_set,
 		.process = midi_handle,
 		.start = midi_start,
-		.shutdown = midi_shutdown
+		.shutdown = midi_shutdown,
+		.flags = mmbackend_no_polling
 	};
 
 	if(sizeof(midi_channel_ident) != sizeof(uint64_t)){
@@ -114,11 +120,7 @@ static int midi_configure_instance(instance* inst, char* option, char* value){
 	return 1;
 }
 
-static channel* midi_channel(instance* inst, char* spec, uint8_t flags){
-	midi_channel_ident ident = {
-		.label = 0
-	};
-
+static int midi_parse_spec(char* spec, midi_channel_ident* ident){
 	char* channel = NULL;
 	if(!strncmp(spec, "ch", 2)){
 		channel = spec + 2;
@@ -129,65 +131,108 @@ static channel* midi_channel(instance* inst, char* spec, uint8_t flags){
 
 	if(!channel){
 		LOGPF("Invalid channel specification %s", spec);
-		return NULL;
+		return 1;
 	}
 
-	ident.fields.channel = strtoul(channel, &channel, 10);
-	if(ident.fields.channel > 15){
+	ident->fields.channel = strtoul(channel, &channel, 10);
+	if(ident->fields.channel > 15){
 		LOGPF("MIDI channel out of range in spec %s", spec);
-		return NULL;
+		return 1;
 	}
 
 	if(*channel != '.'){
 		LOGPF("Need specification of form channel<X>.<control><Y>, had %s", spec);
-		return NULL;
+		return 1;
 	}
 	//skip the period
 	channel++;
 
 	if(!strncmp(channel, "cc", 2)){
-		ident.fields.type = cc;
+		ident->fields.type = cc;
 		channel += 2;
 	}
 	else if(!strncmp(channel, "note", 4)){
-		ident.fields.type = note;
+		ident->fields.type = note;
 		channel += 4;
 	}
 	else if(!strncmp(channel, "pressure", 8)){
-		ident.fields.type = pressure;
+		ident->fields.type = pressure;
 		channel += 8;
 	}
 	else if(!strncmp(channel, "rpn", 3)){
-		ident.fields.type = rpn;
+		ident->fields.type = rpn;
 		channel += 3;
 	}
 	else if(!strncmp(channel, "nrpn", 4)){
-		ident.fields.type = nrpn;
+		ident->fields.type = nrpn;
 		channel += 4;
 	}
 	else if(!strncmp(channel, "pitch", 5)){
-		ident.fields.type = pitchbend;
+		ident->fields.type = pitchbend;
 	}
 	else if(!strncmp(channel, "program", 7)){
-		ident.fields.type = program;
+		ident->fields.type = program;
 	}
 	else if(!strncmp(channel, "aftertouch", 10)){
-		ident.fields.type = aftertouch;
+		ident->fields.type = aftertouch;
 	}
 	else{
 		LOGPF("Unknown control type in %s", spec);
-		return NULL;
+		return 1;
 	}
 
-	ident.fields.control = strtoul(channel, NULL, 10);
+	ident->fields.control = strtoul(channel, NULL, 10);
+	return 0;
+}
 
-	if(ident.label){
+static channel* midi_channel(instance* inst, char* spec, uint8_t flags){
+	midi_channel_ident ident = {
+		.label = 0
+	};
+
+	if(!midi_parse_spec(spec, &ident) && ident.label){
 		return mm_channel(inst, ident.label, 1);
 	}
 
 	return NULL;
 }
 
+static size_t midi_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	size_t u;
+	midi_channel_ident ident = {
+		.label = 0
+	};
+
+	//only ranges over the control number are handled in bulk
+	if(*suffix || !*prefix || first + count - 1 > 0xFFFF
+			|| midi_parse_spec(prefix, &ident)
+			|| ident.fields.control){
+		return 0;
+	}
+
+	if(ident.fields.type != cc
+			&& ident.fields.type != note
+			&& ident.fields.type != pressure
+			&& ident.fields.type != rpn
+			&& ident.fields.type != nrpn){
+		return 0;
+	}
+
+	for(u = 0; u < count; u++){
+		ident.fields.control = first + u;
+		channels[u] = mm_channel(inst, ident.label, 1);
+		if(!channels[u]){
+			return 0;
+		}
+	}
+	return count;
+}
+
+static channel* midi_channel_restore(instance* inst, uint64_t ident, uint8_t flags){
+	//channels are fully described by their identifier
+	return mm_channel(inst, ident, 1);
+}
+
 static void midi_tx(int port, uint8_t type, uint8_t channel, uint8_t control, uint16_t value){
 	snd_seq_event_t ev;
 
@@ -386,7 +431,7 @@ static int midi_handle(size_t num, managed_fd* fds){
 		val.normalised = (double) ev->data.note.velocity / 127.0;
 
 		//scan for the instance before parsing incoming data, instance state is required for the EPN state machine
-		inst = mm_instance_find(BACKEND_NAME, ev->dest.port);
+		inst = mm_instance_lookup(midi_config.instances, ev->dest.port);
 		if(!inst){
 			LOG("Delivered event did not match any instance");
 			continue;
@@ -519,6 +564,12 @@ static int midi_start(size_t n, instance** inst){
 		}
 	}
 
+	//all ports are created, index them for the receive path
+	midi_config.instances = mm_instance_namespace(BACKEND_NAME);
+	if(!midi_config.instances){
+		goto bail;
+	}
+
 	//register all fds to core
 	nfds = snd_seq_poll_descriptors_count(sequencer, POLLIN | POLLOUT);
 	pfds = calloc(nfds, sizeof(struct pollfd));
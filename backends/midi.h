@@ -5,6 +5,8 @@ static int midi_configure(char* option, char* value);
 static int midi_configure_instance(instance* instance, char* option, char* value);
 static int midi_instance(instance* inst);
 static channel* midi_channel(instance* instance, char* spec, uint8_t flags);
+static size_t midi_channel_range(instance* instance, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
+static channel* midi_channel_restore(instance* instance, uint64_t ident, uint8_t flags);
 static int midi_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int midi_handle(size_t num, managed_fd* fds);
 static int midi_start(size_t n, instance** inst);
@@ -8,7 +8,6 @@
 #include "libmmbackend.h"
 #include "mqtt.h"
 
-static uint64_t last_maintenance = 0;
 /* according to spec 2.2.2.2 */
 static struct {
 	uint8_t property;
@@ -61,7 +60,8 @@ MM_PLUGIN_API int init(){
 		.handle = mqtt_set,
 		.process = mqtt_handle,
 		.start = mqtt_start,
-		.shutdown = mqtt_shutdown
+		.shutdown = mqtt_shutdown,
+		.flags = mmbackend_no_polling
 	};
 
 	//register backend
@@ -574,7 +574,7 @@ static int mqtt_maintenance(){
 	instance** inst = NULL;
 	mqtt_instance_data* data = NULL;
 
-	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+	if(mm_backend_instances_borrow(BACKEND_NAME, &n, &inst)){
 		LOG("Failed to fetch instance list");
 		return 1;
 	}
@@ -585,7 +585,6 @@ static int mqtt_maintenance(){
 		if(data->fd <= 0){
 			if(mqtt_reconnect(inst[u]) >= 2){
 				LOGPF("Failed to reconnect instance %s, terminating", inst[u]->name);
-				free(inst);
 				return 1;
 			}
 		}
@@ -594,8 +593,6 @@ static int mqtt_maintenance(){
 			mqtt_transmit(inst[u], MSG_PINGREQ, 0, NULL, 0, NULL);
 		}
 	}
-
-	free(inst);
 	return 0;
 }
 
@@ -940,15 +937,15 @@ static int mqtt_handle(size_t num, managed_fd* fds){
 		}
 	}
 
+	return 0;
+}
+
+static int mqtt_maintenance_timer(instance* inst){
 	//keepalive/reconnect processing
-	if(last_maintenance && mm_timestamp() - last_maintenance >= MQTT_KEEPALIVE * 1000){
-		if(mqtt_maintenance()){
-			return 1;
-		}
-		last_maintenance = mm_timestamp();
+	if(mqtt_maintenance()){
+		return 1;
 	}
-
-	return 0;
+	return mm_timer_add(NULL, mm_timestamp() + MQTT_KEEPALIVE * 1000, mqtt_maintenance_timer);
 }
 
 static int mqtt_start(size_t n, instance** inst){
@@ -970,8 +967,7 @@ static int mqtt_start(size_t n, instance** inst){
 	LOGPF("Registered %" PRIsize_t " descriptors to core", fds);
 
 	//initialize maintenance timer
-	last_maintenance = mm_timestamp();
-	return 0;
+	return mm_timer_add(NULL, mm_timestamp() + MQTT_KEEPALIVE * 1000, mqtt_maintenance_timer);
 }
 
 static int mqtt_shutdown(size_t n, instance** inst){
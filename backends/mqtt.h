@@ -9,6 +9,7 @@ static int mqtt_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int mqtt_handle(size_t num, managed_fd* fds);
 static int mqtt_start(size_t n, instance** inst);
 static int mqtt_shutdown(size_t n, instance** inst);
+static int mqtt_maintenance_timer(instance* inst);
 
 #define MQTT_PORT "1883"
 #define MQTT_TLS_PORT "8883"
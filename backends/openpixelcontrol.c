@@ -16,10 +16,12 @@ MM_PLUGIN_API int init(){
 		.create = openpixel_instance,
 		.conf_instance = openpixel_configure_instance,
 		.channel = openpixel_channel,
+		.channel_range = openpixel_channel_range,
 		.handle = openpixel_set,
 		.process = openpixel_handle,
 		.start = openpixel_start,
-		.shutdown = openpixel_shutdown
+		.shutdown = openpixel_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe | mmbackend_shard_instances
 	};
 
 	//register backend
@@ -217,7 +219,69 @@ static channel* openpixel_channel(instance* inst, char* spec, uint8_t flags){
 	return mm_channel(inst, ((uint64_t) strip) << 32 | channel, 1);
 }
 
-static int openpixel_output_data(openpixel_instance_data* data){
+static size_t openpixel_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	uint32_t strip = 0, stride = 3, offset = 0;
+	uint64_t last = 0;
+	size_t u;
+	char* token = prefix;
+	openpixel_instance_data* data = (openpixel_instance_data*) inst->impl;
+
+	if(*suffix || !first){
+		return 0;
+	}
+
+	//read strip index if supplied
+	if(!strncmp(prefix, "strip", 5)){
+		strip = strtoul(prefix + 5, &token, 10);
+		if(*token != '.'){
+			return 0;
+		}
+		token++;
+	}
+
+	//component ranges address every third channel
+	if(!strcmp(token, "channel")){
+		stride = 1;
+	}
+	else if(!strcmp(token, "red")){
+		offset = 2;
+	}
+	else if(!strcmp(token, "green")){
+		offset = 1;
+	}
+	else if(strcmp(token, "blue")){
+		return 0;
+	}
+
+	last = (first + count - 1) * stride - offset;
+	if(last > 0xFFFF){
+		return 0;
+	}
+
+	//invalid directions are reported by the single channel parser
+	if(flags & mmchannel_input){
+		if(!strip || data->listen_fd < 0 || openpixel_buffer_extend(data, strip, 1, last)){
+			return 0;
+		}
+	}
+
+	if(flags & mmchannel_output){
+		if(data->dest_fd < 0 || openpixel_buffer_extend(data, strip, 0, last)){
+			return 0;
+		}
+	}
+
+	for(u = 0; u < count; u++){
+		channels[u] = mm_channel(inst, ((uint64_t) strip) << 32 | ((first + u) * stride - offset), 1);
+		if(!channels[u]){
+			return 0;
+		}
+	}
+	return count;
+}
+
+static int openpixel_output_data(instance* inst){
+	openpixel_instance_data* data = (openpixel_instance_data*) inst->impl;
 	size_t u;
 	openpixel_header hdr;
 
@@ -237,6 +301,8 @@ static int openpixel_output_data(openpixel_instance_data* data){
 					|| mmbackend_send(data->dest_fd, data->buffer[u].data.u8, data->buffer[u].bytes)){
 				return 1;
 			}
+			inst->stats.bytes_out += sizeof(hdr) + data->buffer[u].bytes;
+			inst->stats.packets_out++;
 		}
 	}
 
@@ -291,7 +357,7 @@ static int openpixel_set(instance* inst, size_t num, channel** c, channel_value*
 		}
 	}
 
-	return openpixel_output_data(data);
+	return openpixel_output_data(inst);
 }
 
 static int openpixel_client_new(instance* inst, int fd){
@@ -340,10 +406,17 @@ static int openpixel_client_new(instance* inst, int fd){
 	return mm_manage_fd(fd, BACKEND_NAME, 1, inst);
 }
 
+static void openpixel_push_events(size_t* events, channel** chan, channel_value* val){
+	if(*events && mm_channel_events(*events, chan, val)){
+		LOG("Failed to push channel events to core");
+	}
+	*events = 0;
+}
+
 static size_t openpixel_strip_pixeldata8(instance* inst, openpixel_client* client, uint8_t* data, openpixel_buffer* buffer, size_t bytes_left){
-	channel* chan = NULL;
-	channel_value val;
-	size_t u;
+	channel* chan[OPENPIXEL_EVENT_BATCH];
+	channel_value val[OPENPIXEL_EVENT_BATCH];
+	size_t u, events = 0;
 
 	for(u = 0; u < bytes_left; u++){
 		//if over buffer length, ignore
@@ -357,24 +430,28 @@ static size_t openpixel_strip_pixeldata8(instance* inst, openpixel_client* clien
 		//update changed channels
 		if(buffer->data.u8[u + client->offset] != data[u]){
 			buffer->data.u8[u + client->offset] = data[u];
-			chan = mm_channel(inst, ((uint64_t) buffer->strip << 32) | (u + client->offset + 1), 0);
-			if(chan){
-				//push event
-				val.raw.u64 = data[u];
-				val.normalised = (double) data[u] / 255.0;
-				if(mm_channel_event(chan, val)){
-					LOG("Failed to push channel event to core");
-				}
+			chan[events] = mm_channel(inst, ((uint64_t) buffer->strip << 32) | (u + client->offset + 1), 0);
+			if(chan[events]){
+				//queue event
+				val[events].raw.u64 = data[u];
+				val[events].normalised = (double) data[u] / 255.0;
+				events++;
+			}
+
+			if(events == OPENPIXEL_EVENT_BATCH){
+				openpixel_push_events(&events, chan, val);
 			}
 		}
 	}
+
+	openpixel_push_events(&events, chan, val);
 	return u;
 }
 
 static size_t openpixel_strip_pixeldata16(instance* inst, openpixel_client* client, uint8_t* data, openpixel_buffer* buffer, size_t bytes_left){
-	channel* chan = NULL;
-	channel_value val;
-	size_t u;
+	channel* chan[OPENPIXEL_EVENT_BATCH];
+	channel_value val[OPENPIXEL_EVENT_BATCH];
+	size_t u, events = 0;
 
 	for(u = 0; u < bytes_left; u++){
 		//if over buffer length, ignore
@@ -396,18 +473,21 @@ static size_t openpixel_strip_pixeldata16(instance* inst, openpixel_client* clie
 		if((client->offset + u) % 2
 				&& buffer->data.u16[(u + client->offset) / 2] != be16toh(client->boundary.u16)){
 			buffer->data.u16[(u + client->offset) / 2] = be16toh(client->boundary.u16);
-			chan = mm_channel(inst, ((uint64_t) buffer->strip << 32) | ((u + client->offset) / 2 + 1), 0);
-			if(chan){
-				//push event
-				val.raw.u64 = be16toh(client->boundary.u16);;
-				val.normalised = (double) val.raw.u64 / 65535.0;
-				if(mm_channel_event(chan, val)){
-					LOG("Failed to push channel event to core");
-				}
+			chan[events] = mm_channel(inst, ((uint64_t) buffer->strip << 32) | ((u + client->offset) / 2 + 1), 0);
+			if(chan[events]){
+				//queue event
+				val[events].raw.u64 = be16toh(client->boundary.u16);
+				val[events].normalised = (double) val[events].raw.u64 / 65535.0;
+				events++;
 			}
 
+			if(events == OPENPIXEL_EVENT_BATCH){
+				openpixel_push_events(&events, chan, val);
+			}
 		}
 	}
+
+	openpixel_push_events(&events, chan, val);
 	return u;
 }
 
@@ -547,6 +627,8 @@ static int openpixel_client_handle(instance* inst, int fd){
 		return 0;
 	}
 	DBGPF("Received %" PRIsize_t " bytes on %s", bytes, inst->name);
+	inst->stats.bytes_in += bytes;
+	inst->stats.packets_in++;
 
 	for(bytes_left = bytes - offset; bytes_left > 0; bytes_left = bytes - offset){
 		if(data->client[c].buffer == -1){
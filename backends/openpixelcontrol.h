@@ -5,6 +5,7 @@ static int openpixel_configure(char* option, char* value);
 static int openpixel_configure_instance(instance* inst, char* option, char* value);
 static int openpixel_instance(instance* inst);
 static channel* openpixel_channel(instance* inst, char* spec, uint8_t flags);
+static size_t openpixel_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
 static int openpixel_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int openpixel_handle(size_t num, managed_fd* fds);
 static int openpixel_start(size_t n, instance** inst);
@@ -12,6 +13,8 @@ static int openpixel_shutdown(size_t n, instance** inst);
 
 #define OPENPIXEL_INPUT 1
 #define OPENPIXEL_MARK 2
+//maximum number of channel events collected before pushing them to the core
+#define OPENPIXEL_EVENT_BATCH 256
 
 typedef struct /*_data_buffer*/ {
 	uint8_t strip;
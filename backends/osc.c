@@ -32,7 +32,8 @@ MM_PLUGIN_API int init(){
 		.handle = osc_set,
 		.process = osc_handle,
 		.start = osc_start,
-		.shutdown = osc_shutdown
+		.shutdown = osc_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe | mmbackend_shard_instances
 	};
 
 	if(sizeof(osc_channel_ident) != sizeof(uint64_t)){
@@ -698,7 +699,11 @@ static int osc_output_channel(instance* inst, size_t channel){
 	//output packet
 	if(sendto(data->fd, xmit_buf, offset, 0, (struct sockaddr*) &(data->dest), data->dest_len) < 0){
 		LOGPF("Failed to transmit packet: %s", mmbackend_socket_strerror(errno));
+		return 0;
 	}
+
+	inst->stats.bytes_out += offset;
+	inst->stats.packets_out++;
 	return 0;
 }
 
@@ -761,13 +766,13 @@ static int osc_set(instance* inst, size_t num, channel** c, channel_value* v){
 
 static int osc_process_message(instance* inst, char* local_path, char* format, uint8_t* payload, size_t payload_len){
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
-	size_t c, p, offset = 0;
+	size_t c, p, offset = 0, events = 0;
 	osc_parameter_value min, max, cur;
-	channel_value evt;
+	channel_value evt[OSC_EVENT_BATCH];
 	osc_channel_ident ident = {
 		.label = 0
 	};
-	channel* chan = NULL;
+	channel* chan[OSC_EVENT_BATCH];
 
 	if(payload_len % 4){
 		LOGPF("Invalid packet, data length %" PRIsize_t, payload_len);
@@ -794,13 +799,19 @@ static int osc_process_message(instance* inst, char* local_path, char* format, u
 				}
 				cur = osc_parse(format[p], payload + offset);
 				if(!data->channel[c].params || memcmp(&cur, &data->channel[c].in, sizeof(cur))){
-					evt = osc_parameter_normalise(format[p], min, max, cur);
-					chan = mm_channel(inst, ident.label, 0);
-					if(chan){
-						mm_channel_event(chan, evt);
+					evt[events] = osc_parameter_normalise(format[p], min, max, cur);
+					chan[events] = mm_channel(inst, ident.label, 0);
+					if(chan[events]){
+						events++;
 					}
 				}
 
+				//push a full batch of events
+				if(events == OSC_EVENT_BATCH){
+					mm_channel_events(events, chan, evt);
+					events = 0;
+				}
+
 				//skip to next parameter data
 				offset += osc_data_length(format[p]);
 				//TODO check offset against payload length
@@ -808,6 +819,9 @@ static int osc_process_message(instance* inst, char* local_path, char* format, u
 		}
 	}
 
+	if(events){
+		mm_channel_events(events, chan, evt);
+	}
 	return 0;
 }
 
@@ -910,6 +924,8 @@ static int osc_handle(size_t num, managed_fd* fds){
 				break;
 			}
 
+			inst->stats.bytes_in += bytes_read;
+			inst->stats.packets_in++;
 			osc_process_packet(inst, recv_buf, bytes_read);
 		} while(bytes_read > 0);
 
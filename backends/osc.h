@@ -6,6 +6,8 @@
 
 #define OSC_RECV_BUF 8192
 #define OSC_XMIT_BUF 8192
+//maximum number of channel events collected per message before pushing them to the core
+#define OSC_EVENT_BATCH 64
 
 MM_PLUGIN_API int init();
 static int osc_configure(char* option, char* value);
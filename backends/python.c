@@ -31,7 +31,8 @@ MM_PLUGIN_API int init(){
 		.process = python_handle,
 		.start = python_start,
 		.interval = python_interval,
-		.shutdown = python_shutdown
+		.shutdown = python_shutdown,
+		.flags = mmbackend_feedback
 	};
 
 	//register backend
@@ -617,8 +618,9 @@ static int python_handle(size_t num, managed_fd* fds){
 
 	//handle intervals
 	if(timer_interval){
-		uint64_t delta = mm_timestamp() - last_timestamp;
-		last_timestamp = mm_timestamp();
+		//track time in microseconds so sub-millisecond remainders do not accumulate as drift
+		uint64_t delta = (mm_timestamp_us() - last_timestamp) / 1000;
+		last_timestamp += delta * 1000;
 
 		//add delta to all active timers
 		for(u = 0; u < intervals; u++){
@@ -729,7 +731,7 @@ static int python_start(size_t n, instance** inst){
 		PyEval_ReleaseThread(data->interpreter);
 	}
 
-	last_timestamp = mm_timestamp();
+	last_timestamp = mm_timestamp_us();
 	return 0;
 }
 
@@ -0,0 +1,369 @@
+#define BACKEND_NAME "replay"
+
+#include <string.h>
+#include <errno.h>
+#include "replay.h"
+
+MM_PLUGIN_API int init(){
+	backend replay = {
+		.name = BACKEND_NAME,
+		.conf = replay_configure,
+		.create = replay_instance,
+		.conf_instance = replay_configure_instance,
+		.channel = replay_channel,
+		.handle = replay_set,
+		.process = replay_handle,
+		.start = replay_start,
+		.shutdown = replay_shutdown,
+		.flags = mmbackend_no_polling
+	};
+
+	//register backend
+	if(mm_backend_register(replay)){
+		LOG("Failed to register backend");
+		return 1;
+	}
+	return 0;
+}
+
+static int replay_configure(char* option, char* value){
+	LOG("This backend does not take global configuration");
+	return 1;
+}
+
+static int replay_configure_instance(instance* inst, char* option, char* value){
+	replay_instance_data* data = (replay_instance_data*) inst->impl;
+	char* next = value;
+
+	if(!strcmp(option, "file")){
+		free(data->file);
+		data->file = strdup(value);
+		if(!data->file){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "speed")){
+		data->speed = strtod(value, &next);
+		if(data->speed < 0 || *next){
+			LOGPF("Invalid replay speed %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "loop")){
+		data->loop = 0;
+		if(!strcmp(value, "on")){
+			data->loop = 1;
+		}
+		return 0;
+	}
+
+	LOGPF("Unknown instance option %s for instance %s", option, inst->name);
+	return 1;
+}
+
+static int replay_instance(instance* inst){
+	replay_instance_data* data = calloc(1, sizeof(replay_instance_data));
+	if(!data){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	data->speed = 1.0;
+	inst->impl = data;
+	return 0;
+}
+
+static channel* replay_channel(instance* inst, char* spec, uint8_t flags){
+	LOGPF("Instance %s does not provide channels, events are replayed on the channels of the captured instances", inst->name);
+	return NULL;
+}
+
+static int replay_set(instance* inst, size_t num, channel** c, channel_value* v){
+	//replay instances have no channels
+	return 0;
+}
+
+static int replay_handle(size_t num, managed_fd* fds){
+	//events are replayed from timers
+	return 0;
+}
+
+static int replay_compare(const void* a, const void* b){
+	channel* x = *((channel**) a);
+	channel* y = *((channel**) b);
+	return (x->ident > y->ident) - (x->ident < y->ident);
+}
+
+static channel* replay_resolve(replay_source* source, uint64_t ident){
+	size_t low = 0, high = source->channels, mid;
+
+	while(low < high){
+		mid = low + (high - low) / 2;
+		if(source->channel[mid]->ident == ident){
+			return source->channel[mid];
+		}
+		else if(source->channel[mid]->ident < ident){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return NULL;
+}
+
+static int replay_read(char* path, uint8_t** buffer, size_t* length){
+	FILE* file = fopen(path, "rb");
+	long size;
+
+	if(!file){
+		LOGPF("Failed to open capture file %s: %s", path, strerror(errno));
+		return 1;
+	}
+
+	if(fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET)){
+		LOGPF("Failed to read capture file %s: %s", path, strerror(errno));
+		fclose(file);
+		return 1;
+	}
+
+	*length = size;
+	*buffer = malloc(*length + 1);
+	if(!*buffer){
+		LOG("Failed to allocate memory");
+		fclose(file);
+		return 1;
+	}
+
+	if(fread(*buffer, 1, *length, file) != *length){
+		LOGPF("Failed to read capture file %s", path);
+		fclose(file);
+		return 1;
+	}
+	fclose(file);
+	return 0;
+}
+
+static int replay_parse(instance* inst, uint8_t* buffer, size_t length){
+	replay_instance_data* data = (replay_instance_data*) inst->impl;
+	size_t u, offset = sizeof(REPLAY_MAGIC) + 1, sources = 0, skipped = 0;
+	replay_source* source = NULL, *current = NULL, *grown = NULL;
+	uint8_t* terminator = NULL;
+	uint32_t index;
+	uint64_t ident;
+	channel* resolved = NULL;
+	int rv = 1;
+
+	if(length < offset || memcmp(buffer, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) || buffer[sizeof(REPLAY_MAGIC)] != REPLAY_VERSION){
+		LOGPF("File %s is not a supported event capture", data->file);
+		return 1;
+	}
+
+	//every event record is at least this long, so this is an upper bound for the event count
+	u = (length - offset) / REPLAY_EVENT_LENGTH;
+	data->timestamp = calloc(u + 1, sizeof(uint64_t));
+	data->channel = calloc(u + 1, sizeof(channel*));
+	data->value = calloc(u + 1, sizeof(channel_value));
+	if(!data->timestamp || !data->channel || !data->value){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	while(offset < length){
+		if(buffer[offset] == REPLAY_RECORD_INSTANCE){
+			terminator = (offset + 5 < length) ? memchr(buffer + offset + 5, 0, length - offset - 5) : NULL;
+			if(!terminator){
+				break;
+			}
+
+			grown = realloc(source, (sources + 1) * sizeof(replay_source));
+			if(!grown){
+				LOG("Failed to allocate memory");
+				goto bail;
+			}
+			source = grown;
+			current = source + sources++;
+			current->channels = 0;
+			current->channel = NULL;
+			memcpy(&current->index, buffer + offset + 1, sizeof(uint32_t));
+			current->name = (char*) buffer + offset + 5;
+
+			//channels without mappings would not generate events, so they do not need to be resolved
+			if(mm_routed_channels(current->name, &current->channels, &current->channel)){
+				LOGPF("Captured instance %s does not exist, skipping its events", current->name);
+			}
+			else if(current->channels){
+				qsort(current->channel, current->channels, sizeof(channel*), replay_compare);
+			}
+			offset = (terminator - buffer) + 1;
+		}
+		else if(buffer[offset] == REPLAY_RECORD_EVENT){
+			if(offset + REPLAY_EVENT_LENGTH > length){
+				break;
+			}
+
+			memcpy(&index, buffer + offset + 1, sizeof(uint32_t));
+			if(!current || current->index != index){
+				for(current = NULL, u = 0; u < sources; u++){
+					if(source[u].index == index){
+						current = source + u;
+						break;
+					}
+				}
+
+				if(!current){
+					LOGPF("Capture file %s references an undescribed instance", data->file);
+					goto bail;
+				}
+			}
+
+			memcpy(&ident, buffer + offset + 13, sizeof(uint64_t));
+			resolved = replay_resolve(current, ident);
+			if(resolved){
+				data->channel[data->events] = resolved;
+				memcpy(data->timestamp + data->events, buffer + offset + 5, sizeof(uint64_t));
+				memcpy(&data->value[data->events].raw.u64, buffer + offset + 21, sizeof(uint64_t));
+				memcpy(&data->value[data->events].normalised, buffer + offset + 29, sizeof(double));
+				data->events++;
+			}
+			else{
+				skipped++;
+			}
+			offset += REPLAY_EVENT_LENGTH;
+		}
+		else{
+			LOGPF("Invalid record in capture file %s at offset %" PRIsize_t, data->file, offset);
+			goto bail;
+		}
+	}
+
+	//a capture that was not stopped cleanly may end within a record
+	if(offset < length){
+		LOGPF("Capture file %s is truncated, replaying the complete records only", data->file);
+	}
+
+	//start the replay with the first event
+	for(u = data->events; u > 0; u--){
+		data->timestamp[u - 1] -= data->timestamp[0];
+	}
+
+	LOGPF("Instance %s loaded %" PRIsize_t " events spanning %.3f seconds from %s, skipped %" PRIsize_t " events on unmapped channels",
+			inst->name, data->events, data->events ? data->timestamp[data->events - 1] / 1000000.0 : 0.0, data->file, skipped);
+	rv = 0;
+
+bail:
+	for(u = 0; u < sources; u++){
+		free(source[u].channel);
+	}
+	free(source);
+
+	//do not keep partially loaded captures around
+	if(rv){
+		free(data->timestamp);
+		free(data->channel);
+		free(data->value);
+		data->timestamp = NULL;
+		data->channel = NULL;
+		data->value = NULL;
+		data->events = 0;
+	}
+	return rv;
+}
+
+static int replay_timer(instance* inst){
+	replay_instance_data* data = (replay_instance_data*) inst->impl;
+	uint64_t elapsed, now = mm_timestamp_us();
+	size_t end = data->position, limit = min(data->events, data->position + REPLAY_MAX_BATCH);
+
+	//without a speed factor, replay one batch per iteration
+	if(data->speed > 0){
+		elapsed = (uint64_t) ((now - data->start) * data->speed);
+		for(; end < limit && data->timestamp[end] <= elapsed; end++){
+		}
+	}
+	else{
+		end = limit;
+	}
+
+	if(end > data->position){
+		if(mm_channel_events(end - data->position, data->channel + data->position, data->value + data->position)){
+			return 1;
+		}
+		data->replayed += end - data->position;
+		data->position = end;
+	}
+
+	if(data->position == data->events){
+		if(!data->loop){
+			LOGPF("Instance %s finished replaying %" PRIsize_t " events", inst->name, data->events);
+			return 0;
+		}
+		data->position = 0;
+		data->start = now;
+	}
+
+	//sleep until the next event is due
+	if(data->speed > 0){
+		elapsed = (uint64_t) (data->timestamp[data->position] / data->speed);
+		if(data->start + elapsed > now){
+			return mm_timer_add(inst, mm_timestamp() + (data->start + elapsed - now + 999) / 1000, replay_timer);
+		}
+	}
+	return mm_timer_add(inst, mm_timestamp(), replay_timer);
+}
+
+static int replay_start(size_t n, instance** inst){
+	size_t u, length;
+	uint8_t* buffer = NULL;
+	replay_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (replay_instance_data*) inst[u]->impl;
+		if(!data->file){
+			LOGPF("Instance %s has no capture file configured", inst[u]->name);
+			return 1;
+		}
+
+		buffer = NULL;
+		if(replay_read(data->file, &buffer, &length) || replay_parse(inst[u], buffer, length)){
+			free(buffer);
+			return 1;
+		}
+		free(buffer);
+
+		if(!data->events){
+			LOGPF("Instance %s has no events to replay", inst[u]->name);
+			continue;
+		}
+
+		data->start = mm_timestamp_us();
+		if(mm_timer_add(inst[u], mm_timestamp(), replay_timer)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int replay_shutdown(size_t n, instance** inst){
+	size_t u;
+	replay_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (replay_instance_data*) inst[u]->impl;
+		if(data->loop && data->replayed){
+			LOGPF("Instance %s replayed %" PRIu64 " events", inst[u]->name, data->replayed);
+		}
+		free(data->file);
+		free(data->timestamp);
+		free(data->channel);
+		free(data->value);
+		free(inst[u]->impl);
+		inst[u]->impl = NULL;
+	}
+
+	LOG("Backend shut down");
+	return 0;
+}
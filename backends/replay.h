@@ -0,0 +1,46 @@
+#include "midimonster.h"
+
+MM_PLUGIN_API int init();
+static int replay_configure(char* option, char* value);
+static int replay_configure_instance(instance* inst, char* option, char* value);
+static int replay_instance(instance* inst);
+static channel* replay_channel(instance* inst, char* spec, uint8_t flags);
+static int replay_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int replay_handle(size_t num, managed_fd* fds);
+static int replay_start(size_t n, instance** inst);
+static int replay_shutdown(size_t n, instance** inst);
+
+//capture file format, as written by the core (see core/capture.h)
+#define REPLAY_MAGIC "MMCAP"
+#define REPLAY_VERSION 1
+#define REPLAY_RECORD_INSTANCE 1
+#define REPLAY_RECORD_EVENT 2
+#define REPLAY_EVENT_LENGTH (1 + 4 + 8 + 8 + 8 + 8)
+//maximum number of events pushed to the core per timer callback
+#define REPLAY_MAX_BATCH 65536
+
+//instance described in the capture, with its routed channels sorted by identifier
+typedef struct /*_replay_source*/ {
+	uint32_t index;
+	char* name;
+	size_t channels;
+	channel** channel;
+} replay_source;
+
+typedef struct /*_replay_instance_data*/ {
+	//configuration
+	char* file;
+	double speed;
+	uint8_t loop;
+
+	//events resolved to the channels of the recorded instances
+	size_t events;
+	uint64_t* timestamp;
+	channel** channel;
+	channel_value* value;
+
+	//playback state
+	size_t position;
+	uint64_t start;
+	uint64_t replayed;
+} replay_instance_data;
@@ -54,7 +54,6 @@ static struct /*_rtpmidi_global*/ {
 	#endif
 
 	uint8_t detect;
-	uint64_t last_service;
 
 	size_t addresses;
 	rtpmidi_addr* address;
@@ -68,7 +67,6 @@ static struct /*_rtpmidi_global*/ {
 	.mdns_interface = NULL,
 
 	.detect = 0,
-	.last_service = 0,
 
 	.addresses = 0,
 	.address = NULL,
@@ -85,10 +83,10 @@ MM_PLUGIN_API int init(){
 		.conf_instance = rtpmidi_configure_instance,
 		.channel = rtpmidi_channel,
 		.handle = rtpmidi_set,
-		.interval = rtpmidi_interval,
 		.process = rtpmidi_handle,
 		.start = rtpmidi_start,
-		.shutdown = rtpmidi_shutdown
+		.shutdown = rtpmidi_shutdown,
+		.flags = mmbackend_no_polling
 	};
 
 	if(sizeof(rtpmidi_channel_ident) != sizeof(uint64_t)){
@@ -344,10 +342,6 @@ static int rtpmidi_announce_addrs(){
 	return 0;
 }
 
-static uint32_t rtpmidi_interval(){
-	return max(0, (int64_t) RTPMIDI_SERVICE_INTERVAL - (int64_t) (mm_timestamp() - cfg.last_service));
-}
-
 static int rtpmidi_configure(char* option, char* value){
 	if(!strcmp(option, "mdns-name")){
 		if(cfg.mdns_name){
@@ -791,7 +785,7 @@ static int rtpmidi_set(instance* inst, size_t num, channel** c, channel_value* v
 	//some receivers seem to have problems reading rfcs and interpreting the marker bit correctly
 	rtp_header->mpt = (data->mode == apple ? 0 : 0x80) | RTPMIDI_HEADER_TYPE;
 	rtp_header->sequence = htobe16(data->sequence++);
-	rtp_header->timestamp = mm_timestamp() * 10; //just assume 100msec resolution because rfc4695 handwaves it
+	rtp_header->timestamp = mm_timestamp_us() / 100; //use a 10kHz clock because rfc4695 handwaves it
 	rtp_header->ssrc = htobe32(data->ssrc);
 
 	//midi command section header
@@ -957,12 +951,12 @@ static int rtpmidi_handle_applemidi(instance* inst, int fd, uint8_t* frame, size
 			case 0:
 				//this happens if we're a participant
 				sync->count++;
-				sync->timestamp[1] = htobe64(mm_timestamp() * 10);
+				sync->timestamp[1] = htobe64(mm_timestamp_us() / 100);
 				break;
 			case 1:
 				//this happens if we're an initiator
 				sync->count++;
-				sync->timestamp[2] = htobe64(mm_timestamp() * 10);
+				sync->timestamp[2] = htobe64(mm_timestamp_us() / 100);
 				break;
 			default:
 				//ignore this one
@@ -1481,11 +1475,11 @@ static int rtpmidi_service(){
 		.ssrc = 0,
 		.count = 0,
 		.timestamp = {
-			mm_timestamp() * 10
+			mm_timestamp_us() / 100
 		}
 	};
 
-	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+	if(mm_backend_instances_borrow(BACKEND_NAME, &n, &inst)){
 		LOG("Failed to fetch instances");
 		return 1;
 	}
@@ -1521,8 +1515,6 @@ static int rtpmidi_service(){
 			}
 		}
 	}
-
-	free(inst);
 	return 0;
 }
 
@@ -1733,21 +1725,20 @@ static int rtpmidi_handle_mdns(int fd){
 	return 1;
 }
 
+static int rtpmidi_service_timer(instance* inst){
+	//handle service tasks (mdns, clock sync, peer connections)
+	if(rtpmidi_service()){
+		return 1;
+	}
+	return mm_timer_add(NULL, mm_timestamp() + RTPMIDI_SERVICE_INTERVAL, rtpmidi_service_timer);
+}
+
 static int rtpmidi_handle(size_t num, managed_fd* fds){
 	size_t u;
 	int rv = 0;
 	instance* inst = NULL;
 	rtpmidi_instance_data* data = NULL;
 
-	//handle service tasks (mdns, clock sync, peer connections)
-	if(mm_timestamp() - cfg.last_service > RTPMIDI_SERVICE_INTERVAL){
-		//DBGPF("Performing service tasks, delta %" PRIu64, mm_timestamp() - cfg.last_service);
-		if(rtpmidi_service()){
-			return 1;
-		}
-		cfg.last_service = mm_timestamp();
-	}
-
 	for(u = 0; u < num; u++){
 		if(!fds[u].impl){
 			//handle mDNS discovery input
@@ -1880,7 +1871,9 @@ static int rtpmidi_start(size_t n, instance** inst){
 	}
 
 	LOGPF("Registered %" PRIsize_t " descriptors to core", fds);
-	return 0;
+
+	//run the first service cycle on the next iteration
+	return mm_timer_add(NULL, mm_timestamp(), rtpmidi_service_timer);
 }
 
 static int rtpmidi_shutdown(size_t n, instance** inst){
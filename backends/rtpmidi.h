@@ -8,11 +8,11 @@ static int rtpmidi_configure(char* option, char* value);
 static int rtpmidi_configure_instance(instance* instance, char* option, char* value);
 static int rtpmidi_instance(instance* inst);
 static channel* rtpmidi_channel(instance* instance, char* spec, uint8_t flags);
-static uint32_t rtpmidi_interval();
 static int rtpmidi_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int rtpmidi_handle(size_t num, managed_fd* fds);
 static int rtpmidi_start(size_t n, instance** inst);
 static int rtpmidi_shutdown(size_t n, instance** inst);
+static int rtpmidi_service_timer(instance* inst);
 
 #define RTPMIDI_PACKET_BUFFER 8192
 #define RTPMIDI_DEFAULT_HOST "::"
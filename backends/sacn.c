@@ -27,17 +27,16 @@ static struct /*_sacn_global_config*/ {
 	uint8_t cid[16];
 	size_t fds;
 	sacn_fd* fd;
-	uint64_t last_announce;
-	uint32_t next_frame;
 	uint8_t detect;
+	//instance lookup token
+	size_t instances;
 } global_cfg = {
 	.source_name = "MIDIMonster",
 	.cid = {'M', 'I', 'D', 'I', 'M', 'o', 'n', 's', 't', 'e', 'r'},
 	.fds = 0,
 	.fd = NULL,
-	.last_announce = 0,
-	.next_frame = 0,
-	.detect = 0
+	.detect = 0,
+	.instances = 0
 };
 
 MM_PLUGIN_API int init(){
@@ -47,11 +46,12 @@ MM_PLUGIN_API int init(){
 		.create = sacn_instance,
 		.conf_instance = sacn_configure_instance,
 		.channel = sacn_channel,
+		.channel_range = sacn_channel_range,
 		.handle = sacn_set,
 		.process = sacn_handle,
 		.start = sacn_start,
-		.interval = sacn_interval,
-		.shutdown = sacn_shutdown
+		.shutdown = sacn_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe
 	};
 
 	if(sizeof(sacn_instance_id) != sizeof(uint64_t)){
@@ -68,13 +68,6 @@ MM_PLUGIN_API int init(){
 	return 0;
 }
 
-static uint32_t sacn_interval(){
-	if(global_cfg.next_frame){
-		return global_cfg.next_frame;
-	}
-	return SACN_KEEPALIVE_INTERVAL;
-}
-
 static int sacn_listener(char* host, char* port, uint8_t flags){
 	int fd = -1, yes = 1;
 	if(global_cfg.fds >= MAX_FDS){
@@ -292,6 +285,34 @@ static channel* sacn_channel(instance* inst, char* spec, uint8_t flags){
 	return data->data.channel + chan_a;
 }
 
+static size_t sacn_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
+	size_t u;
+
+	//wide channels are only handled by the single channel parser
+	if(*prefix || *suffix || !first || first + count - 1 > 512){
+		return 0;
+	}
+	first--;
+
+	//let the single channel parser report mode conflicts
+	for(u = first; u < first + count; u++){
+		if(IS_ACTIVE(data->data.map[u]) && data->data.map[u] != (MAP_SINGLE | u)){
+			return 0;
+		}
+	}
+
+	if((flags & mmchannel_output) && !data->xmit_prio){
+		LOGPF("Channels %s.%" PRIu64 " to %" PRIu64 " mapped for output, but instance is not configured for output (no priority set)", inst->name, first + 1, first + count);
+	}
+
+	for(u = 0; u < count; u++){
+		data->data.map[first + u] = MAP_SINGLE | (first + u);
+		channels[u] = data->data.channel + first + u;
+	}
+	return count;
+}
+
 static int sacn_transmit(instance* inst, sacn_output_universe* output){
 	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
 
@@ -340,23 +361,45 @@ static int sacn_transmit(instance* inst, sacn_output_universe* output){
 		}
 
 		//reschedule output
-		output->mark = 1;
-		if(!global_cfg.next_frame || global_cfg.next_frame > SACN_SYNTHESIZE_MARGIN){
-			global_cfg.next_frame = SACN_SYNTHESIZE_MARGIN;
+		return mm_timer_add(inst, mm_timestamp() + SACN_SYNTHESIZE_MARGIN, sacn_output_timer);
+	}
+
+	inst->stats.bytes_out += sizeof(pdu);
+	inst->stats.packets_out++;
+
+	//update last transmit timestamp, schedule next keepalive
+	output->last_frame = mm_timestamp_us();
+	return mm_timer_add(inst, mm_timestamp() + SACN_KEEPALIVE_INTERVAL, sacn_output_timer);
+}
+
+static sacn_output_universe* sacn_output(instance* inst){
+	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
+	size_t u;
+
+	for(u = 0; u < global_cfg.fd[data->fd_index].universes; u++){
+		if(global_cfg.fd[data->fd_index].universe[u].universe == data->uni){
+			return global_cfg.fd[data->fd_index].universe + u;
 		}
-		return 0;
 	}
+	return NULL;
+}
+
+static int sacn_output_timer(instance* inst){
+	sacn_output_universe* output = sacn_output(inst);
 
-	//update last transmit timestamp, unmark instance
-	output->last_frame = mm_timestamp();
-	output->mark = 0;
+	//transmit keepalive or synthesized frame, transient network errors must not stop the keepalives
+	if(output && sacn_transmit(inst, output)){
+		LOGPF("Retrying output for instance %s in %d msec", inst->name, SACN_KEEPALIVE_INTERVAL);
+		return mm_timer_add(inst, mm_timestamp() + SACN_KEEPALIVE_INTERVAL, sacn_output_timer);
+	}
 	return 0;
 }
 
 static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
 	size_t u, mark = 0;
-	uint32_t frame_delta = 0;
+	uint64_t frame_delta = 0;
 	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
+	sacn_output_universe* output = NULL;
 
 	if(!data->xmit_prio){
 		LOGPF("Instance %s not enabled for output (%" PRIsize_t " channel events)", inst->name, num);
@@ -386,34 +429,26 @@ static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
 	//send packet if required
 	if(mark){
 		//find output control data for the instance
-		for(u = 0; u < global_cfg.fd[data->fd_index].universes; u++){
-			if(global_cfg.fd[data->fd_index].universe[u].universe == data->uni){
-				break;
-			}
-		}
+		output = sacn_output(inst);
 
 		if(!data->realtime){
-			frame_delta = mm_timestamp() - global_cfg.fd[data->fd_index].universe[u].last_frame;
+			frame_delta = mm_timestamp_us() - output->last_frame;
 
-			//check if ratelimiting engaged
-			if(frame_delta < SACN_FRAME_TIMEOUT){
-				global_cfg.fd[data->fd_index].universe[u].mark = 1;
-				if(!global_cfg.next_frame || global_cfg.next_frame > (SACN_FRAME_TIMEOUT - frame_delta)){
-					global_cfg.next_frame = (SACN_FRAME_TIMEOUT - frame_delta);
-				}
-				return 0;
+			//check if ratelimiting engaged, request next frame
+			if(frame_delta < SACN_FRAME_TIMEOUT * 1000){
+				return mm_timer_add(inst, (output->last_frame + (SACN_FRAME_TIMEOUT + SACN_SYNTHESIZE_MARGIN) * 1000 + 999) / 1000, sacn_output_timer);
 			}
 		}
-		sacn_transmit(inst, global_cfg.fd[data->fd_index].universe + u);
+		sacn_transmit(inst, output);
 	}
 
 	return 0;
 }
 
 static int sacn_process_frame(instance* inst, sacn_frame_root* frame, sacn_frame_data* data){
-	size_t u, max_mark = 0;
-	channel* chan = NULL;
-	channel_value val;
+	size_t u, max_mark = 0, events = 0;
+	channel* chan[512];
+	channel_value val[512];
 	sacn_instance_data* inst_data = (sacn_instance_data*) inst->impl;
 
 	//source filtering
@@ -466,29 +501,31 @@ static int sacn_process_frame(instance* inst, sacn_frame_root* frame, sacn_frame
 		if(inst_data->data.map[u] & MAP_MARK){
 			//unmark and get channel
 			inst_data->data.map[u] &= ~MAP_MARK;
-			chan = inst_data->data.channel + u;
+			chan[events] = inst_data->data.channel + u;
 			if(inst_data->data.map[u] & MAP_FINE){
-				chan = inst_data->data.channel + MAPPED_CHANNEL(inst_data->data.map[u]);
+				chan[events] = inst_data->data.channel + MAPPED_CHANNEL(inst_data->data.map[u]);
 			}
 
 			//generate value
 			if(IS_WIDE(inst_data->data.map[u])){
 				inst_data->data.map[MAPPED_CHANNEL(inst_data->data.map[u])] &= ~MAP_MARK;
-				val.raw.u64 = (uint16_t) (inst_data->data.in[u] << ((inst_data->data.map[u] & MAP_COARSE) ? 8 : 0));
-				val.raw.u64 |= (uint16_t) (inst_data->data.in[MAPPED_CHANNEL(inst_data->data.map[u])] << ((inst_data->data.map[u] & MAP_COARSE) ? 0 : 8));
-				val.normalised = (double) val.raw.u64 / (double) 0xFFFF;
+				val[events].raw.u64 = (uint16_t) (inst_data->data.in[u] << ((inst_data->data.map[u] & MAP_COARSE) ? 8 : 0));
+				val[events].raw.u64 |= (uint16_t) (inst_data->data.in[MAPPED_CHANNEL(inst_data->data.map[u])] << ((inst_data->data.map[u] & MAP_COARSE) ? 0 : 8));
+				val[events].normalised = (double) val[events].raw.u64 / (double) 0xFFFF;
 			}
 			else{
-				val.raw.u64 = inst_data->data.in[u];
-				val.normalised = (double) val.raw.u64 / 255.0;
-			}
-
-			if(mm_channel_event(chan, val)){
-				LOG("Failed to push event to core");
-				return 1;
+				val[events].raw.u64 = inst_data->data.in[u];
+				val[events].normalised = (double) val[events].raw.u64 / 255.0;
 			}
+			events++;
 		}
 	}
+
+	//push all events for this frame at once
+	if(events && mm_channel_events(events, chan, val)){
+		LOG("Failed to push events to core");
+		return 1;
+	}
 	return 0;
 }
 
@@ -546,10 +583,21 @@ static void sacn_discovery(size_t fd){
 	}
 }
 
+static int sacn_discovery_timer(instance* inst){
+	size_t u;
+
+	//send universe discovery pdu
+	for(u = 0; u < global_cfg.fds; u++){
+		if(global_cfg.fd[u].universes){
+			sacn_discovery(u);
+		}
+	}
+
+	return mm_timer_add(NULL, mm_timestamp() + SACN_DISCOVERY_TIMEOUT, sacn_discovery_timer);
+}
+
 static int sacn_handle(size_t num, managed_fd* fds){
-	size_t u, c;
-	uint64_t timestamp = mm_timestamp();
-	uint32_t synthesize_delta = 0;
+	size_t u;
 	ssize_t bytes_read;
 	char recv_buf[SACN_RECV_BUF];
 	instance* inst = NULL;
@@ -559,42 +607,6 @@ static int sacn_handle(size_t num, managed_fd* fds){
 	sacn_frame_root* frame = (sacn_frame_root*) recv_buf;
 	sacn_frame_data* data = (sacn_frame_data*) (recv_buf + sizeof(sacn_frame_root));
 
-	if(timestamp - global_cfg.last_announce > SACN_DISCOVERY_TIMEOUT){
-		//send universe discovery pdu
-		for(u = 0; u < global_cfg.fds; u++){
-			if(global_cfg.fd[u].universes){
-				sacn_discovery(u);
-			}
-		}
-		global_cfg.last_announce = timestamp;
-	}
-
-	//check for keepalive frames, synthesize frames if necessary
-	global_cfg.next_frame = 0;
-	for(u = 0; u < global_cfg.fds; u++){
-		for(c = 0; c < global_cfg.fd[u].universes; c++){
-			synthesize_delta = timestamp - global_cfg.fd[u].universe[c].last_frame;
-
-			if((global_cfg.fd[u].universe[c].mark
-						&& synthesize_delta >= SACN_FRAME_TIMEOUT + SACN_SYNTHESIZE_MARGIN)
-					|| synthesize_delta >= SACN_KEEPALIVE_INTERVAL){
-				instance_id.fields.fd_index = u;
-				instance_id.fields.uni = global_cfg.fd[u].universe[c].universe;
-				inst = mm_instance_find(BACKEND_NAME, instance_id.label);
-				if(inst){
-					sacn_transmit(inst, global_cfg.fd[u].universe + c);
-				}
-			}
-
-			//update next frame request
-			if(global_cfg.fd[u].universe[c].mark
-					&& (!global_cfg.next_frame || global_cfg.next_frame > SACN_FRAME_TIMEOUT + SACN_SYNTHESIZE_MARGIN - synthesize_delta)){
-				global_cfg.next_frame = SACN_FRAME_TIMEOUT + SACN_SYNTHESIZE_MARGIN - synthesize_delta;
-			}
-
-		}
-	}
-
 	for(u = 0; u < num; u++){
 		do{
 			bytes_read = recv(fds[u].fd, recv_buf, sizeof(recv_buf), 0);
@@ -607,7 +619,12 @@ static int sacn_handle(size_t num, managed_fd* fds){
 						&& data->vector == DMP_SET_PROPERTY){
 					instance_id.fields.fd_index = ((uint64_t) fds[u].impl) & 0xFFFF;
 					instance_id.fields.uni = be16toh(data->universe);
-					inst = mm_instance_find(BACKEND_NAME, instance_id.label);
+					inst = mm_instance_lookup(global_cfg.instances, instance_id.label);
+					if(inst){
+						inst->stats.bytes_in += bytes_read;
+						inst->stats.packets_in++;
+					}
+
 					if(inst && sacn_process_frame(inst, frame, data)){
 						LOG("Failed to process frame");
 					}
@@ -729,9 +746,13 @@ static int sacn_start(size_t n, instance** inst){
 
 			global_cfg.fd[data->fd_index].universe[global_cfg.fd[data->fd_index].universes].universe = data->uni;
 			global_cfg.fd[data->fd_index].universe[global_cfg.fd[data->fd_index].universes].last_frame = 0;
-			global_cfg.fd[data->fd_index].universe[global_cfg.fd[data->fd_index].universes].mark = 0;
 			global_cfg.fd[data->fd_index].universes++;
 
+			//send the initial keepalive frame on the first iteration
+			if(mm_timer_add(inst[u], mm_timestamp(), sacn_output_timer)){
+				goto bail;
+			}
+
 			//generate multicast destination address if none set
 			if(!data->dest_len){
 				data->dest_len = sizeof(struct sockaddr_in);
@@ -743,6 +764,12 @@ static int sacn_start(size_t n, instance** inst){
 		}
 	}
 
+	//all identifiers are set, index them for the receive path
+	global_cfg.instances = mm_instance_namespace(BACKEND_NAME);
+	if(!global_cfg.instances){
+		goto bail;
+	}
+
 	LOGPF("Registering %" PRIsize_t " descriptors to core", global_cfg.fds);
 	for(u = 0; u < global_cfg.fds; u++){
 		if(mm_manage_fd(global_cfg.fd[u].fd, BACKEND_NAME, 1, (void*) u)){
@@ -750,6 +777,11 @@ static int sacn_start(size_t n, instance** inst){
 		}
 	}
 
+	//announce universes on the first iteration
+	if(mm_timer_add(NULL, mm_timestamp(), sacn_discovery_timer)){
+		goto bail;
+	}
+
 	rv = 0;
 bail:
 	return rv;
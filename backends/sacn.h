@@ -1,15 +1,17 @@
 #include "midimonster.h"
 
 MM_PLUGIN_API int init();
-static uint32_t sacn_interval();
 static int sacn_configure(char* option, char* value);
 static int sacn_configure_instance(instance* instance, char* option, char* value);
 static int sacn_instance(instance* inst);
 static channel* sacn_channel(instance* instance, char* spec, uint8_t flags);
+static size_t sacn_channel_range(instance* instance, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
 static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v);
 static int sacn_handle(size_t num, managed_fd* fds);
 static int sacn_start(size_t n, instance** inst);
 static int sacn_shutdown(size_t n, instance** inst);
+static int sacn_output_timer(instance* inst);
+static int sacn_discovery_timer(instance* inst);
 
 #define SACN_PORT "5568"
 #define SACN_RECV_BUF 8192
@@ -64,8 +66,7 @@ typedef union /*_sacn_instance_id*/ {
 
 typedef struct /*_sacn_output_universe*/ {
 	uint16_t universe;
-	uint64_t last_frame;
-	uint8_t mark;
+	uint64_t last_frame; //in microseconds, see mm_timestamp_us
 } sacn_output_universe;
 
 typedef struct /*_sacn_socket*/ {
@@ -0,0 +1,276 @@
+#define BACKEND_NAME "sink"
+
+#include <string.h>
+#include "sink.h"
+
+MM_PLUGIN_API int init(){
+	backend sink = {
+		.name = BACKEND_NAME,
+		.conf = sink_configure,
+		.create = sink_instance,
+		.conf_instance = sink_configure_instance,
+		.channel = sink_channel,
+		.channel_range = sink_channel_range,
+		.channel_restore = sink_channel_restore,
+		.handle = sink_set,
+		.process = sink_handle,
+		.start = sink_start,
+		.shutdown = sink_shutdown,
+		.flags = mmbackend_no_polling | mmbackend_shard_safe | mmbackend_shard_instances
+	};
+
+	//register backend
+	if(mm_backend_register(sink)){
+		LOG("Failed to register backend");
+		return 1;
+	}
+	return 0;
+}
+
+static int sink_configure(char* option, char* value){
+	LOG("This backend does not take global configuration");
+	return 1;
+}
+
+static int sink_configure_instance(instance* inst, char* option, char* value){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	char* next = value;
+
+	if(!strcmp(option, "channels")){
+		if(data->channel){
+			LOGPF("Channel count for instance %s must be set before mapping any channels", inst->name);
+			return 1;
+		}
+		data->channels = strtoul(value, &next, 10);
+		if(!data->channels || *next){
+			LOGPF("Invalid channel count %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "report")){
+		data->report = strtoul(value, &next, 10);
+		if(*next){
+			LOGPF("Invalid report interval %s for instance %s", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "order")){
+		if(!strcmp(value, "on")){
+			data->order = 1;
+		}
+		else if(!strcmp(value, "off")){
+			data->order = 0;
+		}
+		else{
+			LOGPF("Invalid ordering check setting %s for instance %s, use on or off", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+
+	LOGPF("Unknown instance option %s for instance %s", option, inst->name);
+	return 1;
+}
+
+static int sink_instance(instance* inst){
+	sink_instance_data* data = calloc(1, sizeof(sink_instance_data));
+	if(!data){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	data->channels = SINK_DEFAULT_CHANNELS;
+	data->report = SINK_DEFAULT_REPORT;
+	inst->impl = data;
+	return 0;
+}
+
+static int sink_channels_alloc(instance* inst){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	size_t u;
+
+	if(data->channel){
+		return 0;
+	}
+
+	data->channel = calloc(data->channels, sizeof(channel));
+	data->sequence = calloc(data->channels, sizeof(uint64_t));
+	if(!data->channel || !data->sequence){
+		LOG("Failed to allocate memory");
+		free(data->channel);
+		free(data->sequence);
+		data->channel = NULL;
+		data->sequence = NULL;
+		return 1;
+	}
+
+	for(u = 0; u < data->channels; u++){
+		data->channel[u].instance = inst;
+		data->channel[u].ident = u;
+	}
+	return 0;
+}
+
+static channel* sink_channel(instance* inst, char* spec, uint8_t flags){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	char* next = spec;
+	size_t index = strtoul(spec, &next, 10);
+
+	if(*next || !index || index > data->channels){
+		LOGPF("Invalid channel specification %s for instance %s, valid channels are 1 to %" PRIsize_t, spec, inst->name, data->channels);
+		return NULL;
+	}
+
+	if(flags & mmchannel_input){
+		LOGPF("Channel %s.%s mapped for input, sink instances do not generate events", inst->name, spec);
+	}
+
+	if(sink_channels_alloc(inst)){
+		return NULL;
+	}
+	return data->channel + index - 1;
+}
+
+static size_t sink_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	size_t u;
+
+	//let the single channel parser report invalid specifications
+	if(*prefix || *suffix || !first || first + count - 1 > data->channels){
+		return 0;
+	}
+
+	if(flags & mmchannel_input){
+		LOGPF("Channels %s.%" PRIu64 " to %" PRIu64 " mapped for input, sink instances do not generate events", inst->name, first, first + count - 1);
+	}
+
+	if(sink_channels_alloc(inst)){
+		return 0;
+	}
+
+	for(u = 0; u < count; u++){
+		channels[u] = data->channel + first - 1 + u;
+	}
+	return count;
+}
+
+static void sink_count(sink_counters* counters, size_t events, uint64_t reordered, uint8_t first, uint64_t gap){
+	//the gap is measured from the previous batch, which does not exist for the first one
+	if(!first){
+		counters->gap_min = counters->gaps ? min(counters->gap_min, gap) : gap;
+		counters->gap_max = max(counters->gap_max, gap);
+		counters->gap_total += gap;
+		counters->gaps++;
+	}
+	counters->events += events;
+	counters->reordered += reordered;
+	counters->batches++;
+}
+
+static channel* sink_channel_restore(instance* inst, uint64_t ident, uint8_t flags){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+
+	//the identifier is the channel index
+	if(ident >= data->channels){
+		LOGPF("Channel %" PRIu64 " of instance %s is not configured", ident + 1, inst->name);
+		return NULL;
+	}
+
+	if(sink_channels_alloc(inst)){
+		return NULL;
+	}
+	return data->channel + ident;
+}
+
+static int sink_set(instance* inst, size_t num, channel** c, channel_value* v){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	uint64_t reordered = 0, now = mm_timestamp_us();
+	size_t u;
+
+	//events from the generator backend carry an ascending sequence number per source
+	if(data->order){
+		for(u = 0; u < num; u++){
+			if(v[u].raw.u64 <= data->sequence[c[u]->ident]){
+				reordered++;
+			}
+			data->sequence[c[u]->ident] = v[u].raw.u64;
+		}
+	}
+
+	sink_count(&data->interval, num, reordered, !data->total.batches, now - data->last_batch);
+	sink_count(&data->total, num, reordered, !data->total.batches, now - data->last_batch);
+	data->last_batch = now;
+	return 0;
+}
+
+static int sink_handle(size_t num, managed_fd* fds){
+	//no events generated here
+	return 0;
+}
+
+static void sink_report(instance* inst, char* label, sink_counters* counters, uint64_t usecs){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+
+	LOGRPF("%s %s: %" PRIu64 " events in %" PRIu64 " batches (%.0f events/s)%s, batch gaps min/avg/max %" PRIu64 "/%" PRIu64 "/%" PRIu64 " usec",
+			inst->name, label, counters->events, counters->batches,
+			usecs ? counters->events * 1000000.0 / usecs : 0.0,
+			data->order ? (counters->reordered ? ", REORDERED" : ", ordered") : "",
+			counters->gap_min,
+			counters->gaps ? counters->gap_total / counters->gaps : 0,
+			counters->gap_max);
+	if(counters->reordered){
+		LOGRPF("%s %s: %" PRIu64 " events received out of order", inst->name, label, counters->reordered);
+	}
+}
+
+static int sink_report_timer(instance* inst){
+	sink_instance_data* data = (sink_instance_data*) inst->impl;
+	uint64_t now = mm_timestamp_us();
+
+	if(data->interval.events){
+		sink_report(inst, "interval", &data->interval, now - data->last_report);
+	}
+	memset(&data->interval, 0, sizeof(data->interval));
+	data->last_report = now;
+
+	return mm_timer_add(inst, mm_timestamp() + data->report, sink_report_timer);
+}
+
+static int sink_start(size_t n, instance** inst){
+	size_t u;
+	sink_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (sink_instance_data*) inst[u]->impl;
+		if(sink_channels_alloc(inst[u])){
+			return 1;
+		}
+
+		data->started = data->last_report = data->last_batch = mm_timestamp_us();
+		if(data->report && mm_timer_add(inst[u], mm_timestamp() + data->report, sink_report_timer)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int sink_shutdown(size_t n, instance** inst){
+	size_t u;
+	sink_instance_data* data = NULL;
+
+	for(u = 0; u < n; u++){
+		data = (sink_instance_data*) inst[u]->impl;
+		if(data->total.events){
+			sink_report(inst[u], "total", &data->total, mm_timestamp_us() - data->started);
+		}
+		free(data->channel);
+		free(data->sequence);
+		free(inst[u]->impl);
+		inst[u]->impl = NULL;
+	}
+
+	LOG("Backend shut down");
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "midimonster.h"
+
+MM_PLUGIN_API int init();
+static int sink_configure(char* option, char* value);
+static int sink_configure_instance(instance* inst, char* option, char* value);
+static int sink_instance(instance* inst);
+static channel* sink_channel(instance* inst, char* spec, uint8_t flags);
+static size_t sink_channel_range(instance* inst, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, channel** channels);
+static channel* sink_channel_restore(instance* inst, uint64_t ident, uint8_t flags);
+static int sink_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int sink_handle(size_t num, managed_fd* fds);
+static int sink_start(size_t n, instance** inst);
+static int sink_shutdown(size_t n, instance** inst);
+
+//default number of channels per instance
+#define SINK_DEFAULT_CHANNELS 512
+//default report interval in milliseconds
+#define SINK_DEFAULT_REPORT 1000
+
+typedef struct /*_sink_counters*/ {
+	uint64_t events;
+	uint64_t batches;
+	uint64_t reordered;
+	//time between consecutive event batches, in microseconds
+	uint64_t gaps;
+	uint64_t gap_min;
+	uint64_t gap_max;
+	uint64_t gap_total;
+} sink_counters;
+
+typedef struct /*_sink_instance_data*/ {
+	//configuration
+	size_t channels;
+	uint32_t report;
+	uint8_t order;
+
+	channel* channel;
+	//last sequence number seen per channel, for ordering checks
+	uint64_t* sequence;
+
+	uint64_t started;
+	uint64_t last_batch;
+	uint64_t last_report;
+	sink_counters interval;
+	sink_counters total;
+} sink_instance_data;
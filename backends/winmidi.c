@@ -33,7 +33,8 @@ MM_PLUGIN_API int init(){
 		.handle = winmidi_set,
 		.process = winmidi_handle,
 		.start = winmidi_start,
-		.shutdown = winmidi_shutdown
+		.shutdown = winmidi_shutdown,
+		.flags = mmbackend_no_polling
 	};
 
 	if(sizeof(winmidi_channel_ident) != sizeof(uint64_t)){
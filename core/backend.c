@@ -8,31 +8,174 @@
 #define BACKEND_NAME "core/be"
 #include "midimonster.h"
 #include "backend.h"
+#include "timer.h"
+#include "shard.h"
 
 static uint32_t default_interval = 1000;
 
+//hashed identifier lookup table for the instances of one backend, see mm_instance_namespace
+typedef struct /*_instance_namespace*/ {
+	size_t size;
+	instance** slot;
+} instance_namespace;
+
 static struct {
 	size_t n;
 	backend* backends;
 	instance*** instances;
+	//shards running instances of each backend, as bit mask
+	uint64_t* shards;
+	//shard running each instance, indexed by the instance index
+	size_t* placement;
+	//identifier lookup tables
+	instance_namespace* lookup;
+	//total number of instances, used to assign dense instance indices
+	size_t total;
 } registry = {
 	.n = 0
 };
 
-//the global channel store was converted from a naive list to a hashmap of lists for performance reasons
+//scratch space for grouping output events by instance in backends_notify
+static SHARD_LOCAL struct {
+	//per-instance event counts, turned into write cursors while scattering
+	size_t instances;
+	size_t* cursor;
+	//instance indices in order of their first event
+	size_t* order;
+	//grouped events
+	size_t alloc;
+	channel** channel;
+	channel_value* value;
+} notify = {
+	0
+};
+
+/*
+ * The global channel store is an open-addressing hash table with linear probing,
+ * kept at most half full. Channel structures are carved from per-instance slabs
+ * and never move once created.
+ */
+typedef struct _channel_slab {
+	struct _channel_slab* next;
+	size_t used;
+	size_t size;
+	channel channel[];
+} channel_slab;
+
 static struct {
-	//channelstore hash is set up for 256 buckets
-	size_t n[256];
-	channel** entry[256];
+	//table size, always a power of two
+	size_t size;
+	size_t n;
+	channel** entry;
+	//slab lists, indexed by instance index
+	size_t instances;
+	channel_slab** slab;
+	//channels created since channels_checkpoint, while the journal is active
+	uint8_t journal;
+	size_t created;
+	size_t alloc;
+	channel** journaled;
 } channels = {
-	.n = {
-		0
-	}
+	.size = 0
 };
 
 static size_t channelstore_hash(instance* inst, uint64_t ident){
-	uint64_t repr = ((uint64_t) inst) ^ ident;
-	return (repr ^ (repr >> 8) ^ (repr >> 16) ^ (repr >> 24) ^ (repr >> 32)) & 0xFF;
+	//64bit finalizer mix of the instance address and identifier
+	uint64_t repr = ((uint64_t) inst) ^ (ident * 0x9E3779B97F4A7C15ULL);
+	repr ^= repr >> 33;
+	repr *= 0xFF51AFD7ED558CCDULL;
+	repr ^= repr >> 33;
+	return repr & (channels.size - 1);
+}
+
+//returns the slot containing the channel, or the empty slot terminating its probe sequence
+static size_t channelstore_slot(instance* inst, uint64_t ident){
+	size_t slot = channelstore_hash(inst, ident);
+
+	for(; channels.entry[slot]; slot = (slot + 1) & (channels.size - 1)){
+		if(channels.entry[slot]->instance == inst
+				&& channels.entry[slot]->ident == ident){
+			break;
+		}
+	}
+	return slot;
+}
+
+static int channelstore_resize(size_t size){
+	size_t u, slot;
+	channel** previous = channels.entry;
+	size_t previous_size = channels.size;
+
+	channels.entry = calloc(size, sizeof(channel*));
+	if(!channels.entry){
+		LOG("Failed to allocate memory");
+		channels.entry = previous;
+		return 1;
+	}
+	channels.size = size;
+
+	DBGPF("Resizing channel store to %" PRIsize_t " slots for %" PRIsize_t " channels", size, channels.n);
+	for(u = 0; u < previous_size; u++){
+		if(previous[u]){
+			slot = channelstore_slot(previous[u]->instance, previous[u]->ident);
+			channels.entry[slot] = previous[u];
+		}
+	}
+
+	free(previous);
+	return 0;
+}
+
+//remove an entry, moving following entries of the probe sequence back to keep it contiguous
+static void channelstore_remove(size_t slot){
+	size_t next, home;
+
+	channels.entry[slot] = NULL;
+	for(next = (slot + 1) & (channels.size - 1); channels.entry[next]; next = (next + 1) & (channels.size - 1)){
+		home = channelstore_hash(channels.entry[next]->instance, channels.entry[next]->ident);
+		//move the entry if its home slot does not lie cyclically within (slot, next]
+		if(((next - home) & (channels.size - 1)) >= ((next - slot) & (channels.size - 1))){
+			channels.entry[slot] = channels.entry[next];
+			channels.entry[next] = NULL;
+			slot = next;
+		}
+	}
+	channels.n--;
+}
+
+static channel* channel_alloc(instance* inst){
+	channel_slab* slab = NULL;
+	size_t size = CHANNEL_SLAB_MIN;
+
+	if(inst->index >= channels.instances){
+		channels.slab = realloc(channels.slab, (inst->index + 1) * sizeof(channel_slab*));
+		if(!channels.slab){
+			LOG("Failed to allocate memory");
+			channels.instances = 0;
+			return NULL;
+		}
+		memset(channels.slab + channels.instances, 0, (inst->index + 1 - channels.instances) * sizeof(channel_slab*));
+		channels.instances = inst->index + 1;
+	}
+
+	slab = channels.slab[inst->index];
+	if(!slab || slab->used == slab->size){
+		//grow slabs geometrically to keep the number of allocations logarithmic
+		if(slab){
+			size = min(slab->size * 2, CHANNEL_SLAB_MAX);
+		}
+
+		slab = calloc(1, sizeof(channel_slab) + size * sizeof(channel));
+		if(!slab){
+			LOG("Failed to allocate memory");
+			return NULL;
+		}
+		slab->size = size;
+		slab->next = channels.slab[inst->index];
+		channels.slab[inst->index] = slab;
+	}
+
+	return slab->channel + (slab->used++);
 }
 
 int backends_handle(size_t nfds, managed_fd* fds){
@@ -41,6 +184,11 @@ int backends_handle(size_t nfds, managed_fd* fds){
 	managed_fd xchg;
 
 	for(u = 0; u < registry.n && !rv; u++){
+		//backends on other shards are handled by their own thread
+		if(!(registry.shards[u] & SHARD_BIT(shard_current()))){
+			continue;
+		}
+
 		n = 0;
 
 		for(p = 0; p < nfds; p++){
@@ -53,7 +201,7 @@ int backends_handle(size_t nfds, managed_fd* fds){
 		}
 
 		//handle if there is data ready or the backend has active instances for polling
-		if(n || registry.instances[u]){
+		if(n || (registry.instances[u] && !(registry.backends[u].flags & mmbackend_no_polling))){
 			DBGPF("Notifying backend %s of %" PRIsize_t " waiting FDs", registry.backends[u].name, n);
 			rv |= registry.backends[u].process(n, fds);
 			if(rv){
@@ -64,117 +212,188 @@ int backends_handle(size_t nfds, managed_fd* fds){
 	return rv;
 }
 
+static int backends_notify_alloc(size_t nev){
+	if(notify.instances < registry.total){
+		notify.cursor = realloc(notify.cursor, registry.total * sizeof(size_t));
+		notify.order = realloc(notify.order, registry.total * sizeof(size_t));
+		if(!notify.cursor || !notify.order){
+			LOG("Failed to allocate memory");
+			notify.instances = 0;
+			return 1;
+		}
+		memset(notify.cursor + notify.instances, 0, (registry.total - notify.instances) * sizeof(size_t));
+		notify.instances = registry.total;
+	}
+
+	if(notify.alloc < nev){
+		notify.channel = realloc(notify.channel, nev * sizeof(channel*));
+		notify.value = realloc(notify.value, nev * sizeof(channel_value));
+		if(!notify.channel || !notify.value){
+			LOG("Failed to allocate memory");
+			notify.alloc = 0;
+			return 1;
+		}
+		notify.alloc = nev;
+	}
+	return 0;
+}
+
 int backends_notify(size_t nev, channel** c, channel_value* v){
-	size_t u, p, n;
+	size_t u, n = 0, offset = 0, count;
 	int rv = 0;
-	channel_value xval;
-	channel* xchnl = NULL;
-
-	for(u = 0; u < nev && !rv; u = n){
-		//sort for this instance
-		n = u + 1;
-		for(p = u + 1; p < nev; p++){
-			if(c[p]->instance == c[u]->instance){
-				xval = v[p];
-				xchnl = c[p];
-
-				v[p] = v[n];
-				c[p] = c[n];
-
-				v[n] = xval;
-				c[n] = xchnl;
-				n++;
-			}
+	instance* inst = NULL;
+
+	if(backends_notify_alloc(nev)){
+		return 1;
+	}
+
+	//count events per instance, remembering the order in which instances first appear
+	for(u = 0; u < nev; u++){
+		if(!notify.cursor[c[u]->instance->index]++){
+			notify.order[n++] = c[u]->instance->index;
 		}
+	}
+
+	//turn the counts into start offsets
+	for(u = 0; u < n; u++){
+		count = notify.cursor[notify.order[u]];
+		notify.cursor[notify.order[u]] = offset;
+		offset += count;
+	}
+
+	//scatter the events, this keeps the relative order within each instance
+	for(u = 0; u < nev; u++){
+		notify.channel[notify.cursor[c[u]->instance->index]] = c[u];
+		notify.value[notify.cursor[c[u]->instance->index]] = v[u];
+		notify.cursor[c[u]->instance->index]++;
+	}
+
+	//the cursors now point to the end of each slice
+	for(u = 0, offset = 0; u < n; u++){
+		count = notify.cursor[notify.order[u]] - offset;
+		notify.cursor[notify.order[u]] = 0;
 
 		/*
 		 * Do not eliminate duplicates here. There are legitimate uses for a channel occuring multiple times
 		 * in one loop iteration, e.g. stateful OSC layer selectors.
 		 */
-		DBGPF("Calling handler for instance %s with %" PRIsize_t " events", c[u]->instance->name, n - u);
-		rv |= c[u]->instance->backend->handle(c[u]->instance, n - u, c + u, v + u);
+		inst = notify.channel[offset]->instance;
+		inst->stats.events_out += count;
+		if(!rv){
+			DBGPF("Calling handler for instance %s with %" PRIsize_t " events", inst->name, count);
+			rv |= inst->backend->handle(inst, count, notify.channel + offset, notify.value + offset);
+		}
+		offset += count;
 	}
 
 	return 0;
 }
 
 MM_API channel* mm_channel(instance* inst, uint64_t ident, uint8_t create){
-	size_t u, bucket = channelstore_hash(inst, ident);
-	DBGPF("\tSearching for inst %" PRIu64 " ident %" PRIu64, (uint64_t) inst, ident);
-	for(u = 0; u < channels.n[bucket]; u++){
-		DBGPF("\tBucket %" PRIsize_t " entry %" PRIsize_t " inst %" PRIu64 " ident %" PRIu64, bucket, u, (uint64_t) channels.entry[bucket][u]->instance, channels.entry[bucket][u]->ident);
-		if(channels.entry[bucket][u]->instance == inst
-				&& channels.entry[bucket][u]->ident == ident){
-			DBGPF("Requested channel %" PRIu64 " on instance %s already exists, reusing (bucket %" PRIsize_t ", %" PRIsize_t " search steps)", ident, inst->name, bucket, u);
-			return channels.entry[bucket][u];
+	size_t slot;
+	channel* chan = NULL;
+
+	if(channels.size){
+		slot = channelstore_slot(inst, ident);
+		if(channels.entry[slot]){
+			DBGPF("Requested channel %" PRIu64 " on instance %s already exists, reusing (slot %" PRIsize_t ")", ident, inst->name, slot);
+			return channels.entry[slot];
 		}
 	}
 
 	if(!create){
-		DBGPF("Requested unknown channel %" PRIu64 " (bucket %" PRIsize_t ") on instance %s", ident, bucket, inst->name);
+		DBGPF("Requested unknown channel %" PRIu64 " on instance %s", ident, inst->name);
 		return NULL;
 	}
 
-	DBGPF("Creating previously unknown channel %" PRIu64 " on instance %s, bucket %" PRIsize_t, ident, inst->name, bucket);
-	channels.entry[bucket] = realloc(channels.entry[bucket], (channels.n[bucket] + 1) * sizeof(channel*));
-	if(!channels.entry[bucket]){
-		LOG("Failed to allocate memory");
-		channels.n[bucket] = 0;
+	//keep the table at most half full
+	if((channels.n + 1) * 2 > channels.size
+			&& channelstore_resize(channels.size ? channels.size * 2 : CHANNELSTORE_INITIAL)){
 		return NULL;
 	}
 
-	channels.entry[bucket][channels.n[bucket]] = calloc(1, sizeof(channel));
-	if(!channels.entry[bucket][channels.n[bucket]]){
-		LOG("Failed to allocate memory");
+	chan = channel_alloc(inst);
+	if(!chan){
 		return NULL;
 	}
 
-	channels.entry[bucket][channels.n[bucket]]->instance = inst;
-	channels.entry[bucket][channels.n[bucket]]->ident = ident;
-	return channels.entry[bucket][(channels.n[bucket]++)];
+	if(channels.journal && channels.created >= channels.alloc){
+		channels.journaled = realloc(channels.journaled, (channels.alloc + CHANNELSTORE_INITIAL) * sizeof(channel*));
+		if(!channels.journaled){
+			LOG("Failed to allocate memory");
+			channels.alloc = channels.created = 0;
+			return NULL;
+		}
+		channels.alloc += CHANNELSTORE_INITIAL;
+	}
+
+	chan->instance = inst;
+	chan->ident = ident;
+	if(channels.journal){
+		channels.journaled[channels.created++] = chan;
+	}
+	slot = channelstore_slot(inst, ident);
+	DBGPF("Creating previously unknown channel %" PRIu64 " on instance %s, slot %" PRIsize_t, ident, inst->name, slot);
+	channels.entry[slot] = chan;
+	channels.n++;
+	return chan;
 }
 
-MM_API void mm_channel_update(channel* chan, uint64_t ident){
-	size_t bucket = channelstore_hash(chan->instance, chan->ident), new_bucket = channelstore_hash(chan->instance, ident);
-	size_t u;
+void channels_checkpoint(){
+	channels.journal = 1;
+	channels.created = 0;
+}
 
-	DBGPF("Updating identifier for inst %" PRIu64 " ident %" PRIu64 " (bucket %" PRIsize_t " to %" PRIsize_t ") to %" PRIu64, (uint64_t) chan->instance, chan->ident, bucket, new_bucket, ident);
+void channels_restore(uint8_t discard){
+	size_t u, slot, removed = 0;
+	channel* chan = NULL;
 
-	if(bucket == new_bucket){
-		chan->ident = ident;
-		return;
-	}
+	//remove in reverse order of creation, the channel structures stay allocated within their slabs
+	for(u = channels.created; discard && u > 0; u--){
+		chan = channels.journaled[u - 1];
+		slot = channelstore_slot(chan->instance, chan->ident);
+		if(channels.entry[slot] != chan){
+			continue;
+		}
 
-	for(u = 0; u < channels.n[bucket]; u++){
-		if(channels.entry[bucket][u]->instance == chan->instance
-				&& channels.entry[bucket][u]->ident == chan->ident){
-			break;
+		DBGPF("Removing channel %" PRIu64 " on instance %s created by a discarded configuration", chan->ident, chan->instance->name);
+		if(chan->impl && chan->instance->backend->channel_free){
+			chan->instance->backend->channel_free(chan);
 		}
+		chan->impl = NULL;
+		channelstore_remove(slot);
+		removed++;
 	}
 
-	if(u == channels.n[bucket]){
-		DBGPF("Failed to find channel to update in bucket %" PRIsize_t, bucket);
-		return;
+	if(removed){
+		LOGPF("Removed %" PRIsize_t " channels created by the discarded configuration", removed);
 	}
 
-	DBGPF("Removing channel from slot %" PRIsize_t " of %" PRIsize_t " of bucket %" PRIsize_t, u, channels.n[bucket], bucket);
-	//remove channel from old bucket
-	for(; u < channels.n[bucket] - 1; u++){
-		channels.entry[bucket][u] = channels.entry[bucket][u + 1];
+	free(channels.journaled);
+	channels.journaled = NULL;
+	channels.journal = 0;
+	channels.created = channels.alloc = 0;
+}
+
+MM_API void mm_channel_update(channel* chan, uint64_t ident){
+	size_t slot;
+
+	DBGPF("Updating identifier for inst %" PRIu64 " ident %" PRIu64 " to %" PRIu64, (uint64_t) chan->instance, chan->ident, ident);
+	if(!channels.size){
+		return;
 	}
 
-	//add to new bucket
-	channels.entry[new_bucket] = realloc(channels.entry[new_bucket], (channels.n[new_bucket] + 1) * sizeof(channel*));
-	if(!channels.entry[new_bucket]){
-		LOG("Failed to allocate memory");
-		channels.n[new_bucket] = 0;
+	slot = channelstore_slot(chan->instance, chan->ident);
+	if(channels.entry[slot] != chan){
+		DBGPF("Failed to find channel to update in slot %" PRIsize_t, slot);
 		return;
 	}
 
-	channels.entry[new_bucket][channels.n[new_bucket]] = chan;
+	//remove and re-insert under the new identifier
+	channelstore_remove(slot);
 	chan->ident = ident;
-	channels.n[bucket]--;
-	channels.n[new_bucket]++;
+	channels.entry[channelstore_slot(chan->instance, ident)] = chan;
+	channels.n++;
 }
 
 instance* mm_instance(backend* b){
@@ -199,6 +418,7 @@ instance* mm_instance(backend* b){
 				LOG("Failed to allocate memory");
 			}
 			registry.instances[u][n]->backend = b;
+			registry.instances[u][n]->index = registry.total++;
 			return registry.instances[u][n];
 		}
 	}
@@ -223,6 +443,89 @@ MM_API instance* mm_instance_find(char* name, uint64_t ident){
 	return NULL;
 }
 
+static size_t namespace_hash(uint64_t ident, size_t size){
+	ident ^= ident >> 33;
+	ident *= 0xFF51AFD7ED558CCDULL;
+	ident ^= ident >> 33;
+	return ident & (size - 1);
+}
+
+MM_API size_t mm_instance_namespace(char* name){
+	size_t u, n, slot;
+	backend* b = backend_match(name);
+	instance_namespace* lookup = NULL;
+	instance** iter = NULL;
+
+	if(!b){
+		LOGPF("Unknown backend %s requested an instance namespace", name);
+		return 0;
+	}
+	lookup = registry.lookup + (b - registry.backends);
+
+	//size the table to be at most half full
+	for(n = 0, iter = registry.instances[b - registry.backends]; iter && *iter; iter++, n++){
+	}
+	for(u = 8; u < 2 * n; u *= 2){
+	}
+
+	free(lookup->slot);
+	lookup->slot = calloc(u, sizeof(instance*));
+	if(!lookup->slot){
+		LOG("Failed to allocate memory");
+		lookup->size = 0;
+		return 0;
+	}
+	lookup->size = u;
+
+	//insert in registration order, the first instance with an identifier wins as in mm_instance_find
+	for(iter = registry.instances[b - registry.backends]; iter && *iter; iter++){
+		for(slot = namespace_hash((*iter)->ident, lookup->size); lookup->slot[slot]; slot = (slot + 1) & (lookup->size - 1)){
+			if(lookup->slot[slot]->ident == (*iter)->ident){
+				break;
+			}
+		}
+
+		if(!lookup->slot[slot]){
+			lookup->slot[slot] = *iter;
+		}
+	}
+
+	return (b - registry.backends) + 1;
+}
+
+MM_API instance* mm_instance_lookup(size_t token, uint64_t ident){
+	size_t slot;
+	instance_namespace* lookup = NULL;
+
+	if(!token || token > registry.n || !registry.lookup[token - 1].size){
+		return NULL;
+	}
+
+	lookup = registry.lookup + token - 1;
+
+	for(slot = namespace_hash(ident, lookup->size); lookup->slot[slot]; slot = (slot + 1) & (lookup->size - 1)){
+		if(lookup->slot[slot]->ident == ident){
+			return lookup->slot[slot];
+		}
+	}
+	return NULL;
+}
+
+MM_API int mm_backend_instances_borrow(char* name, size_t* ninst, instance*** inst){
+	size_t i = 0;
+	backend* b = backend_match(name);
+	if(!ninst || !inst || !b){
+		return 1;
+	}
+
+	//instances are only created while parsing the configuration, so the list is stable after startup
+	*inst = registry.instances[b - registry.backends];
+	for(i = 0; *inst && (*inst)[i]; i++){
+	}
+	*ninst = i;
+	return 0;
+}
+
 MM_API int mm_backend_instances(char* name, size_t* ninst, instance*** inst){
 	size_t b = 0, i = 0;
 	if(!ninst || !inst){
@@ -285,11 +588,12 @@ void mm_default_interval(uint32_t interval, uint8_t force){
 
 struct timeval backend_timeout(){
 	size_t u;
+	uint64_t next = timers_next(), usecs;
 	uint32_t res, secs = default_interval / 1000, msecs = default_interval % 1000;
 
 	for(u = 0; u < registry.n; u++){
 		//only call interval if backend has instances
-		if(registry.instances[u] && registry.backends[u].interval){
+		if(registry.instances[u] && registry.backends[u].interval && (registry.shards[u] & SHARD_BIT(shard_current()))){
 			res = registry.backends[u].interval();
 			if(res && (res / 1000) < secs){
 				DBGPF("Updating interval to %" PRIu32 " msecs by request from %s", res, registry.backends[u].name);
@@ -303,24 +607,98 @@ struct timeval backend_timeout(){
 		}
 	}
 
+	//do not sleep past the next timer deadline, computed with microsecond precision
+	usecs = secs * 1000000 + msecs * 1000;
+	if(next){
+		next = (next * 1000 > mm_timestamp_us()) ? (next * 1000 - mm_timestamp_us()) : 0;
+		if(next < usecs){
+			DBGPF("Updating interval to %" PRIu64 " usecs for pending timer", next);
+			usecs = next;
+		}
+	}
+
 	struct timeval tv = {
-		secs,
-		msecs * 1000
+		usecs / 1000000,
+		usecs % 1000000
 	};
 	return tv;
 }
 
+backend* backends_list(size_t* n){
+	*n = registry.n;
+	return registry.backends;
+}
+
+instance** backend_instances(backend* b){
+	return registry.instances[b - registry.backends];
+}
+
+size_t instances_count(){
+	return registry.total;
+}
+
+int backends_assign_shards(){
+	size_t u, p, shard, next = 0;
+	instance** inst = NULL;
+
+	free(registry.placement);
+	registry.placement = calloc(max(registry.total, 1), sizeof(size_t));
+	if(!registry.placement){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	for(u = 0; u < registry.n; u++){
+		inst = registry.instances[u];
+		//backends without instances may still receive descriptors on the main thread
+		registry.shards[u] = SHARD_BIT(0);
+		//backends not marked as shard-safe always run on the main thread
+		if(shards_count() < 2 || !inst || !(registry.backends[u].flags & mmbackend_shard_safe)){
+			continue;
+		}
+
+		//independent instances are distributed round-robin, all other backends as a whole
+		registry.shards[u] = 0;
+		shard = 1 + (next++ % (shards_count() - 1));
+		for(p = 0; inst[p]; p++){
+			if(p && (registry.backends[u].flags & mmbackend_shard_instances)){
+				shard = 1 + (next++ % (shards_count() - 1));
+			}
+			registry.placement[inst[p]->index] = shard;
+			registry.shards[u] |= SHARD_BIT(shard);
+			DBGPF("Instance %s runs on shard %" PRIsize_t, inst[p]->name, shard);
+		}
+
+		if(registry.backends[u].flags & mmbackend_shard_instances){
+			LOGPF("Backend %s distributes %" PRIsize_t " instances across %" PRIsize_t " shards", registry.backends[u].name, p, min(p, shards_count() - 1));
+		}
+		else{
+			LOGPF("Backend %s runs on shard %" PRIsize_t, registry.backends[u].name, shard);
+		}
+	}
+	return 0;
+}
+
+size_t instance_shard(instance* inst){
+	return registry.placement ? registry.placement[inst->index] : 0;
+}
+
 MM_API int mm_backend_register(backend b){
 	if(!backend_match(b.name)){
 		registry.backends = realloc(registry.backends, (registry.n + 1) * sizeof(backend));
 		registry.instances = realloc(registry.instances, (registry.n + 1) * sizeof(instance**));
-		if(!registry.backends || !registry.instances){
+		registry.shards = realloc(registry.shards, (registry.n + 1) * sizeof(uint64_t));
+		registry.lookup = realloc(registry.lookup, (registry.n + 1) * sizeof(instance_namespace));
+		if(!registry.backends || !registry.instances || !registry.shards || !registry.lookup){
 			LOG("Failed to allocate memory");
 			registry.n = 0;
 			return 1;
 		}
 		registry.backends[registry.n] = b;
 		registry.instances[registry.n] = NULL;
+		registry.shards[registry.n] = SHARD_BIT(0);
+		registry.lookup[registry.n].size = 0;
+		registry.lookup[registry.n].slot = NULL;
 		registry.n++;
 
 		LOGPF("Registered backend %s", b.name);
@@ -331,51 +709,75 @@ MM_API int mm_backend_register(backend b){
 
 int backends_start(){
 	int rv = 0, current;
-	instance** inst = NULL;
-	size_t n, u;
+	instance** inst = NULL, **local = NULL;
+	size_t n, u, p, count;
 
 	for(u = 0; u < registry.n; u++){
-		//skip backends without instances
-		if(!registry.instances[u]){
+		//skip backends without instances or running on another shard
+		if(!registry.instances[u] || !(registry.shards[u] & SHARD_BIT(shard_current()))){
 			continue;
 		}
 
-		//fetch list of instances
-		if(mm_backend_instances(registry.backends[u].name, &n, &inst)){
-			LOGPF("Failed to fetch instance list for initialization of backend %s", registry.backends[u].name);
-			return 1;
+		//count instances
+		inst = registry.instances[u];
+		for(n = 0; inst[n]; n++){
+		}
+
+		//distributed backends are started once per shard, with the instances running on it
+		if(registry.backends[u].flags & mmbackend_shard_instances){
+			local = calloc(n, sizeof(instance*));
+			if(!local){
+				LOG("Failed to allocate memory");
+				return 1;
+			}
+
+			for(p = 0, count = 0; p < n; p++){
+				if(instance_shard(inst[p]) == shard_current()){
+					local[count++] = inst[p];
+				}
+			}
+			current = registry.backends[u].start(count, local);
+			free(local);
+		}
+		else{
+			current = registry.backends[u].start(n, inst);
 		}
 
-		//start the backend
-		current = registry.backends[u].start(n, inst);
 		if(current){
 			LOGPF("Failed to start backend %s", registry.backends[u].name);
 		}
-
-		//clean up
-		free(inst);
-		inst = NULL;
 		rv |= current;
 	}
 	return rv;
 }
 
 static void channels_free(){
-	size_t u, p;
-	for(u = 0; u < sizeof(channels.n) / sizeof(channels.n[0]); u++){
-		DBGPF("Cleaning up channel registry bucket %" PRIsize_t " with %" PRIsize_t " channels", u, channels.n[u]);
-		for(p = 0; p < channels.n[u]; p++){
-			DBGPF("Destroying channel %" PRIu64 " on instance %s", channels.entry[u][p]->ident, channels.entry[u][p]->instance->name);
+	size_t u;
+	channel_slab* slab = NULL;
+
+	DBGPF("Cleaning up channel store with %" PRIsize_t " channels", channels.n);
+	for(u = 0; u < channels.size; u++){
+		if(channels.entry[u]){
+			DBGPF("Destroying channel %" PRIu64 " on instance %s", channels.entry[u]->ident, channels.entry[u]->instance->name);
 			//call the channel_free function if the backend supports it
-			if(channels.entry[u][p]->impl && channels.entry[u][p]->instance->backend->channel_free){
-				channels.entry[u][p]->instance->backend->channel_free(channels.entry[u][p]);
+			if(channels.entry[u]->impl && channels.entry[u]->instance->backend->channel_free){
+				channels.entry[u]->instance->backend->channel_free(channels.entry[u]);
 			}
-			free(channels.entry[u][p]);
 		}
-		free(channels.entry[u]);
-		channels.entry[u] = NULL;
-		channels.n[u] = 0;
 	}
+	free(channels.entry);
+	channels.entry = NULL;
+	channels.size = channels.n = 0;
+
+	for(u = 0; u < channels.instances; u++){
+		for(slab = channels.slab[u]; slab; slab = channels.slab[u]){
+			channels.slab[u] = slab->next;
+			free(slab);
+		}
+	}
+	free(channels.slab);
+	channels.slab = NULL;
+	channels.instances = 0;
 }
 
 int backends_stop(){
@@ -387,16 +789,12 @@ int backends_stop(){
 
 	//shut down the registry
 	for(u = 0; u < registry.n; u++){
-		//fetch list of instances
-		if(mm_backend_instances(registry.backends[u].name, &n, &inst)){
-			LOGPF("Failed to fetch instance list for shutdown of backend %s", registry.backends[u].name);
-			inst = NULL;
-			n = 0;
+		//count instances
+		inst = registry.instances[u];
+		for(n = 0; inst && inst[n]; n++){
 		}
 
-		registry.backends[u].shutdown(n, inst);
-		free(inst);
-		inst = NULL;
+		registry.backends[u].shutdown(n, n ? inst : NULL);
 
 		//free instances
 		for(inst = registry.instances[u]; inst && *inst; inst++){
@@ -407,10 +805,33 @@ int backends_stop(){
 		}
 		free(registry.instances[u]);
 		registry.instances[u] = NULL;
+		free(registry.lookup[u].slot);
 	}
 
 	free(registry.backends);
 	free(registry.instances);
+	free(registry.shards);
+	free(registry.placement);
+	free(registry.lookup);
+	registry.lookup = NULL;
+	registry.backends = NULL;
+	registry.instances = NULL;
+	registry.shards = NULL;
+	registry.placement = NULL;
 	registry.n = 0;
+	registry.total = 0;
+
+	backends_notify_free();
 	return 0;
 }
+
+void backends_notify_free(){
+	free(notify.cursor);
+	free(notify.order);
+	free(notify.channel);
+	free(notify.value);
+	notify.cursor = notify.order = NULL;
+	notify.channel = NULL;
+	notify.value = NULL;
+	notify.instances = notify.alloc = 0;
+}
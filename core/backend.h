@@ -1,12 +1,26 @@
 #include <sys/types.h>
 
+//initial channel store size, must be a power of two
+#define CHANNELSTORE_INITIAL 1024
+//number of channels in the first and the largest per-instance slab
+#define CHANNEL_SLAB_MIN 32
+#define CHANNEL_SLAB_MAX 4096
+
 /* Internal API */
 int backends_handle(size_t nfds, managed_fd* fds);
 int backends_notify(size_t nev, channel** c, channel_value* v);
+void backends_notify_free();
 backend* backend_match(char* name);
 instance* instance_match(char* name);
+backend* backends_list(size_t* n);
+instance** backend_instances(backend* b);
+size_t instances_count();
+int backends_assign_shards();
+size_t instance_shard(instance* inst);
 struct timeval backend_timeout();
 int backends_start();
+void channels_checkpoint();
+void channels_restore(uint8_t discard);
 int backends_stop();
 instance* mm_instance(backend* b);
 
@@ -17,5 +31,8 @@ void mm_default_interval(uint32_t interval, uint8_t force);
 MM_API channel* mm_channel(instance* inst, uint64_t ident, uint8_t create);
 MM_API void mm_channel_update(channel* chan, uint64_t ident);
 MM_API instance* mm_instance_find(char* name, uint64_t ident);
+MM_API size_t mm_instance_namespace(char* name);
+MM_API instance* mm_instance_lookup(size_t token, uint64_t ident);
 MM_API int mm_backend_instances(char* name, size_t* ninst, instance*** inst);
+MM_API int mm_backend_instances_borrow(char* name, size_t* ninst, instance*** inst);
 MM_API int mm_backend_register(backend b);
@@ -0,0 +1,153 @@
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/cap"
+#include "midimonster.h"
+#include "capture.h"
+#include "backend.h"
+#include "shard.h"
+
+static struct {
+	char* path;
+	FILE* file;
+	uint64_t start;
+	uint64_t events;
+	//instances already described in the capture, indexed by instance index
+	size_t instances;
+	uint8_t* described;
+} capture = {
+	0
+};
+
+int capture_configure(char* path){
+	free(capture.path);
+	capture.path = NULL;
+
+	//an empty path disables the capture, e.g. when overriding a configured one
+	if(*path){
+		capture.path = strdup(path);
+		if(!capture.path){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int capture_start(){
+	uint8_t version = CAPTURE_VERSION;
+
+	if(!capture.path){
+		return 0;
+	}
+
+	//events are written from the shard generating them, which would interleave records
+	if(shards_count() > 1){
+		LOG("Event capture is not supported with multiple threads");
+		return 1;
+	}
+
+	capture.instances = instances_count();
+	capture.described = calloc(capture.instances, sizeof(uint8_t));
+	if(!capture.described){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	capture.file = fopen(capture.path, "wb");
+	if(!capture.file){
+		LOGPF("Failed to open capture file %s: %s", capture.path, strerror(errno));
+		return 1;
+	}
+	setvbuf(capture.file, NULL, _IOFBF, CAPTURE_BUFFER);
+
+	if(fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, capture.file) != 1
+			|| fwrite(&version, sizeof(version), 1, capture.file) != 1){
+		LOGPF("Failed to write capture file %s: %s", capture.path, strerror(errno));
+		return 1;
+	}
+
+	capture.start = mm_timestamp_us();
+	capture.events = 0;
+	LOGPF("Capturing events to %s", capture.path);
+	return 0;
+}
+
+static int capture_describe(instance* inst){
+	uint8_t type = capture_record_instance;
+	uint32_t index = inst->index;
+
+	if(capture.described[inst->index]){
+		return 0;
+	}
+
+	if(fwrite(&type, sizeof(type), 1, capture.file) != 1
+			|| fwrite(&index, sizeof(index), 1, capture.file) != 1
+			|| fwrite(inst->name, strlen(inst->name) + 1, 1, capture.file) != 1){
+		return 1;
+	}
+	capture.described[inst->index] = 1;
+	return 0;
+}
+
+void capture_events(size_t n, channel** c, channel_value* v){
+	size_t u;
+	uint32_t index;
+	uint64_t timestamp;
+	uint8_t record[CAPTURE_EVENT_LENGTH] = {
+		capture_record_event
+	};
+
+	if(!capture.file){
+		return;
+	}
+
+	//all events within one core iteration share the timestamp
+	timestamp = mm_timestamp_us() - capture.start;
+	memcpy(record + 5, &timestamp, sizeof(timestamp));
+	for(u = 0; u < n; u++){
+		if(capture_describe(c[u]->instance)){
+			break;
+		}
+
+		index = c[u]->instance->index;
+		memcpy(record + 1, &index, sizeof(index));
+		memcpy(record + 13, &c[u]->ident, sizeof(uint64_t));
+		memcpy(record + 21, &v[u].raw.u64, sizeof(uint64_t));
+		memcpy(record + 29, &v[u].normalised, sizeof(double));
+		if(fwrite(record, sizeof(record), 1, capture.file) != 1){
+			break;
+		}
+	}
+	capture.events += u;
+
+	//a failing capture should not stop the event processing
+	if(u < n){
+		LOGPF("Failed to write capture file %s, stopping capture: %s", capture.path, strerror(errno));
+		fclose(capture.file);
+		capture.file = NULL;
+	}
+}
+
+void capture_stop(){
+	if(capture.file){
+		if(fclose(capture.file)){
+			LOGPF("Failed to write capture file %s: %s", capture.path, strerror(errno));
+		}
+		else{
+			LOGPF("Captured %" PRIu64 " events to %s", capture.events, capture.path);
+		}
+	}
+	capture.file = NULL;
+
+	free(capture.described);
+	capture.described = NULL;
+	capture.instances = 0;
+	free(capture.path);
+	capture.path = NULL;
+}
@@ -0,0 +1,31 @@
+/*
+ * Event capture, enabled with the `capture` core option. Every event passed to
+ * mm_channel_event() or mm_channel_events() is appended to a binary log, which
+ * can be played back using the `replay` backend.
+ *
+ * Capture format: the magic string (including the terminator), one format version
+ * byte, then a sequence of records, all integers in host byte order. Every record
+ * starts with a type byte. Instance records describe an instance the first time one
+ * of its channels generates an event and consist of the 32-bit instance index and the
+ * terminated instance name. Event records consist of the 32-bit instance index, the
+ * 64-bit timestamp in microseconds since the start of the capture, the 64-bit channel
+ * identifier, the 64-bit raw value and the normalised value as a double.
+ */
+#define CAPTURE_MAGIC "MMCAP"
+#define CAPTURE_VERSION 1
+//size of the stdio buffer for the capture file
+#define CAPTURE_BUFFER 65536
+
+enum /*_mm_capture_record*/ {
+	capture_record_instance = 1,
+	capture_record_event = 2
+};
+
+//type byte, instance, timestamp, ident, raw value, normalised value
+#define CAPTURE_EVENT_LENGTH (1 + 4 + 8 + 8 + 8 + 8)
+
+/* Internal API */
+int capture_configure(char* path);
+int capture_start();
+void capture_events(size_t n, channel** c, channel_value* v);
+void capture_stop();
@@ -4,6 +4,9 @@
 #include <errno.h>
 #ifndef _WIN32
 	#include <limits.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
 	#define MM_API __attribute__((visibility ("default")))
 #else
 	#define MM_API __attribute__((dllexport))
@@ -13,9 +16,14 @@
 #include "midimonster.h"
 #include "config.h"
 #include "backend.h"
+#include "core.h"
+#include "routing.h"
+#include "shard.h"
+#include "transform.h"
 
 static enum {
 	none,
+	core_cfg,
 	backend_cfg,
 	instance_cfg,
 	map
@@ -29,9 +37,43 @@ typedef enum {
 
 static backend* current_backend = NULL;
 static instance* current_instance = NULL;
+//set while re-reading the configuration of a running core, only mappings are applied
+static uint8_t reloading = 0;
+//set during the first pass of a reload, which checks the mappings without calling the channel parsers
+static uint8_t validating = 0;
 static size_t noverrides = 0;
 static config_override* overrides = NULL;
 
+//compiled configuration being recorded
+static struct {
+	uint8_t active;
+	size_t alloc;
+	size_t length;
+	uint8_t* data;
+	//absolute directory of the output file, recorded directories are relative to it
+	char* base;
+	//nesting depth of the configuration files being read
+	size_t depth;
+	//channels resolved while compiling, indexed by an open-addressed table keyed by the channel
+	size_t channels;
+	size_t channel_alloc;
+	config_channel* channel;
+	size_t size;
+	size_t* slot;
+} compiled = {
+	0
+};
+
+//hashes of the options applied to every backend and instance, indexed by the registry position and instance index
+static struct {
+	size_t backends;
+	uint64_t* backend;
+	size_t instances;
+	uint64_t* instance;
+} hashes = {
+	0
+};
+
 #ifdef _WIN32
 #define GETLINE_BUFFER 4096
 
@@ -102,6 +144,125 @@ static char* config_trim_line(char* in){
 	return in;
 }
 
+static uint64_t config_hash(uint64_t hash, void* data, size_t length){
+	size_t u;
+	uint8_t* bytes = (uint8_t*) data;
+
+	for(u = 0; u < length; u++){
+		hash ^= bytes[u];
+		hash *= CONFIG_HASH_PRIME;
+	}
+	return hash;
+}
+
+//fold an applied option into the hash of the backend or instance currently being configured
+static int config_hash_option(char* option, char* value){
+	size_t n, index, *count = &hashes.backends;
+	uint64_t** hash = &hashes.backend, *grown = NULL;
+
+	if(parser_state == instance_cfg){
+		index = current_instance->index;
+		count = &hashes.instances;
+		hash = &hashes.instance;
+	}
+	else if(parser_state == backend_cfg){
+		index = current_backend - backends_list(&n);
+	}
+	else{
+		return 0;
+	}
+
+	if(index >= *count){
+		grown = realloc(*hash, (index + 1) * sizeof(uint64_t));
+		if(!grown){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+		*hash = grown;
+		for(; *count <= index; (*count)++){
+			(*hash)[*count] = CONFIG_HASH_BASIS;
+		}
+	}
+
+	(*hash)[index] = config_hash((*hash)[index], option, strlen(option) + 1);
+	(*hash)[index] = config_hash((*hash)[index], value, strlen(value) + 1);
+	return 0;
+}
+
+//channel identifiers may depend on the configuration of the backend and the instance
+static uint64_t config_instance_hash(instance* inst){
+	size_t n, index = inst->backend - backends_list(&n);
+	uint64_t backend_hash = (index < hashes.backends) ? hashes.backend[index] : CONFIG_HASH_BASIS;
+	uint64_t instance_hash = (inst->index < hashes.instances) ? hashes.instance[inst->index] : CONFIG_HASH_BASIS;
+	uint64_t hash = config_hash(CONFIG_HASH_BASIS, inst->backend->name, strlen(inst->backend->name) + 1);
+
+	hash = config_hash(hash, &backend_hash, sizeof(backend_hash));
+	return config_hash(hash, &instance_hash, sizeof(instance_hash));
+}
+
+//returns the table slot of a recorded channel, or the empty slot terminating its probe sequence
+static size_t config_compiled_slot(size_t* slot, size_t size, channel* c){
+	//fibonacci hashing, the table size is a power of two
+	size_t u = (((uint64_t) c) * 0x9E3779B97F4A7C15ULL >> 32) & (size - 1);
+
+	for(; slot[u] && compiled.channel[slot[u] - 1].target != c; u = (u + 1) & (size - 1)){
+	}
+	return u;
+}
+
+static int config_compiled_channel(channel* c, char* spec, uint8_t flags){
+	size_t u, size, *slot = NULL;
+	config_channel* grown = NULL;
+
+	if(compiled.size){
+		u = config_compiled_slot(compiled.slot, compiled.size, c);
+		if(compiled.slot[u]){
+			compiled.channel[compiled.slot[u] - 1].flags |= flags;
+			return 0;
+		}
+	}
+
+	//keep the table at most half full
+	if((compiled.channels + 1) * 2 > compiled.size){
+		size = compiled.size ? compiled.size * 2 : CONFIG_COMPILED_CHUNK;
+		slot = calloc(size, sizeof(size_t));
+		if(!slot){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+
+		for(u = 0; u < compiled.size; u++){
+			if(compiled.slot[u]){
+				slot[config_compiled_slot(slot, size, compiled.channel[compiled.slot[u] - 1].target)] = compiled.slot[u];
+			}
+		}
+		free(compiled.slot);
+		compiled.slot = slot;
+		compiled.size = size;
+	}
+
+	if(compiled.channels == compiled.channel_alloc){
+		grown = realloc(compiled.channel, (compiled.channel_alloc + CONFIG_COMPILED_CHUNK) * sizeof(config_channel));
+		if(!grown){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+		compiled.channel = grown;
+		compiled.channel_alloc += CONFIG_COMPILED_CHUNK;
+	}
+
+	compiled.channel[compiled.channels].target = c;
+	compiled.channel[compiled.channels].flags = flags;
+	compiled.channel[compiled.channels].spec = strdup(spec);
+	if(!compiled.channel[compiled.channels].spec){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	compiled.channels++;
+	compiled.slot[config_compiled_slot(compiled.slot, compiled.size, c)] = compiled.channels;
+	return 0;
+}
+
 static int config_glob_parse_range(channel_glob* glob, char* spec, size_t length){
 	//FIXME might want to allow negative delimiters at some point
 	char* parse_offset = NULL;
@@ -304,12 +465,51 @@ static channel* config_glob_resolve(instance* inst, channel_spec* spec, uint64_t
 		LOGPF("Failed to match multichannel evaluation %s to a channel", resolved_spec);
 	}
 
+	//remember the resolved spec in case the channel can not be restored from its identifier
+	if(result && compiled.active && config_compiled_channel(result, resolved_spec, map_direction)){
+		result = NULL;
+	}
+
 bail:
 	free(resolved_spec);
 	return result;
 }
 
-static int config_map(char* to_raw, char* from_raw){
+static channel** config_glob_resolve_bulk(instance* inst, channel_spec* spec, uint8_t map_direction){
+	channel** result = NULL;
+	char* prefix = NULL;
+
+	//only simple ascending numeric ranges are resolved in bulk
+	if(!inst->backend->channel_range
+			|| spec->globs != 1
+			|| spec->glob[0].type != glob_range
+			|| spec->glob[0].limits.u64[0] > spec->glob[0].limits.u64[1]
+			|| spec->channels < 2){
+		return NULL;
+	}
+
+	prefix = strdup(spec->spec);
+	result = calloc(spec->channels, sizeof(channel*));
+	if(!prefix || !result){
+		LOG("Failed to allocate memory");
+		free(prefix);
+		free(result);
+		return NULL;
+	}
+	prefix[spec->glob[0].offset[0]] = 0;
+
+	if(inst->backend->channel_range(inst, prefix, spec->glob[0].limits.u64[0], spec->channels,
+				spec->spec + spec->glob[0].offset[1] + 1, map_direction, result) != spec->channels){
+		DBGPF("Backend %s did not resolve %s in bulk", inst->backend->name, spec->spec);
+		free(result);
+		result = NULL;
+	}
+
+	free(prefix);
+	return result;
+}
+
+static int config_map(char* to_raw, char* from_raw, transform_chain* transform){
 	//create a copy because the original pointer may be used multiple times
 	char* to = strdup(to_raw), *from = strdup(from_raw);
 	channel_spec spec_to = {
@@ -319,6 +519,8 @@ static int config_map(char* to_raw, char* from_raw){
 	};
 	instance* instance_to = NULL, *instance_from = NULL;
 	channel* channel_from = NULL, *channel_to = NULL;
+	channel** bulk_from = NULL, **bulk_to = NULL;
+	transform_chain* edge_transform = NULL;
 	uint64_t n = 0;
 	int rv = 1;
 
@@ -374,20 +576,40 @@ static int config_map(char* to_raw, char* from_raw){
 		goto done;
 	}
 
+	//the validation pass stops before any backend state is touched
+	if(validating){
+		rv = 0;
+		goto done;
+	}
+
+	//try to create simple ranges in one call to the backend, compiling needs the spec of every channel
+	if(!compiled.active){
+		bulk_from = config_glob_resolve_bulk(instance_from, &spec_from, mmchannel_input);
+		bulk_to = config_glob_resolve_bulk(instance_to, &spec_to, mmchannel_output);
+	}
+
 	//iterate, resolve globs and map
 	rv = 0;
 	for(n = 0; !rv && n < max(spec_from.channels, spec_to.channels); n++){
-		channel_from = config_glob_resolve(instance_from, &spec_from, min(n, spec_from.channels), mmchannel_input);
-		channel_to = config_glob_resolve(instance_to, &spec_to, min(n, spec_to.channels), mmchannel_output);
+		channel_from = bulk_from ? bulk_from[n] : config_glob_resolve(instance_from, &spec_from, min(n, spec_from.channels), mmchannel_input);
+		channel_to = bulk_to ? bulk_to[n] : config_glob_resolve(instance_to, &spec_to, min(n, spec_to.channels), mmchannel_output);
 
 		if(!channel_from || !channel_to){
 			rv = 1;
 			goto done;
 		}
-		rv |= mm_map_channel(channel_from, channel_to);
+
+		//every edge carries its own copy of the transform, as operators may keep state
+		if(transform && !(edge_transform = transform_clone(transform))){
+			rv = 1;
+			goto done;
+		}
+		rv |= mm_map_channel(channel_from, channel_to, edge_transform);
 	}
 
 done:
+	free(bulk_from);
+	free(bulk_to);
 	free(spec_from.glob);
 	free(spec_to.glob);
 	free(from);
@@ -395,10 +617,274 @@ done:
 	return rv;
 }
 
+static int config_emit(void* data, size_t length){
+	if(compiled.length + length > compiled.alloc){
+		compiled.data = realloc(compiled.data, compiled.alloc + length + CONFIG_COMPILED_CHUNK);
+		if(!compiled.data){
+			LOG("Failed to allocate memory");
+			compiled.alloc = compiled.length = 0;
+			return 1;
+		}
+		compiled.alloc += length + CONFIG_COMPILED_CHUNK;
+	}
+
+	memcpy(compiled.data + compiled.length, data, length);
+	compiled.length += length;
+	return 0;
+}
+
+static int config_record(uint8_t type, uint8_t mode, char* first, char* second, char* third){
+	uint8_t header[2] = {type, mode};
+
+	if(!compiled.active){
+		return 0;
+	}
+
+	return config_emit(header, sizeof(header))
+		|| (first && config_emit(first, strlen(first) + 1))
+		|| (second && config_emit(second, strlen(second) + 1))
+		|| (third && config_emit(third, strlen(third) + 1));
+}
+
+/*
+ * Record a directory change relative to the directory of the compiled output file,
+ * so the compiled configuration can be moved together with the files it references.
+ * Falls back to the absolute path where no relative path can be built.
+ */
+static int config_record_directory(char* directory){
+	#ifndef _WIN32
+	size_t u, common = 0, length = 0;
+	char relative[PATH_MAX * 2] = "";
+
+	if(!compiled.active){
+		return 0;
+	}
+
+	//find the longest common prefix ending at a path component boundary
+	for(u = 0; compiled.base[u] && compiled.base[u] == directory[u]; u++){
+		if(directory[u] == '/'){
+			common = u;
+		}
+	}
+	if((!compiled.base[u] && (!directory[u] || directory[u] == '/'))
+			|| (!directory[u] && compiled.base[u] == '/')){
+		common = u;
+	}
+
+	//leave every remaining component of the base directory, then descend into the target
+	for(u = common; compiled.base[u]; u++){
+		if(compiled.base[u] != '/' && compiled.base[u - 1] == '/'){
+			length += snprintf(relative + length, sizeof(relative) - min(length, sizeof(relative)), "%s..", length ? "/" : "");
+		}
+	}
+	for(; directory[common] == '/'; common++){
+	}
+	if(directory[common]){
+		length += snprintf(relative + length, sizeof(relative) - min(length, sizeof(relative)), "%s%s", length ? "/" : "", directory + common);
+	}
+
+	if(length < sizeof(relative)){
+		return config_record(record_directory, 0, length ? relative : ".", NULL, NULL);
+	}
+	#endif
+	return config_record(record_directory, 0, directory, NULL, NULL);
+}
+
+static int config_section_core(){
+	size_t u;
+
+	if(config_record(record_core, 0, NULL, NULL, NULL)){
+		return 1;
+	}
+
+	if(reloading){
+		parser_state = none;
+		return 0;
+	}
+	parser_state = core_cfg;
+
+	//apply overrides
+	for(u = 0; u < noverrides; u++){
+		if(!overrides[u].handled && overrides[u].type == override_backend
+			       && !strcmp(overrides[u].target, "core")){
+			if(core_configure(overrides[u].option, overrides[u].value)){
+				LOGPF("Configuration override for %s failed for the core", overrides[u].option);
+				return 1;
+			}
+			overrides[u].handled = 1;
+		}
+	}
+	return 0;
+}
+
+static int config_section_backend(char* name){
+	size_t u;
+
+	if(config_record(record_backend, 0, name, NULL, NULL)){
+		return 1;
+	}
+
+	if(reloading){
+		parser_state = none;
+		return 0;
+	}
+	parser_state = backend_cfg;
+	current_backend = backend_match(name);
+
+	if(!current_backend){
+		LOGPF("Cannot configure unknown backend %s", name);
+		return 1;
+	}
+
+	//apply overrides
+	for(u = 0; u < noverrides; u++){
+		if(!overrides[u].handled && overrides[u].type == override_backend
+			       && !strcmp(overrides[u].target, current_backend->name)){
+			if(current_backend->conf(overrides[u].option, overrides[u].value)
+					|| config_hash_option(overrides[u].option, overrides[u].value)){
+				LOGPF("Configuration override for %s failed for backend %s",
+						overrides[u].option, current_backend->name);
+				return 1;
+			}
+			overrides[u].handled = 1;
+		}
+	}
+	return 0;
+}
+
+static int config_section_instance(char* backend_name, char* name){
+	size_t u;
+
+	if(config_record(record_instance, 0, backend_name, name, NULL)){
+		return 1;
+	}
+
+	//running instances are left untouched, new ones can not be started
+	if(reloading){
+		parser_state = none;
+		if(validating && !instance_match(name)){
+			LOGPF("Instance %s can not be created while running, restart to apply", name);
+		}
+		return 0;
+	}
+	parser_state = instance_cfg;
+
+	current_backend = backend_match(backend_name);
+	if(!current_backend){
+		LOGPF("No such backend %s", backend_name);
+		return 1;
+	}
+
+	if(instance_match(name)){
+		LOGPF("Duplicate instance name %s", name);
+		return 1;
+	}
+
+	//validate instance name
+	if(strchr(name, ' ') || strchr(name, '.')){
+		LOGPF("Invalid instance name %s", name);
+		return 1;
+	}
+
+	current_instance = mm_instance(current_backend);
+	if(!current_instance){
+		return 1;
+	}
+
+	if(current_backend->create(current_instance)){
+		LOGPF("Failed to create %s instance %s", backend_name, name);
+		return 1;
+	}
+
+	current_instance->name = strdup(name);
+	current_instance->backend = current_backend;
+	LOGPF("Created %s instance %s", backend_name, name);
+
+	//apply overrides
+	for(u = 0; u < noverrides; u++){
+		if(!overrides[u].handled && overrides[u].type == override_instance
+			       && !strcmp(overrides[u].target, current_instance->name)){
+			if(current_backend->conf_instance(current_instance, overrides[u].option, overrides[u].value)
+					|| config_hash_option(overrides[u].option, overrides[u].value)){
+				LOGPF("Configuration override for %s failed for instance %s",
+						overrides[u].option, current_instance->name);
+				return 1;
+			}
+			overrides[u].handled = 1;
+		}
+	}
+	return 0;
+}
+
+static int config_section_map(){
+	parser_state = map;
+	return 0;
+}
+
+static int config_mapping(map_type mapping_type, char* left, char* right, char* transform_spec){
+	transform_chain* transform = NULL;
+	int rv = 1;
+
+	if(transform_spec && *transform_spec){
+		//transforms are directional, applying one to both directions is most likely a mistake
+		if(mapping_type == map_bidir){
+			LOGPF("Value transforms are not supported on bidirectional mapping %s <> %s", left, right);
+			return 1;
+		}
+
+		transform = transform_parse(transform_spec);
+		if(!transform){
+			LOGPF("Invalid value transform for mapping %s - %s", left, right);
+			return 1;
+		}
+	}
+
+	if(mapping_type == map_ltr || mapping_type == map_bidir){
+		if(config_map(right, left, transform)){
+			LOGPF("Failed to map channel %s to %s", left, right);
+			goto done;
+		}
+	}
+	if(mapping_type == map_rtl || mapping_type == map_bidir){
+		if(config_map(left, right, transform)){
+			LOGPF("Failed to map channel %s to %s", right, left);
+			goto done;
+		}
+	}
+	rv = 0;
+
+done:
+	transform_free(transform);
+	return rv;
+}
+
+static int config_option(char* option, char* value){
+	if(config_record(record_option, 0, option, value, NULL)){
+		return 1;
+	}
+
+	if(reloading){
+		return 0;
+	}
+
+	if(parser_state == core_cfg && core_configure(option, value)){
+		LOG("Failed to configure the core");
+		return 1;
+	}
+	else if(parser_state == backend_cfg && current_backend->conf(option, value)){
+		LOGPF("Failed to configure backend %s", current_backend->name);
+		return 1;
+	}
+	else if(parser_state == instance_cfg && current_backend->conf_instance(current_instance, option, value)){
+		LOGPF("Failed to configure instance %s", current_instance->name);
+		return 1;
+	}
+	return config_hash_option(option, value);
+}
+
 static int config_line(char* line){
 	map_type mapping_type = map_rtl;
-	char* separator = NULL;
-	size_t u;
+	char* separator = NULL, *transform = NULL;
 
 	line = config_trim_line(line);
 	if(*line == ';' || strlen(line) == 0){
@@ -406,29 +892,14 @@ static int config_line(char* line){
 		return 0;
 	}
 	if(*line == '[' && line[strlen(line) - 1] == ']'){
-		if(!strncmp(line, "[backend ", 9)){
+		if(!strcmp(line, "[backend core]")){
+			//core configuration
+			return config_section_core();
+		}
+		else if(!strncmp(line, "[backend ", 9)){
 			//backend configuration
-			parser_state = backend_cfg;
 			line[strlen(line) - 1] = 0;
-			current_backend = backend_match(line + 9);
-
-			if(!current_backend){
-				LOGPF("Cannot configure unknown backend %s", line + 9);
-				return 1;
-			}
-
-			//apply overrides
-			for(u = 0; u < noverrides; u++){
-				if(!overrides[u].handled && overrides[u].type == override_backend
-					       && !strcmp(overrides[u].target, current_backend->name)){
-					if(current_backend->conf(overrides[u].option, overrides[u].value)){
-						LOGPF("Configuration override for %s failed for backend %s",
-								overrides[u].option, current_backend->name);
-						return 1;
-					}
-					overrides[u].handled = 1;
-				}
-			}
+			return config_section_backend(line + 9);
 		}
 		else if(!strncmp(line, "[include ", 9)){
 			line[strlen(line) - 1] = 0;
@@ -436,12 +907,10 @@ static int config_line(char* line){
 		}
 		else if(!strcmp(line, "[map]")){
 			//mapping configuration
-			parser_state = map;
+			return config_section_map();
 		}
 		else{
 			//backend instance configuration
-			parser_state = instance_cfg;
-
 			//trim braces
 			line[strlen(line) - 1] = 0;
 			line++;
@@ -456,53 +925,24 @@ static int config_line(char* line){
 			*separator = 0;
 			separator++;
 
-			current_backend = backend_match(line);
-			if(!current_backend){
-				LOGPF("No such backend %s", line);
-				return 1;
-			}
-
-			if(instance_match(separator)){
-				LOGPF("Duplicate instance name %s", separator);
-				return 1;
-			}
-
-			//validate instance name
-			if(strchr(separator, ' ') || strchr(separator, '.')){
-				LOGPF("Invalid instance name %s", separator);
-				return 1;
-			}
-
-			current_instance = mm_instance(current_backend);
-			if(!current_instance){
-				return 1;
-			}
-
-			if(current_backend->create(current_instance)){
-				LOGPF("Failed to create %s instance %s", line, separator);
-				return 1;
-			}
-
-			current_instance->name = strdup(separator);
-			current_instance->backend = current_backend;
-			LOGPF("Created %s instance %s", line, separator);
-
-			//apply overrides
-			for(u = 0; u < noverrides; u++){
-				if(!overrides[u].handled && overrides[u].type == override_instance
-					       && !strcmp(overrides[u].target, current_instance->name)){
-					if(current_backend->conf_instance(current_instance, overrides[u].option, overrides[u].value)){
-						LOGPF("Configuration override for %s failed for instance %s",
-								overrides[u].option, current_instance->name);
-						return 1;
-					}
-					overrides[u].handled = 1;
-				}
-			}
+			return config_section_instance(line, separator);
 		}
 	}
 	else if(parser_state == map){
 		mapping_type = map_rtl;
+		/*
+		 * Split off the value transform. Channel specifications may contain a `|` (e.g. OSC paths
+		 * or MQTT topics), so only a `|` surrounded by whitespace introduces the transform chain.
+		 */
+		for(transform = strchr(line, '|');
+				transform && (transform == line || !isspace(transform[-1]) || !isspace(transform[1]));
+				transform = strchr(transform + 1, '|')){
+		}
+		if(transform){
+			*transform = 0;
+			transform = config_trim_line(transform + 1);
+		}
+
 		//find separator
 		for(separator = line; *separator && *separator != '<' && *separator != '>'; separator++){
 		}
@@ -527,58 +967,448 @@ static int config_line(char* line){
 			separator++;
 		}
 
-		line = config_trim_line(line);
-		separator = config_trim_line(separator);
-
-		if(mapping_type == map_ltr || mapping_type == map_bidir){
-			if(config_map(separator, line)){
-				LOGPF("Failed to map channel %s to %s", line, separator);
-				return 1;
-			}
-		}
-		if(mapping_type == map_rtl || mapping_type == map_bidir){
-			if(config_map(line, separator)){
-				LOGPF("Failed to map channel %s to %s", separator, line);
-				return 1;
-			}
-		}
+		return config_mapping(mapping_type, config_trim_line(line), config_trim_line(separator), transform);
 	}
 	else{
 		//pass to parser
 		//find separator
 		separator = strchr(line, '=');
 		if(!separator){
-			LOGPF("Not an assignment (currently expecting %s configuration): %s", line, (parser_state == backend_cfg) ? "backend" : "instance");
+			LOGPF("Not an assignment (currently expecting %s configuration): %s", line, (parser_state == backend_cfg || parser_state == core_cfg) ? "backend" : "instance");
 			return 1;
 		}
 
 		*separator = 0;
 		separator++;
-		line = config_trim_line(line);
-		separator = config_trim_line(separator);
-
-		if(parser_state == backend_cfg && current_backend->conf(line, separator)){
-			LOGPF("Failed to configure backend %s", current_backend->name);
-			return 1;
-		}
-		else if(parser_state == instance_cfg && current_backend->conf_instance(current_instance, line, separator)){
-			LOGPF("Failed to configure instance %s", current_instance->name);
-			return 1;
-		}
+		return config_option(config_trim_line(line), config_trim_line(separator));
 	}
 
 	return 0;
 }
 
-int config_read(char* cfg_filepath){
-	int rv = 1;
+static int config_compiled_header(uint8_t* data, size_t length){
+	if(length < sizeof(CONFIG_COMPILED_MAGIC) + 1 || memcmp(data, CONFIG_COMPILED_MAGIC, sizeof(CONFIG_COMPILED_MAGIC))){
+		LOG("Not a compiled configuration");
+		return 1;
+	}
+
+	if(data[sizeof(CONFIG_COMPILED_MAGIC)] != CONFIG_COMPILED_VERSION){
+		LOGPF("Compiled configuration has format version %d, expected %d - please recompile it",
+				data[sizeof(CONFIG_COMPILED_MAGIC)], CONFIG_COMPILED_VERSION);
+		return 1;
+	}
+	return 0;
+}
+
+//returns the offset of the following record, or 0 if the record is truncated
+static size_t config_compiled_record(uint8_t* data, size_t length, size_t offset, uint8_t* type, uint8_t* mode, char** string, size_t* size){
+	size_t strings, u;
+	uint64_t payload;
+
+	if(offset + 2 > length){
+		LOG("Compiled configuration is truncated");
+		return 0;
+	}
+	*type = data[offset];
+	*mode = data[offset + 1];
+	offset += 2;
+
+	//the graph record carries binary data of a given length
+	if(*type == record_graph){
+		if(offset + sizeof(payload) > length){
+			LOG("Compiled configuration is truncated");
+			return 0;
+		}
+		memcpy(&payload, data + offset, sizeof(payload));
+		offset += sizeof(payload);
+		if(payload > length - offset){
+			LOG("Compiled configuration is truncated");
+			return 0;
+		}
+		string[0] = (char*) data + offset;
+		*size = payload;
+		return offset + payload;
+	}
+
+	//read the string arguments for this record type
+	strings = (*type == record_directory || *type == record_backend) ? 1 : 0;
+	strings = (*type == record_instance || *type == record_option) ? 2 : strings;
+	for(u = 0; u < strings; u++){
+		if(offset >= length || !memchr(data + offset, 0, length - offset)){
+			LOG("Compiled configuration is truncated");
+			return 0;
+		}
+		string[u] = (char*) data + offset;
+		offset += strlen(string[u]) + 1;
+	}
+	return offset;
+}
+
+static int config_take(uint8_t* data, size_t length, size_t* offset, void* value, size_t size){
+	if(size > length - *offset){
+		LOG("Compiled routing graph is truncated");
+		return 1;
+	}
+	memcpy(value, data + *offset, size);
+	*offset += size;
+	return 0;
+}
+
+static char* config_take_string(uint8_t* data, size_t length, size_t* offset){
+	char* string = (char*) data + *offset;
+
+	if(*offset >= length || !memchr(string, 0, length - *offset)){
+		LOG("Compiled routing graph is truncated");
+		return NULL;
+	}
+	*offset += strlen(string) + 1;
+	return string;
+}
+
+//resolve the channel table of a compiled routing graph, counting the channels restored from their identifiers
+static int config_graph_channels(uint8_t* data, size_t length, size_t* offset, uint32_t instances, instance** inst, uint8_t* restore, uint32_t channels, channel** table, size_t* restored){
+	size_t u, alloc = 0;
+	uint32_t index;
+	uint64_t ident;
+	uint8_t flags, direction;
+	char* spec = NULL, *buffer = NULL;
+	int rv = 1;
+
+	for(u = 0; u < channels; u++){
+		if(config_take(data, length, offset, &index, sizeof(index))
+				|| config_take(data, length, offset, &flags, sizeof(flags))
+				|| config_take(data, length, offset, &ident, sizeof(ident))
+				|| !(spec = config_take_string(data, length, offset))){
+			goto bail;
+		}
+
+		if(index >= instances || !(flags & (mmchannel_input | mmchannel_output))){
+			LOG("Invalid channel in compiled routing graph");
+			goto bail;
+		}
+
+		if(restore[index]){
+			table[u] = inst[index]->backend->channel_restore(inst[index], ident, flags);
+			(*restored)++;
+		}
+		else{
+			//the parsers may modify the spec, which is used for both directions
+			if(strlen(spec) + 1 > alloc){
+				alloc = strlen(spec) + 1;
+				free(buffer);
+				buffer = malloc(alloc);
+				if(!buffer){
+					LOG("Failed to allocate memory");
+					goto bail;
+				}
+			}
+
+			for(direction = mmchannel_input; direction <= mmchannel_output; direction <<= 1){
+				if(flags & direction){
+					memcpy(buffer, spec, strlen(spec) + 1);
+					table[u] = inst[index]->backend->channel(inst[index], buffer, direction);
+				}
+			}
+		}
+
+		if(!table[u]){
+			LOGPF("Failed to restore channel %s.%s", inst[index]->name, spec);
+			goto bail;
+		}
+	}
+
+	rv = 0;
+bail:
+	free(buffer);
+	return rv;
+}
+
+static int config_graph(uint8_t* data, size_t length){
+	size_t u, d, offset = 0, restored = 0, *edge_offset = NULL;
+	uint32_t instances = 0, channels = 0, transforms = 0, sources = 0, edges = 0, fanout, target;
+	uint32_t* source = NULL, *destination = NULL;
+	uint64_t hash;
+	uint8_t* restore = NULL;
+	char* name = NULL;
+	instance** inst = NULL;
+	channel** table = NULL;
+	transform_chain** chain = NULL, **transform = NULL;
+	int rv = 1;
+
+	//instance table
+	if(config_take(data, length, &offset, &instances, sizeof(instances))){
+		return 1;
+	}
+
+	inst = calloc(instances, sizeof(instance*));
+	restore = calloc(instances, sizeof(uint8_t));
+	if(instances && (!inst || !restore)){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(u = 0; u < instances; u++){
+		if(config_take(data, length, &offset, &hash, sizeof(hash))
+				|| !(name = config_take_string(data, length, &offset))){
+			goto bail;
+		}
+
+		inst[u] = instance_match(name);
+		if(!inst[u]){
+			LOGPF("No such instance %s", name);
+			goto bail;
+		}
+
+		//identifiers are only valid for an unchanged instance configuration
+		restore[u] = (inst[u]->backend->channel_restore && hash == config_instance_hash(inst[u])) ? 1 : 0;
+	}
+
+	//the validation pass stops before any backend state is touched
+	if(validating){
+		rv = 0;
+		goto bail;
+	}
+
+	//channel table
+	if(config_take(data, length, &offset, &channels, sizeof(channels))){
+		goto bail;
+	}
+
+	table = calloc(channels, sizeof(channel*));
+	if(channels && !table){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	if(config_graph_channels(data, length, &offset, instances, inst, restore, channels, table, &restored)){
+		goto bail;
+	}
+
+	//transform table
+	if(config_take(data, length, &offset, &transforms, sizeof(transforms))){
+		goto bail;
+	}
+
+	chain = calloc(transforms, sizeof(transform_chain*));
+	if(transforms && !chain){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(u = 0; u < transforms; u++){
+		chain[u] = transform_deserialize(data + offset, length - offset, &d);
+		if(!chain[u]){
+			goto bail;
+		}
+		offset += d;
+	}
+
+	//edges
+	if(config_take(data, length, &offset, &sources, sizeof(sources))
+			|| config_take(data, length, &offset, &edges, sizeof(edges))){
+		goto bail;
+	}
+
+	source = calloc(sources, sizeof(uint32_t));
+	edge_offset = calloc(sources + 1, sizeof(size_t));
+	destination = calloc(edges, sizeof(uint32_t));
+	transform = transforms ? calloc(edges, sizeof(transform_chain*)) : NULL;
+	if((sources && !source) || !edge_offset || (edges && !destination) || (transforms && edges && !transform)){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(u = 0; u < sources; u++){
+		if(config_take(data, length, &offset, source + u, sizeof(uint32_t))
+				|| config_take(data, length, &offset, &fanout, sizeof(fanout))){
+			goto bail;
+		}
+
+		if(source[u] >= channels || fanout > edges - edge_offset[u]){
+			LOG("Invalid source in compiled routing graph");
+			goto bail;
+		}
+		edge_offset[u + 1] = edge_offset[u] + fanout;
+
+		for(d = edge_offset[u]; d < edge_offset[u + 1]; d++){
+			if(config_take(data, length, &offset, destination + d, sizeof(uint32_t))
+					|| config_take(data, length, &offset, &target, sizeof(target))){
+				goto bail;
+			}
+
+			if(destination[d] >= channels || target > transforms){
+				LOG("Invalid edge in compiled routing graph");
+				goto bail;
+			}
+
+			//every edge carries its own copy of the transform, as operators may keep state
+			if(target && !(transform[d] = transform_clone(chain[target - 1]))){
+				goto bail;
+			}
+		}
+	}
+
+	if(edge_offset[sources] != edges){
+		LOG("Invalid edge count in compiled routing graph");
+		goto bail;
+	}
+
+	LOGPF("Loaded %" PRIu32 " mappings between %" PRIu32 " channels, %" PRIsize_t " channels restored from their identifiers",
+			edges, channels, restored);
+
+	//the routing core takes ownership of the transforms
+	rv = routing_load(channels, table, sources, source, edge_offset, destination, transform);
+	transform = NULL;
+
+bail:
+	for(u = 0; transform && u < edges; u++){
+		transform_free(transform[u]);
+	}
+	free(transform);
+	for(u = 0; chain && u < transforms; u++){
+		transform_free(chain[u]);
+	}
+	free(chain);
+	free(source);
+	free(edge_offset);
+	free(destination);
+	free(table);
+	free(restore);
+	free(inst);
+	return rv;
+}
+
+//directories are recorded relative to the directory containing the compiled configuration
+static int config_replay_directory(char* base, char* directory){
+	#ifdef _WIN32
+	uint8_t absolute = (directory[0] && directory[1] == ':') || directory[0] == '\\';
+	#else
+	uint8_t absolute = directory[0] == '/';
+	#endif
+
+	if((!absolute && chdir(base)) || chdir(directory)){
+		LOGPF("Failed to change to configuration file directory %s: %s", directory, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+static int config_replay(uint8_t* data, size_t length){
+	size_t offset = sizeof(CONFIG_COMPILED_MAGIC) + 1, size = 0;
+	uint8_t type, mode;
+	char* string[2] = {NULL, NULL}, base[PATH_MAX * 2] = "";
+	int rv = 0;
+
+	if(config_compiled_header(data, length)){
+		return 1;
+	}
+
+	if(!getcwd(base, sizeof(base))){
+		LOGPF("Failed to read current working directory: %s", strerror(errno));
+		return 1;
+	}
+
+	while(!rv && offset < length){
+		offset = config_compiled_record(data, length, offset, &type, &mode, string, &size);
+		if(!offset){
+			return 1;
+		}
+
+		switch(type){
+			case record_directory:
+				rv = config_replay_directory(base, string[0]);
+				break;
+			case record_core:
+				rv = config_section_core();
+				break;
+			case record_backend:
+				rv = config_section_backend(string[0]);
+				break;
+			case record_instance:
+				rv = config_section_instance(string[0], string[1]);
+				break;
+			case record_option:
+				rv = config_option(string[0], string[1]);
+				break;
+			case record_graph:
+				rv = config_graph((uint8_t*) string[0], size);
+				break;
+			default:
+				LOGPF("Unknown record type %d in compiled configuration", type);
+				rv = 1;
+		}
+	}
+	return rv;
+}
+
+static int config_load(char* file){
+	int rv = 1;
+	uint8_t* data = NULL;
+	size_t length = 0;
+	#ifndef _WIN32
+	struct stat info;
+	int fd = open(file, O_RDONLY);
+
+	if(fd < 0 || fstat(fd, &info)){
+		LOGPF("Failed to open %s: %s", file, strerror(errno));
+		goto bail;
+	}
+
+	//private writable mapping, as the parsers may modify the strings handed to them
+	length = info.st_size;
+	data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED){
+		LOGPF("Failed to map %s: %s", file, strerror(errno));
+		data = NULL;
+		goto bail;
+	}
+	#else
+	FILE* source = fopen(file, "rb");
+
+	if(!source){
+		LOGPF("Failed to open %s for reading", file);
+		goto bail;
+	}
+
+	fseek(source, 0, SEEK_END);
+	length = ftell(source);
+	fseek(source, 0, SEEK_SET);
+	data = malloc(length);
+	if(!data || fread(data, 1, length, source) != length){
+		LOGPF("Failed to read %s", file);
+		goto bail;
+	}
+	#endif
+
+	LOGPF("Loading compiled configuration %s", file);
+	rv = config_replay(data, length);
+
+bail:
+	#ifndef _WIN32
+	if(data){
+		munmap(data, length);
+	}
+	if(fd >= 0){
+		close(fd);
+	}
+	#else
+	free(data);
+	if(source){
+		fclose(source);
+	}
+	#endif
+	return rv;
+}
+
+int config_read(char* cfg_filepath){
+	int rv = 1;
 	size_t line_alloc = 0;
 	ssize_t status;
 	FILE* source = NULL;
-	char* line_raw = NULL;
+	char* line_raw = NULL, magic[sizeof(CONFIG_COMPILED_MAGIC)] = "";
 
 	//create heap copy of file name because original might be in readonly memory
-	char* source_dir = strdup(cfg_filepath), *source_file = NULL, original_dir[PATH_MAX * 2] = "";
+	char* source_dir = strdup(cfg_filepath), *source_file = NULL, original_dir[PATH_MAX * 2] = "", config_dir[PATH_MAX * 2] = "";
 	#ifdef _WIN32
 	char path_separator = '\\';
 	#else
@@ -590,17 +1420,17 @@ int config_read(char* cfg_filepath){
 		return 1;
 	}
 
+	if(!getcwd(original_dir, sizeof(original_dir))){
+		LOGPF("Failed to read current working directory: %s", strerror(errno));
+		goto bail;
+	}
+
 	//change working directory to the one containing the configuration file so relative paths work as expected
 	source_file = strrchr(source_dir, path_separator);
 	if(source_file){
 		*source_file = 0;
 		source_file++;
 
-		if(!getcwd(original_dir, sizeof(original_dir))){
-			LOGPF("Failed to read current working directory: %s", strerror(errno));
-			goto bail;
-		}
-
 		if(chdir(source_dir)){
 			LOGPF("Failed to change to configuration file directory %s: %s", source_dir, strerror(errno));
 			goto bail;
@@ -610,7 +1440,16 @@ int config_read(char* cfg_filepath){
 		source_file = source_dir;
 	}
 
-	LOGPF("Reading configuration file %s", cfg_filepath);
+	//compiled configurations restore the working directory explicitly, as includes are flattened
+	if(compiled.active){
+		compiled.depth++;
+		if(!getcwd(config_dir, sizeof(config_dir))
+				|| config_record_directory(config_dir)){
+			LOG("Failed to record configuration file directory");
+			goto bail;
+		}
+	}
+
 	source = fopen(source_file, "r");
 
 	if(!source){
@@ -618,6 +1457,19 @@ int config_read(char* cfg_filepath){
 		goto bail;
 	}
 
+	//detect compiled configurations
+	if(fread(magic, 1, sizeof(magic), source) == sizeof(magic)
+			&& !memcmp(magic, CONFIG_COMPILED_MAGIC, sizeof(magic))){
+		if(compiled.active){
+			LOGPF("Can not include compiled configuration %s while compiling", cfg_filepath);
+			goto bail;
+		}
+		rv = config_load(source_file);
+		goto bail;
+	}
+	rewind(source);
+
+	LOGPF("Reading configuration file %s", cfg_filepath);
 	for(status = getline(&line_raw, &line_alloc, source); status >= 0; status = getline(&line_raw, &line_alloc, source)){
 		if(config_line(line_raw)){
 			goto bail;
@@ -629,10 +1481,19 @@ int config_read(char* cfg_filepath){
 	rv = 0;
 bail:
 	//change back to previous directory to allow recursive configuration file parsing
-	if(source_file && source_dir != source_file){
+	//compiled configurations may change the directory even without a path in the file name
+	if(original_dir[0]){
 		chdir(original_dir);
 	}
 
+	//restore the directory for the remainder of the including file
+	if(compiled.active && compiled.depth){
+		compiled.depth--;
+		if(!rv && compiled.depth && config_record_directory(original_dir)){
+			rv = 1;
+		}
+	}
+
 	free(source_dir);
 	if(source){
 		fclose(source);
@@ -641,6 +1502,477 @@ bail:
 	return rv;
 }
 
+static int config_scan_add(char*** names, size_t* n, char* name){
+	size_t u;
+
+	//the core section does not require a plugin
+	if(!strcmp(name, "core")){
+		return 0;
+	}
+
+	for(u = 0; u < *n; u++){
+		if(!strcmp((*names)[u], name)){
+			return 0;
+		}
+	}
+
+	*names = realloc(*names, (*n + 2) * sizeof(char*));
+	if(!*names){
+		LOG("Failed to allocate memory");
+		*n = 0;
+		return 1;
+	}
+
+	(*names)[*n] = strdup(name);
+	(*names)[*n + 1] = NULL;
+	if(!(*names)[*n]){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	(*n)++;
+	return 0;
+}
+
+static int config_scan_compiled(FILE* source, char*** names, size_t* n){
+	int rv = 1;
+	size_t length = 0, offset = sizeof(CONFIG_COMPILED_MAGIC) + 1, size = 0;
+	uint8_t* data = NULL, type, mode;
+	char* string[2] = {NULL, NULL};
+
+	fseek(source, 0, SEEK_END);
+	length = ftell(source);
+	fseek(source, 0, SEEK_SET);
+
+	data = malloc(length);
+	if(!data || fread(data, 1, length, source) != length){
+		LOG("Failed to read compiled configuration");
+		goto bail;
+	}
+
+	if(config_compiled_header(data, length)){
+		goto bail;
+	}
+
+	while(offset < length){
+		offset = config_compiled_record(data, length, offset, &type, &mode, string, &size);
+		if(!offset){
+			goto bail;
+		}
+
+		if((type == record_backend || type == record_instance)
+				&& config_scan_add(names, n, string[0])){
+			goto bail;
+		}
+	}
+
+	rv = 0;
+bail:
+	free(data);
+	return rv;
+}
+
+static int config_scan(char* cfg_filepath, char*** names, size_t* n){
+	int rv = 1;
+	size_t line_alloc = 0;
+	FILE* source = NULL;
+	char* line_raw = NULL, *line = NULL, magic[sizeof(CONFIG_COMPILED_MAGIC)] = "";
+	char* source_dir = strdup(cfg_filepath), *source_file = NULL, original_dir[PATH_MAX * 2] = "";
+	#ifdef _WIN32
+	char path_separator = '\\';
+	#else
+	char path_separator = '/';
+	#endif
+
+	if(!source_dir){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	if(!getcwd(original_dir, sizeof(original_dir))){
+		LOGPF("Failed to read current working directory: %s", strerror(errno));
+		goto bail;
+	}
+
+	//includes are relative to the including file, as in config_read
+	source_file = strrchr(source_dir, path_separator);
+	if(source_file){
+		*source_file = 0;
+		source_file++;
+
+		if(chdir(source_dir)){
+			LOGPF("Failed to change to configuration file directory %s: %s", source_dir, strerror(errno));
+			goto bail;
+		}
+	}
+	else{
+		source_file = source_dir;
+	}
+
+	source = fopen(source_file, "rb");
+	if(!source){
+		LOGPF("Failed to open %s for reading", cfg_filepath);
+		goto bail;
+	}
+
+	if(fread(magic, 1, sizeof(magic), source) == sizeof(magic)
+			&& !memcmp(magic, CONFIG_COMPILED_MAGIC, sizeof(magic))){
+		rv = config_scan_compiled(source, names, n);
+		goto bail;
+	}
+	rewind(source);
+
+	//only section headers reference backends
+	while(getline(&line_raw, &line_alloc, source) >= 0){
+		line = config_trim_line(line_raw);
+		if(*line != '[' || line[strlen(line) - 1] != ']' || !strcmp(line, "[map]")){
+			continue;
+		}
+		line[strlen(line) - 1] = 0;
+		line++;
+
+		if(!strncmp(line, "include ", 8)){
+			if(config_scan(line + 8, names, n)){
+				goto bail;
+			}
+			continue;
+		}
+
+		if(!strncmp(line, "backend ", 8)){
+			line += 8;
+		}
+		else if(strchr(line, ' ')){
+			*strchr(line, ' ') = 0;
+		}
+
+		if(config_scan_add(names, n, line)){
+			goto bail;
+		}
+	}
+
+	rv = 0;
+bail:
+	if(original_dir[0]){
+		chdir(original_dir);
+	}
+	free(source_dir);
+	if(source){
+		fclose(source);
+	}
+	free(line_raw);
+	return rv;
+}
+
+char** config_backends(char* file){
+	size_t n = 0;
+	char** names = NULL;
+
+	if(config_scan(file, &names, &n)){
+		for(; n > 0; n--){
+			free(names[n - 1]);
+		}
+		free(names);
+		return NULL;
+	}
+
+	//always return a list, even if no backends are referenced
+	if(!names){
+		names = calloc(1, sizeof(char*));
+		if(!names){
+			LOG("Failed to allocate memory");
+		}
+	}
+	return names;
+}
+
+int config_reload(char* file){
+	int rv = 1;
+
+	//worker threads read the routing graph concurrently
+	if(shards_count() > 1){
+		LOG("Configuration reload is not supported with multiple threads, restart to apply");
+		return 1;
+	}
+
+	LOGPF("Reloading mappings from %s", file);
+	reloading = 1;
+
+	//check the mappings first, channel parsers may change backend state even for rejected mappings
+	validating = 1;
+	parser_state = none;
+	rv = config_read(file);
+	validating = 0;
+	if(rv){
+		LOG("Failed to reload configuration, keeping current mappings");
+		routing_discard();
+		goto bail;
+	}
+
+	//channels created for a configuration that fails to apply are removed again
+	parser_state = none;
+	channels_checkpoint();
+	rv = config_read(file);
+	if(rv){
+		LOG("Failed to reload configuration, keeping current mappings");
+		routing_discard();
+	}
+	else{
+		rv = routing_update();
+	}
+	channels_restore(rv);
+
+bail:
+	reloading = 0;
+	parser_state = none;
+	return rv;
+}
+
+//returns the channel table index of a channel recorded while compiling
+static int config_compiled_index(channel* c, uint32_t* index){
+	size_t slot = compiled.size ? config_compiled_slot(compiled.slot, compiled.size, c) : 0;
+
+	if(!compiled.size || !compiled.slot[slot]){
+		LOGPF("Channel %" PRIu64 " of instance %s was not recorded while compiling", c->ident, c->instance->name);
+		return 1;
+	}
+	*index = compiled.slot[slot] - 1;
+	return 0;
+}
+
+static int config_compiled_graph(){
+	size_t u, d, sources, edges, fanout, start, length;
+	size_t* offset = NULL;
+	uint32_t instances = 0, transforms = 0, value, *mapped = NULL, *edge_chain = NULL;
+	uint64_t hash, payload = 0;
+	uint8_t header[2] = {record_graph, 0}, *serialized = NULL;
+	instance** inst = NULL;
+	channel** source = NULL, **destination = NULL;
+	transform_chain** transform = NULL, **chain = NULL;
+	int rv = 1;
+
+	routing_table(&sources, &edges, &fanout);
+	routing_export(&source, &offset, &destination, &transform);
+	if(compiled.channels > UINT32_MAX || edges > UINT32_MAX){
+		LOG("Routing graph is too large to be compiled");
+		return 1;
+	}
+
+	//the payload length is filled in once the graph is written
+	if(config_emit(header, sizeof(header))){
+		return 1;
+	}
+	start = compiled.length;
+	if(config_emit(&payload, sizeof(payload))){
+		return 1;
+	}
+
+	//instance table, in order of first use
+	mapped = calloc(instances_count(), sizeof(uint32_t));
+	inst = calloc(instances_count(), sizeof(instance*));
+	if(instances_count() && (!mapped || !inst)){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(u = 0; u < compiled.channels; u++){
+		d = compiled.channel[u].target->instance->index;
+		if(!mapped[d]){
+			inst[instances++] = compiled.channel[u].target->instance;
+			mapped[d] = instances;
+		}
+	}
+
+	if(config_emit(&instances, sizeof(instances))){
+		goto bail;
+	}
+	for(u = 0; u < instances; u++){
+		hash = config_instance_hash(inst[u]);
+		if(config_emit(&hash, sizeof(hash))
+				|| config_emit(inst[u]->name, strlen(inst[u]->name) + 1)){
+			goto bail;
+		}
+	}
+
+	//channel table
+	value = compiled.channels;
+	if(config_emit(&value, sizeof(value))){
+		goto bail;
+	}
+	for(u = 0; u < compiled.channels; u++){
+		value = mapped[compiled.channel[u].target->instance->index] - 1;
+		if(config_emit(&value, sizeof(value))
+				|| config_emit(&compiled.channel[u].flags, sizeof(uint8_t))
+				|| config_emit(&compiled.channel[u].target->ident, sizeof(uint64_t))
+				|| config_emit(compiled.channel[u].spec, strlen(compiled.channel[u].spec) + 1)){
+			goto bail;
+		}
+	}
+
+	//deduplicate the transforms, edges created from one mapping carry equal chains
+	edge_chain = calloc(edges, sizeof(uint32_t));
+	chain = calloc(edges, sizeof(transform_chain*));
+	if(transform && edges && (!edge_chain || !chain)){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(d = 0; transform && d < edges; d++){
+		if(!transform[d]){
+			continue;
+		}
+
+		if(transforms && transform_equal(chain[transforms - 1], transform[d])){
+			edge_chain[d] = transforms;
+			continue;
+		}
+
+		for(u = 0; u < transforms && !transform_equal(chain[u], transform[d]); u++){
+		}
+		if(u == transforms){
+			chain[transforms++] = transform[d];
+		}
+		edge_chain[d] = u + 1;
+	}
+
+	if(config_emit(&transforms, sizeof(transforms))){
+		goto bail;
+	}
+	for(u = 0; u < transforms; u++){
+		length = transform_serialize(chain[u], NULL);
+		serialized = malloc(length);
+		if(!serialized){
+			LOG("Failed to allocate memory");
+			goto bail;
+		}
+		transform_serialize(chain[u], serialized);
+		if(config_emit(serialized, length)){
+			goto bail;
+		}
+		free(serialized);
+		serialized = NULL;
+	}
+
+	//edges, in compressed sparse row layout
+	value = sources;
+	if(config_emit(&value, sizeof(value))){
+		goto bail;
+	}
+	value = edges;
+	if(config_emit(&value, sizeof(value))){
+		goto bail;
+	}
+	for(u = 0; u < sources; u++){
+		if(config_compiled_index(source[u], &value)
+				|| config_emit(&value, sizeof(value))){
+			goto bail;
+		}
+
+		value = offset[u + 1] - offset[u];
+		if(config_emit(&value, sizeof(value))){
+			goto bail;
+		}
+
+		for(d = offset[u]; d < offset[u + 1]; d++){
+			if(config_compiled_index(destination[d], &value)
+					|| config_emit(&value, sizeof(value))){
+				goto bail;
+			}
+
+			value = edge_chain ? edge_chain[d] : 0;
+			if(config_emit(&value, sizeof(value))){
+				goto bail;
+			}
+		}
+	}
+
+	payload = compiled.length - start - sizeof(payload);
+	memcpy(compiled.data + start, &payload, sizeof(payload));
+	LOGPF("Compiled %" PRIsize_t " mappings between %" PRIsize_t " channels of %" PRIu32 " instances", edges, compiled.channels, instances);
+	rv = 0;
+
+bail:
+	free(serialized);
+	free(edge_chain);
+	free(chain);
+	free(mapped);
+	free(inst);
+	return rv;
+}
+
+static void config_compiled_free(){
+	size_t u;
+
+	for(u = 0; u < compiled.channels; u++){
+		free(compiled.channel[u].spec);
+	}
+	free(compiled.channel);
+	free(compiled.slot);
+	free(compiled.base);
+	free(compiled.data);
+	memset(&compiled, 0, sizeof(compiled));
+}
+
+int config_compile(char* source, char* target){
+	int rv = 1;
+	FILE* output = NULL;
+	#ifndef _WIN32
+	char* directory = strdup(target), *separator = NULL;
+
+	//find the absolute directory of the output file
+	if(!directory){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	separator = strrchr(directory, '/');
+	if(separator){
+		separator[(separator == directory) ? 1 : 0] = 0;
+	}
+	compiled.base = realpath(separator ? directory : ".", NULL);
+	free(directory);
+	if(!compiled.base){
+		LOGPF("Failed to resolve the output directory for %s: %s", target, strerror(errno));
+		return 1;
+	}
+	#endif
+
+	//write the format header
+	compiled.data = calloc(CONFIG_COMPILED_CHUNK, sizeof(uint8_t));
+	if(!compiled.data){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+	compiled.alloc = CONFIG_COMPILED_CHUNK;
+	memcpy(compiled.data, CONFIG_COMPILED_MAGIC, sizeof(CONFIG_COMPILED_MAGIC));
+	compiled.data[sizeof(CONFIG_COMPILED_MAGIC)] = CONFIG_COMPILED_VERSION;
+	compiled.length = sizeof(CONFIG_COMPILED_MAGIC) + 1;
+
+	//record the configuration while parsing it, then store the resolved routing graph
+	compiled.active = 1;
+	if(config_read(source) || routing_compile() || config_compiled_graph()){
+		goto bail;
+	}
+
+	output = fopen(target, "wb");
+	if(!output){
+		LOGPF("Failed to open %s for writing: %s", target, strerror(errno));
+		goto bail;
+	}
+
+	if(fwrite(compiled.data, 1, compiled.length, output) != compiled.length){
+		LOGPF("Failed to write compiled configuration to %s", target);
+		goto bail;
+	}
+
+	LOGPF("Compiled %s to %s (%" PRIsize_t " bytes)", source, target, compiled.length);
+	rv = 0;
+bail:
+	if(output){
+		fclose(output);
+	}
+	config_compiled_free();
+	return rv;
+}
+
 int config_add_override(override_type type, char* data_raw){
 	int rv = 1;
 	//heap a copy because the original data is probably not writable
@@ -707,5 +2039,9 @@ void config_free(){
 	free(overrides);
 	overrides = NULL;
 
+	free(hashes.backend);
+	free(hashes.instance);
+	memset(&hashes, 0, sizeof(hashes));
+
 	parser_state = none;
 }
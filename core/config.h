@@ -49,9 +49,61 @@ typedef struct /*_mm_config_override*/ {
 	char* value;
 } config_override;
 
+/*
+ * Compiled configuration format: the magic string (including the terminator),
+ * one format version byte, then a sequence of records. Every record consists
+ * of a type byte and a mode byte. Most records are followed by zero to three
+ * terminated strings, the graph record is followed by its length (64 bit) and
+ * the resolved routing graph:
+ * 	* The instance table: the instance count (32 bit), then for every instance
+ * 	  the hash of its configuration (64 bit) and its terminated name
+ * 	* The channel table: the channel count (32 bit), then for every channel the
+ * 	  instance table index (32 bit), the mapped directions (8 bit), the backend
+ * 	  identifier (64 bit) and the terminated channel-spec it was resolved from
+ * 	* The transform table: the chain count (32 bit), then the chains as
+ * 	  serialized by transform_serialize
+ * 	* The edges: the source and edge counts (32 bit each), then for every source
+ * 	  its channel table index and edge count (32 bit each), followed by the
+ * 	  destination channel table index and the transform table index plus one
+ * 	  (or zero, 32 bit each) of every edge
+ * Integers are stored in host byte order. Directories are stored relative to
+ * the directory containing the compiled configuration.
+ */
+#define CONFIG_COMPILED_MAGIC "MMCFG"
+#define CONFIG_COMPILED_VERSION 3
+#define CONFIG_COMPILED_CHUNK 4096
+
+/*
+ * Compiled configuration record types
+ */
+enum /*_mm_config_record_type*/ {
+	record_directory = 1,
+	record_core,
+	record_backend,
+	record_instance,
+	record_option,
+	record_graph
+};
+
+/*
+ * Channel resolved while compiling a configuration
+ */
+typedef struct /*_mm_config_channel*/ {
+	channel* target;
+	uint8_t flags;
+	char* spec;
+} config_channel;
+
+//FNV-1a parameters for the instance configuration hashes
+#define CONFIG_HASH_BASIS 0xCBF29CE484222325ULL
+#define CONFIG_HASH_PRIME 0x100000001B3ULL
+
 /* Internal API */
 void config_free();
 
 /* Frontend API */
 int config_read(char* file);
+int config_compile(char* source, char* target);
+char** config_backends(char* file);
+int config_reload(char* file);
 int config_add_override(override_type type, char* data);
@@ -0,0 +1,383 @@
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/ctl"
+#include "midimonster.h"
+#include "control.h"
+#include "core.h"
+#include "backend.h"
+#include "routing.h"
+#include "shard.h"
+
+/*
+ * The control socket is implemented as a built-in backend without instances,
+ * which allows it to register its descriptors with the core multiplexer.
+ * All I/O is non-blocking, clients that can not keep up with the responses
+ * are disconnected.
+ */
+
+static struct {
+	char* path;
+	int fd;
+	size_t clients;
+	control_client* client;
+	//response buffer, shared by all clients
+	size_t alloc;
+	size_t length;
+	char* response;
+} control = {
+	.fd = -1
+};
+
+static int control_instance(instance* inst){
+	LOG("The control socket does not support instances");
+	return 1;
+}
+
+static int control_conf(char* option, char* value){
+	LOG("The control socket is configured with the control option in the core section");
+	return 1;
+}
+
+static int control_conf_instance(instance* inst, char* option, char* value){
+	return 1;
+}
+
+static channel* control_channel(instance* inst, char* spec, uint8_t flags){
+	return NULL;
+}
+
+static int control_set(instance* inst, size_t num, channel** c, channel_value* v){
+	return 0;
+}
+
+static int control_start(size_t n, instance** inst){
+	return 0;
+}
+
+static int control_printf(char* fmt, ...){
+	int length;
+	va_list args;
+
+	for(;;){
+		va_start(args, fmt);
+		length = vsnprintf(control.response + control.length, control.alloc - control.length, fmt, args);
+		va_end(args);
+
+		if(length < 0){
+			return 1;
+		}
+
+		if(control.length + length < control.alloc){
+			control.length += length;
+			return 0;
+		}
+
+		control.response = realloc(control.response, control.alloc + length + CONTROL_RESPONSE_CHUNK);
+		if(!control.response){
+			LOG("Failed to allocate memory");
+			control.alloc = control.length = 0;
+			return 1;
+		}
+		control.alloc += length + CONTROL_RESPONSE_CHUNK;
+	}
+}
+
+static int control_statistics(){
+	size_t u, n, backends = 0, sources, destinations, max_fanout;
+	backend* list = backends_list(&backends);
+	instance** inst = NULL;
+	core_shard_stats* shard = NULL;
+	instance_stats total;
+
+	for(u = 0; u < shards_count(); u++){
+		shard = core_statistics(u);
+		control_printf("shard %" PRIsize_t " iterations=%" PRIu64 " avg_usecs=%" PRIu64 " max_usecs=%" PRIu64 " fds=%" PRIsize_t " high_water=%" PRIsize_t " arena_growth=%" PRIsize_t "\n",
+				u, shard->iterations, shard->iterations ? shard->busy_usecs / shard->iterations : 0,
+				shard->max_usecs, shard->fds, routing_high_water(u), routing_arena_growth(u));
+	}
+
+	routing_table(&sources, &destinations, &max_fanout);
+	control_printf("routing sources=%" PRIsize_t " destinations=%" PRIsize_t " max_fanout=%" PRIsize_t "\n",
+			sources, destinations, max_fanout);
+
+	for(u = 0; u < backends; u++){
+		memset(&total, 0, sizeof(total));
+		for(n = 0, inst = backend_instances(list + u); inst && *inst; inst++, n++){
+			total.events_in += (*inst)->stats.events_in;
+			total.events_out += (*inst)->stats.events_out;
+			total.bytes_in += (*inst)->stats.bytes_in;
+			total.bytes_out += (*inst)->stats.bytes_out;
+			total.packets_in += (*inst)->stats.packets_in;
+			total.packets_out += (*inst)->stats.packets_out;
+		}
+
+		if(!n){
+			continue;
+		}
+
+		control_printf("backend %s instances=%" PRIsize_t " events_in=%" PRIu64 " events_out=%" PRIu64 " bytes_in=%" PRIu64 " bytes_out=%" PRIu64 " packets_in=%" PRIu64 " packets_out=%" PRIu64 "\n",
+				list[u].name, n, total.events_in, total.events_out, total.bytes_in, total.bytes_out, total.packets_in, total.packets_out);
+
+		for(inst = backend_instances(list + u); inst && *inst; inst++){
+			control_printf("instance %s backend=%s events_in=%" PRIu64 " events_out=%" PRIu64 " bytes_in=%" PRIu64 " bytes_out=%" PRIu64 " packets_in=%" PRIu64 " packets_out=%" PRIu64 "\n",
+					(*inst)->name, list[u].name, (*inst)->stats.events_in, (*inst)->stats.events_out,
+					(*inst)->stats.bytes_in, (*inst)->stats.bytes_out, (*inst)->stats.packets_in, (*inst)->stats.packets_out);
+		}
+	}
+	return 0;
+}
+
+#ifndef _WIN32
+static void control_disconnect(control_client* client){
+	mm_manage_fd(client->fd, BACKEND_NAME, 0, NULL);
+	close(client->fd);
+	client->fd = -1;
+	client->fill = 0;
+}
+
+static int control_accept(){
+	size_t u;
+	int fd = accept(control.fd, NULL, NULL);
+
+	if(fd < 0){
+		if(errno != EAGAIN && errno != EWOULDBLOCK){
+			LOGPF("Failed to accept control connection: %s", strerror(errno));
+		}
+		return 0;
+	}
+
+	if(fcntl(fd, F_SETFL, O_NONBLOCK) < 0){
+		LOGPF("Failed to set control connection non-blocking: %s", strerror(errno));
+		close(fd);
+		return 0;
+	}
+
+	//find a free client slot
+	for(u = 0; u < control.clients; u++){
+		if(control.client[u].fd < 0){
+			break;
+		}
+	}
+
+	if(u == CONTROL_MAX_CLIENTS){
+		LOG("Too many control connections, rejecting");
+		close(fd);
+		return 0;
+	}
+
+	if(u == control.clients){
+		control.client = realloc(control.client, (control.clients + 1) * sizeof(control_client));
+		if(!control.client){
+			LOG("Failed to allocate memory");
+			control.clients = 0;
+			close(fd);
+			return 1;
+		}
+		control.clients++;
+	}
+
+	control.client[u].fd = fd;
+	control.client[u].fill = 0;
+	//the slot index is stored instead of a pointer, as the client list may move
+	return mm_manage_fd(fd, BACKEND_NAME, 1, (void*) (u + 1));
+}
+
+static void control_command(control_client* client, char* command){
+	ssize_t sent;
+
+	control.length = 0;
+	if(!strcmp(command, "stats")){
+		control_statistics();
+	}
+	else if(!strcmp(command, "help")){
+		control_printf("commands: stats help\n");
+	}
+	else if(strlen(command)){
+		control_printf("error unknown command\n");
+	}
+	else{
+		return;
+	}
+	//an empty line terminates every response
+	control_printf("\n");
+
+	sent = send(client->fd, control.response, control.length, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if(sent < 0 || sent < control.length){
+		LOG("Control client not accepting data, disconnecting");
+		control_disconnect(client);
+	}
+}
+
+static void control_read(control_client* client){
+	ssize_t bytes;
+	char* line = NULL, *end = NULL;
+
+	bytes = recv(client->fd, client->buffer + client->fill, sizeof(client->buffer) - client->fill - 1, 0);
+	if(bytes <= 0){
+		if(bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+			return;
+		}
+		control_disconnect(client);
+		return;
+	}
+
+	client->fill += bytes;
+	client->buffer[client->fill] = 0;
+
+	//handle all complete lines
+	for(line = client->buffer; client->fd >= 0 && (end = strchr(line, '\n')); line = end + 1){
+		*end = 0;
+		if(end > line && end[-1] == '\r'){
+			end[-1] = 0;
+		}
+		control_command(client, line);
+	}
+
+	if(client->fd < 0){
+		return;
+	}
+
+	//keep the incomplete remainder
+	client->fill -= line - client->buffer;
+	memmove(client->buffer, line, client->fill + 1);
+	if(client->fill == sizeof(client->buffer) - 1){
+		LOG("Control command too long, disconnecting");
+		control_disconnect(client);
+	}
+}
+#endif
+
+static int control_process(size_t num, managed_fd* fds){
+	#ifndef _WIN32
+	size_t u;
+
+	for(u = 0; u < num; u++){
+		if(!fds[u].impl){
+			if(control_accept()){
+				return 1;
+			}
+			continue;
+		}
+
+		control_read(control.client + ((size_t) fds[u].impl) - 1);
+	}
+	#endif
+	return 0;
+}
+
+static int control_shutdown(size_t n, instance** inst){
+	size_t u;
+
+	#ifndef _WIN32
+	for(u = 0; u < control.clients; u++){
+		if(control.client[u].fd >= 0){
+			control_disconnect(control.client + u);
+		}
+	}
+	#endif
+	free(control.client);
+	control.client = NULL;
+	control.clients = 0;
+
+	if(control.fd >= 0){
+		mm_manage_fd(control.fd, BACKEND_NAME, 0, NULL);
+		close(control.fd);
+		control.fd = -1;
+		unlink(control.path);
+	}
+
+	free(control.path);
+	control.path = NULL;
+	free(control.response);
+	control.response = NULL;
+	control.alloc = control.length = 0;
+	return 0;
+}
+
+int control_initialize(){
+	backend control_backend = {
+		.name = BACKEND_NAME,
+		.conf = control_conf,
+		.create = control_instance,
+		.conf_instance = control_conf_instance,
+		.channel = control_channel,
+		.handle = control_set,
+		.process = control_process,
+		.start = control_start,
+		.shutdown = control_shutdown,
+		.flags = mmbackend_no_polling
+	};
+
+	return mm_backend_register(control_backend);
+}
+
+int control_configure(char* path){
+	#ifdef _WIN32
+	LOG("The control socket is not supported on this platform");
+	return 1;
+	#else
+	struct sockaddr_un addr = {
+		.sun_family = AF_UNIX
+	};
+
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		LOGPF("Control socket path %s is too long", path);
+		return 1;
+	}
+
+	free(control.path);
+	control.path = strdup(path);
+	if(!control.path){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	return 0;
+	#endif
+}
+
+int control_listen(){
+	#ifndef _WIN32
+	struct sockaddr_un addr = {
+		.sun_family = AF_UNIX
+	};
+
+	if(!control.path){
+		return 0;
+	}
+
+	strncpy(addr.sun_path, control.path, sizeof(addr.sun_path) - 1);
+
+	control.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(control.fd < 0){
+		LOGPF("Failed to create control socket: %s", strerror(errno));
+		return 1;
+	}
+
+	//remove stale sockets from previous runs
+	unlink(control.path);
+	if(bind(control.fd, (struct sockaddr*) &addr, sizeof(addr))
+			|| listen(control.fd, CONTROL_MAX_CLIENTS)
+			|| fcntl(control.fd, F_SETFL, O_NONBLOCK) < 0){
+		LOGPF("Failed to set up control socket %s: %s", control.path, strerror(errno));
+		close(control.fd);
+		control.fd = -1;
+		return 1;
+	}
+
+	LOGPF("Control socket listening on %s", control.path);
+	return mm_manage_fd(control.fd, BACKEND_NAME, 1, NULL);
+	#else
+	return 0;
+	#endif
+}
@@ -0,0 +1,13 @@
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_RESPONSE_CHUNK 4096
+
+typedef struct /*_control_client*/ {
+	int fd;
+	size_t fill;
+	char buffer[256];
+} control_client;
+
+/* Internal API */
+int control_initialize();
+int control_configure(char* path);
+int control_listen();
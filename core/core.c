@@ -11,45 +11,118 @@
 	#define MM_API __attribute__((dllexport))
 #endif
 
+//use epoll on linux unless the select() fallback is forced by the build
+#if defined(__linux__) && !defined(MM_SELECT)
+	#include <sys/epoll.h>
+	#define MM_EPOLL
+#endif
+
 #define BACKEND_NAME "core"
 #include "midimonster.h"
 #include "core.h"
 #include "backend.h"
 #include "routing.h"
+#include "timer.h"
+#include "shard.h"
+#include "latency.h"
+#include "control.h"
+#include "capture.h"
+#include "realtime.h"
 #include "plugin.h"
 #include "config.h"
 
-static struct {
+//every shard multiplexes its own set of descriptors
+static SHARD_LOCAL struct {
 	size_t n;
 	int max;
 	managed_fd* fd;
 	managed_fd* signaled;
+	#ifdef MM_EPOLL
+	int epoll_fd;
+	struct epoll_event* events;
+	#else
 	fd_set read;
+	#endif
 } fds = {
+	#ifdef MM_EPOLL
+	.epoll_fd = -1,
+	#endif
 	.max = -1
 };
 
-static volatile sig_atomic_t fd_set_dirty = 1;
-static uint64_t global_timestamp = 0;
+//iteration statistics, written by each shard and read by the control socket
+static core_shard_stats stats[MM_SHARDS_MAX] = {
+	{
+		0
+	}
+};
+
+#ifdef MM_EPOLL
+//time in microseconds to poll the descriptors before blocking, 0 disables busy polling
+static uint32_t busy_poll = 0;
+#endif
+
+static SHARD_LOCAL volatile sig_atomic_t fd_set_dirty = 1;
+//set while the shard is running core_iteration
+static SHARD_LOCAL uint8_t processing = 0;
+static SHARD_LOCAL uint64_t global_timestamp = 0;
+static SHARD_LOCAL uint64_t global_timestamp_us = 0;
 
 MM_API uint64_t mm_timestamp(){
 	return global_timestamp;
 }
 
-static void core_timestamp(){
+MM_API uint64_t mm_timestamp_us(){
+	return global_timestamp_us;
+}
+
+uint64_t core_clock_us(){
 	#ifdef _WIN32
-	global_timestamp = GetTickCount();
+	LARGE_INTEGER current, frequency;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&current);
+	return (current.QuadPart / frequency.QuadPart) * 1000000
+		+ ((current.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart;
 	#else
 	struct timespec current;
-	if(clock_gettime(CLOCK_MONOTONIC_COARSE, &current)){
-		LOGPF("Failed to update global timestamp, time-based processing for some backends may be impaired: %s", strerror(errno));
-		return;
+	if(clock_gettime(CLOCK_MONOTONIC, &current)){
+		LOGPF("Failed to read monotonic clock, time-based processing for some backends may be impaired: %s", strerror(errno));
+		return 0;
 	}
 
-	global_timestamp = current.tv_sec * 1000 + current.tv_nsec / 1000000;
+	return current.tv_sec * 1000000 + current.tv_nsec / 1000;
 	#endif
 }
 
+static void core_timestamp(){
+	uint64_t current = core_clock_us();
+
+	if(!current){
+		return;
+	}
+
+	global_timestamp_us = current;
+	global_timestamp = global_timestamp_us / 1000;
+}
+
+#ifdef MM_EPOLL
+static int core_epoll_arm(size_t u, int op){
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = fds.fd + u
+	};
+
+	if(epoll_ctl(fds.epoll_fd, op, fds.fd[u].fd, &ev)){
+		//the descriptor may have been closed and reused without being unregistered
+		if(op == EPOLL_CTL_MOD && errno == ENOENT){
+			return core_epoll_arm(u, EPOLL_CTL_ADD);
+		}
+		LOGPF("Failed to update multiplexer for descriptor %d: %s", fds.fd[u].fd, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+#else
 static fd_set core_collect(int* max_fd){
 	size_t u = 0;
 	fd_set rv_fds;
@@ -71,10 +144,16 @@ static fd_set core_collect(int* max_fd){
 
 	return rv_fds;
 }
+#endif
 
 MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl){
 	backend* b = backend_match(back);
 	size_t u;
+	managed_fd* grown = NULL;
+	#ifdef MM_EPOLL
+	size_t v;
+	struct epoll_event* events = NULL;
+	#endif
 
 	if(!b){
 		LOGPF("Unknown backend %s registered for managed fd", back);
@@ -86,11 +165,29 @@ MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl){
 		if(fds.fd[u].fd == new_fd && fds.fd[u].backend == b){
 			fds.fd[u].impl = impl;
 			if(!manage){
+				#ifdef MM_EPOLL
+				/*
+				 * The descriptor may already have been closed, which removes it from the set implicitly.
+				 * If its number has since been reused and registered by another backend, the
+				 * multiplexer registration belongs to that slot and must not be removed.
+				 */
+				for(v = 0; v < fds.n && (v == u || fds.fd[v].fd != new_fd); v++){
+				}
+				if(v == fds.n){
+					epoll_ctl(fds.epoll_fd, EPOLL_CTL_DEL, fds.fd[u].fd, NULL);
+				}
+				#endif
 				fds.fd[u].fd = -1;
 				fds.fd[u].backend = NULL;
 				fds.fd[u].impl = NULL;
 				fd_set_dirty = 1;
+				stats[shard_current()].fds--;
+			}
+			#ifdef MM_EPOLL
+			else{
+				return core_epoll_arm(u, EPOLL_CTL_MOD);
 			}
+			#endif
 			return 0;
 		}
 	}
@@ -105,25 +202,43 @@ MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl){
 			break;
 		}
 	}
-	//if necessary expand
+	//if necessary expand, the set only grows once all arrays have been resized
 	if(u == fds.n){
-		fds.fd = realloc(fds.fd, (fds.n + 1) * sizeof(managed_fd));
-		if(!fds.fd){
-			free(fds.signaled);
-			fds.signaled = NULL;
-			fds.n = 0;
+		grown = realloc(fds.fd, (fds.n + 1) * sizeof(managed_fd));
+		if(!grown){
 			LOG("Failed to allocate memory");
 			return 1;
 		}
 
-		fds.signaled = realloc(fds.signaled, (fds.n + 1) * sizeof(managed_fd));
-		if(!fds.signaled){
+		#ifdef MM_EPOLL
+		//the multiplexer stores pointers into the descriptor set, update them if it moved
+		if(grown != fds.fd){
+			fds.fd = grown;
+			for(v = 0; v < fds.n; v++){
+				if(fds.fd[v].fd >= 0 && core_epoll_arm(v, EPOLL_CTL_MOD)){
+					return 1;
+				}
+			}
+		}
+		#endif
+		fds.fd = grown;
+
+		grown = realloc(fds.signaled, (fds.n + 1) * sizeof(managed_fd));
+		if(!grown){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+		fds.signaled = grown;
+
+		#ifdef MM_EPOLL
+		//one additional slot for the shard wakeup descriptor
+		events = realloc(fds.events, (fds.n + 2) * sizeof(struct epoll_event));
+		if(!events){
 			LOG("Failed to allocate memory");
-			free(fds.fd);
-			fds.fd = NULL;
-			fds.n = 0;
 			return 1;
 		}
+		fds.events = events;
+		#endif
 		fds.n++;
 	}
 
@@ -132,11 +247,82 @@ MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl){
 	fds.fd[u].backend = b;
 	fds.fd[u].impl = impl;
 	fd_set_dirty = 1;
+	stats[shard_current()].fds++;
+	#ifdef MM_EPOLL
+	return core_epoll_arm(u, EPOLL_CTL_ADD);
+	#else
 	return 0;
+	#endif
 }
 
-int core_initialize(){
+static int core_multiplexer(){
+	#ifdef MM_EPOLL
+	fds.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(fds.epoll_fd < 0){
+		LOGPF("Failed to create multiplexer: %s", strerror(errno));
+		return 1;
+	}
+
+	fds.events = calloc(1, sizeof(struct epoll_event));
+	if(!fds.events){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	#else
 	FD_ZERO(&(fds.read));
+	#endif
+	return 0;
+}
+
+static int core_wakeup(){
+	#ifdef MM_EPOLL
+	//the wakeup descriptor is not a managed fd and is marked by an empty data pointer
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = NULL
+	};
+
+	if(shard_wakeup_fd() >= 0 && epoll_ctl(fds.epoll_fd, EPOLL_CTL_ADD, shard_wakeup_fd(), &ev)){
+		LOGPF("Failed to register shard wakeup descriptor: %s", strerror(errno));
+		return 1;
+	}
+	#endif
+	return 0;
+}
+
+int core_configure(char* option, char* value){
+	if(!strcmp(option, "threads")){
+		return shards_configure(strtoul(value, NULL, 10));
+	}
+	else if(!strcmp(option, "control")){
+		return control_configure(value);
+	}
+	else if(!strcmp(option, "capture")){
+		return capture_configure(value);
+	}
+	else if(!strcmp(option, "priority")
+			|| !strcmp(option, "cpu")
+			|| !strcmp(option, "lock")){
+		return realtime_configure(option, value);
+	}
+	else if(!strcmp(option, "busypoll")){
+		#ifdef MM_EPOLL
+		busy_poll = strtoul(value, NULL, 10);
+		return 0;
+		#else
+		LOG("Busy polling is only supported with the epoll multiplexer");
+		return 1;
+		#endif
+	}
+
+	LOGPF("Unknown core configuration option %s", option);
+	return 1;
+}
+
+int core_initialize(char** backends){
+	if(core_multiplexer()){
+		return 1;
+	}
 
 	//load initial timestamp
 	core_timestamp();
@@ -150,8 +336,13 @@ int core_initialize(){
 	_fmode = _O_BINARY;
 	#endif
 
-	//attach plugins
-	if(plugins_load(PLUGINS)){
+	//the control socket registers as a built-in backend
+	if(control_initialize()){
+		return 1;
+	}
+
+	//attach plugins, either all available or only those required by the configuration
+	if(backends ? plugins_load_selected(PLUGINS, backends) : plugins_load(PLUGINS)){
 		LOG("Failed to initialize a backend");
 		return 1;
 	}
@@ -159,31 +350,134 @@ int core_initialize(){
 	return 0;
 }
 
+static void fds_free(uint8_t close_managed){
+	size_t u;
+	for(u = 0; u < fds.n; u++){
+		if(close_managed && fds.fd[u].fd >= 0){
+			close(fds.fd[u].fd);
+			fds.fd[u].fd = -1;
+		}
+	}
+
+	fds.max = -1;
+	#ifdef MM_EPOLL
+	free(fds.events);
+	fds.events = NULL;
+	if(fds.epoll_fd >= 0){
+		close(fds.epoll_fd);
+		fds.epoll_fd = -1;
+	}
+	#endif
+	free(fds.signaled);
+	fds.signaled = NULL;
+	free(fds.fd);
+	fds.fd = NULL;
+	fds.n = 0;
+	memset(stats + shard_current(), 0, sizeof(core_shard_stats));
+}
+
+static void* core_shard(void* arg){
+	int rv = realtime_thread(shard_current()) || core_multiplexer();
+
+	core_timestamp();
+	rv |= core_wakeup();
+	rv |= routing_collector_start();
+	if(!rv){
+		rv = backends_start();
+	}
+
+	if(!shards_started(rv)){
+		while(shards_running()){
+			if(core_iteration()){
+				shards_fail();
+				break;
+			}
+		}
+	}
+
+	//descriptors are closed by the backends on shutdown, only release this shard's state
+	fds_free(0);
+	timers_cleanup();
+	routing_collector_free();
+	backends_notify_free();
+	return NULL;
+}
+
 int core_start(){
-	if(backends_start()){
+	int rv;
+
+	//freeze the mapping into the routing graph before any events can be generated
+	if(routing_compile()){
+		return 1;
+	}
+
+	#ifdef MM_LATENCY
+	if(latency_start()){
+		return 1;
+	}
+	#endif
+
+	//events may already be generated while starting the backends
+	if(capture_start()){
+		return 1;
+	}
+
+	//lock memory before allocating the event arenas, worker threads apply their own scheduling
+	if(realtime_start() || realtime_thread(0)){
+		return 1;
+	}
+
+	//distribute backends and instances to worker threads, this shard runs everything else
+	if(backends_assign_shards()){
+		return 1;
+	}
+	//preallocate the event arenas so steady-state routing does not need to allocate
+	if(shards_start(core_shard) || core_wakeup() || routing_collector_start()){
+		shards_started(1);
+		return 1;
+	}
+
+	rv = backends_start();
+	if(shards_started(rv) || rv){
+		return 1;
+	}
+
+	if(control_listen()){
 		return 1;
 	}
 
 	routing_stats();
 
-	if(!fds.n){
+	if(!fds.n && shards_count() < 2){
 		LOG("No descriptors registered for multiplexing");
 	}
 
 	return 0;
 }
 
-int core_iteration(){
+static int core_iterate(){
+	#ifdef MM_EPOLL
+	int timeout;
+	uint64_t spin, deadline;
+	#else
 	fd_set read_fds;
+	#endif
 	struct timeval tv;
 	int error;
 	size_t n, u;
+	uint64_t busy;
 	#ifdef _WIN32
 	char* error_message = NULL;
-	#else
+	#elif !defined(MM_EPOLL)
 	struct timespec ts;
 	#endif
 
+	//another shard failed
+	if(shards_failed()){
+		return 1;
+	}
+
+	#ifndef MM_EPOLL
 	//rebuild fd set if necessary
 	if(fd_set_dirty){
 		fds.read = core_collect(&(fds.max));
@@ -192,11 +486,50 @@ int core_iteration(){
 
 	//wait for & translate events
 	read_fds = fds.read;
+	#endif
 	tv = backend_timeout();
 
+	//do not block while events deferred by the routing budget are waiting for delivery
+	if(routing_pending()){
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+	}
+
+	#ifdef MM_EPOLL
+	//an empty epoll set just waits for the timeout, round up to not spin on sub-millisecond intervals
+	timeout = tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+	error = 0;
+	//poll without sleeping for a limited time first, trading CPU time for wake-up latency
+	if(busy_poll && timeout){
+		//never spin past the next deadline, then only sleep for the remainder of the timeout
+		deadline = tv.tv_sec * 1000000ULL + tv.tv_usec;
+		for(spin = core_clock_us(); !error && core_clock_us() - spin < min(busy_poll, deadline);){
+			error = epoll_wait(fds.epoll_fd, fds.events, fds.n + 1, 0);
+		}
+		spin = core_clock_us() - spin;
+		timeout = (spin < deadline) ? (deadline - spin + 999) / 1000 : 0;
+	}
+	if(!error){
+		error = epoll_wait(fds.epoll_fd, fds.events, fds.n + 1, timeout);
+	}
+	//signals handled by the frontend interrupt the wait, but are not an error
+	if(error < 0 && errno == EINTR){
+		error = 0;
+	}
+	else if(error < 0){
+		LOGPF("epoll_wait failed: %s", strerror(errno));
+		return 1;
+	}
+	#else
 	//check whether there are any fds active, windows does not like select() without descriptors
 	if(fds.max >= 0){
 		error = select(fds.max + 1, &read_fds, NULL, NULL, &tv);
+		#ifndef _WIN32
+		if(error < 0 && errno == EINTR){
+			FD_ZERO(&read_fds);
+			error = 0;
+		}
+		#endif
 		if(error < 0){
 			#ifndef _WIN32
 			LOGPF("select failed: %s", strerror(errno));
@@ -220,18 +553,41 @@ int core_iteration(){
 		nanosleep(&ts, NULL);
 		#endif
 	}
+	#endif
 
 	//update this iteration's timestamp
 	core_timestamp();
 
 	//find all signaled fds
 	n = 0;
+	#ifdef MM_EPOLL
+	for(u = 0; u < error; u++){
+		if(!fds.events[u].data.ptr){
+			shard_wakeup_ack();
+		}
+		else if(((managed_fd*) fds.events[u].data.ptr)->fd >= 0){
+			fds.signaled[n] = *((managed_fd*) fds.events[u].data.ptr);
+			n++;
+		}
+	}
+	#else
 	for(u = 0; u < fds.n; u++){
 		if(fds.fd[u].fd >= 0 && FD_ISSET(fds.fd[u].fd, &read_fds)){
 			fds.signaled[n] = fds.fd[u];
 			n++;
 		}
 	}
+	#endif
+
+	//collect events handed over by other shards
+	if(routing_inbox()){
+		return 1;
+	}
+
+	//dispatch expired timers
+	if(timers_process()){
+		return 1;
+	}
 
 	//run backend processing to collect events
 	DBGPF("%" PRIsize_t " backend FDs signaled", n);
@@ -240,30 +596,53 @@ int core_iteration(){
 	}
 
 	//route generated events
-	return routing_iteration();
+	error = routing_iteration();
+
+	//account the time spent processing, excluding the wait
+	busy = core_clock_us() - global_timestamp_us;
+	stats[shard_current()].iterations++;
+	stats[shard_current()].busy_usecs += busy;
+	stats[shard_current()].max_usecs = max(stats[shard_current()].max_usecs, busy);
+	return error;
 }
 
-static void fds_free(){
-	size_t u;
-	for(u = 0; u < fds.n; u++){
-		if(fds.fd[u].fd >= 0){
-			close(fds.fd[u].fd);
-			fds.fd[u].fd = -1;
-		}
-	}
+int core_iteration(){
+	int rv;
 
-	fds.max = -1;
-	free(fds.signaled);
-	fds.signaled = NULL;
-	free(fds.fd);
-	fds.fd = NULL;
-	fds.n = 0;
+	processing = 1;
+	rv = core_iterate();
+	processing = 0;
+	return rv;
+}
+
+int core_processing(){
+	return processing;
+}
+
+core_shard_stats* core_statistics(size_t shard){
+	return stats + shard;
+}
+
+void core_report(){
+	#ifdef MM_LATENCY
+	latency_report();
+	#else
+	LOG("Latency tracking is not enabled in this build");
+	#endif
 }
 
 void core_shutdown(){
+	//stop worker threads before their backends are shut down
+	shards_stop();
+	#ifdef MM_LATENCY
+	latency_report();
+	latency_cleanup();
+	#endif
 	backends_stop();
+	capture_stop();
+	timers_cleanup();
 	routing_cleanup();
-	fds_free();
+	fds_free(1);
 	plugins_close();
 	config_free();
 	fd_set_dirty = 1;
@@ -8,12 +8,15 @@
  *
  * 	* Initially, only the following API calls are valid:
  * 			config_add_override()
+ * 			config_backends()
  * 			core_initialize()
  * 		This allows the frontend to configure overrides for any configuration
  * 		loaded later (e.g. by parsing command line arguments) before initializing
  * 		the core.
  * 	* Calling core_initialize() attaches all backend modules to the system and
- * 		performs platform specific startup operations. From this point on,
+ * 		performs platform specific startup operations. If a list of backend names
+ * 		(e.g. as returned by config_backends()) is passed, only the plugins providing
+ * 		these backends are attached. From this point on,
  * 		core_shutdown() must be called before terminating the frontend.
  * 		All frontend API calls except `core_iteration` are now valid.
  * 		The core is now in the configuration stage in which the frontend
@@ -23,21 +26,46 @@
  * 		and provide them with the information required to connect to their data
  * 		sources and sinks. In this stage, only the following API calls are valid:
  * 			core_iteration()
+ * 			core_report()
+ * 			config_reload()
  * 			core_shutdown()
  * 	* The frontend will now repeatedly call core_iteration() to process any incoming
  * 		events. This API will block execution until either one or more events have
  * 		been registered or an internal timeout expires.
+ * 		In between iterations, the frontend may call core_report() to have the core
+ * 		log its runtime statistics, or config_reload() to apply changed mappings
+ * 		from the configuration without restarting.
  *	* Calling core_shutdown() releases all memory allocated by the core and any
  *		attached modules or plugins, including all configuration, overrides,
  *		mappings, statistics, etc. The core is now ready to exit or be
  *		reinitialized using core_initialize().
  */
 
-int core_initialize();
+int core_configure(char* option, char* value);
+int core_initialize(char** backends);
 int core_start();
 int core_iteration();
+void core_report();
 void core_shutdown();
 
+/*
+ * Returns whether the calling thread is currently processing events within core_iteration(),
+ * e.g. to rate-limit log output originating from the event path.
+ */
+int core_processing();
+
+/* Internal API */
+typedef struct /*_core_shard_stats*/ {
+	uint64_t iterations;
+	uint64_t busy_usecs;
+	uint64_t max_usecs;
+	size_t fds;
+} core_shard_stats;
+
+uint64_t core_clock_us();
+core_shard_stats* core_statistics(size_t shard);
+
 /* Public backend API */
 MM_API uint64_t mm_timestamp();
+MM_API uint64_t mm_timestamp_us();
 MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl);
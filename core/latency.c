@@ -0,0 +1,156 @@
+#include <string.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/lt"
+#include "midimonster.h"
+#include "latency.h"
+#include "backend.h"
+#include "core.h"
+
+#ifdef MM_LATENCY
+/*
+ * Log-linear histogram buckets: values below 2^LATENCY_SUB_BITS microseconds are stored
+ * exactly, above that every power of two is split into 2^LATENCY_SUB_BITS buckets.
+ * This keeps the relative error below ~6% up to LATENCY_MAX_BITS (~71 minutes).
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 32
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct /*_latency_histogram*/ {
+	instance* origin;
+	instance* target;
+	uint64_t count;
+	uint64_t max;
+	uint64_t bucket[LATENCY_BUCKETS];
+} latency_histogram;
+
+/*
+ * Histograms are indexed by origin and target instance index. Each histogram is only
+ * ever written by the shard running the target instance.
+ */
+static struct {
+	size_t instances;
+	latency_histogram** pair;
+} latency = {
+	0
+};
+
+static size_t latency_bucket(uint64_t usecs){
+	size_t exponent = 0;
+
+	if(usecs < LATENCY_SUB_BUCKETS){
+		return usecs;
+	}
+
+	if(usecs >> LATENCY_MAX_BITS){
+		return LATENCY_BUCKETS - 1;
+	}
+
+	for(exponent = LATENCY_SUB_BITS; usecs >> (exponent + 1); exponent++){
+	}
+
+	return (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + ((usecs >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+//highest value counted in a bucket
+static uint64_t latency_bucket_value(size_t bucket){
+	size_t exponent = bucket / LATENCY_SUB_BUCKETS;
+
+	if(!exponent){
+		return bucket;
+	}
+
+	exponent += LATENCY_SUB_BITS - 1;
+	return ((((uint64_t) (bucket % LATENCY_SUB_BUCKETS) + LATENCY_SUB_BUCKETS + 1)) << (exponent - LATENCY_SUB_BITS)) - 1;
+}
+
+static uint64_t latency_percentile(latency_histogram* hist, uint64_t permille){
+	size_t u;
+	uint64_t seen = 0, rank = (hist->count * permille + 999) / 1000;
+
+	for(u = 0; u < LATENCY_BUCKETS; u++){
+		seen += hist->bucket[u];
+		if(seen >= rank){
+			return min(latency_bucket_value(u), hist->max);
+		}
+	}
+	return hist->max;
+}
+
+int latency_start(){
+	size_t instances = instances_count();
+	latency_cleanup();
+
+	latency.pair = calloc(instances * instances, sizeof(latency_histogram*));
+	if(instances && !latency.pair){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	latency.instances = instances;
+	return 0;
+}
+
+void latency_record(size_t n, instance** origin, channel** target, uint64_t* ingress){
+	size_t u, pair;
+	uint64_t now = core_clock_us(), usecs;
+
+	for(u = 0; u < n; u++){
+		//instances created after start are not tracked
+		if(origin[u]->index >= latency.instances || target[u]->instance->index >= latency.instances){
+			continue;
+		}
+
+		pair = origin[u]->index * latency.instances + target[u]->instance->index;
+		if(!latency.pair[pair]){
+			latency.pair[pair] = calloc(1, sizeof(latency_histogram));
+			if(!latency.pair[pair]){
+				LOG("Failed to allocate memory");
+				return;
+			}
+			latency.pair[pair]->origin = origin[u];
+			latency.pair[pair]->target = target[u]->instance;
+		}
+
+		usecs = (now > ingress[u]) ? (now - ingress[u]) : 0;
+		latency.pair[pair]->bucket[latency_bucket(usecs)]++;
+		latency.pair[pair]->max = max(latency.pair[pair]->max, usecs);
+		latency.pair[pair]->count++;
+	}
+}
+
+void latency_report(){
+	size_t from, to;
+	latency_histogram* hist = NULL;
+
+	LOGPF("Event latency between %" PRIsize_t " instances (microseconds)", latency.instances);
+	for(from = 0; from < latency.instances; from++){
+		for(to = 0; to < latency.instances; to++){
+			hist = latency.pair[from * latency.instances + to];
+			if(!hist || !hist->count){
+				continue;
+			}
+
+			LOGRPF("%s > %s: %" PRIu64 " events, p50 %" PRIu64 ", p99 %" PRIu64 ", p999 %" PRIu64 ", max %" PRIu64,
+					hist->origin->name, hist->target->name, hist->count,
+					latency_percentile(hist, 500), latency_percentile(hist, 990), latency_percentile(hist, 999), hist->max);
+		}
+	}
+}
+
+void latency_cleanup(){
+	size_t u;
+
+	for(u = 0; u < latency.instances * latency.instances; u++){
+		free(latency.pair[u]);
+	}
+	free(latency.pair);
+	latency.pair = NULL;
+	latency.instances = 0;
+}
+#endif
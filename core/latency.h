@@ -0,0 +1,12 @@
+/*
+ * Per-route latency tracking is only compiled in when building with MM_LATENCY defined.
+ * Latency is measured from the time an event enters the core until the handler of
+ * the target instance returns.
+ */
+#ifdef MM_LATENCY
+/* Internal API */
+int latency_start();
+void latency_record(size_t n, instance** origin, channel** target, uint64_t* ingress);
+void latency_report();
+void latency_cleanup();
+#endif
@@ -20,6 +20,7 @@
 #define BACKEND_NAME "core/pl"
 #include "midimonster.h"
 #include "plugin.h"
+#include "core.h"
 
 static size_t plugins = 0;
 static void** plugin_handle = NULL;
@@ -28,6 +29,7 @@ static int plugin_attach(char* path, char* file){
 	plugin_init init = NULL;
 	void* handle = NULL;
 	char* lib = NULL;
+	uint64_t load_start = core_clock_us();
 	#ifdef _WIN32
 	char* path_separator = "\\";
 	#else
@@ -78,6 +80,7 @@ static int plugin_attach(char* path, char* file){
 		free(lib);
 		return 0;
 	}
+	LOGPF("Attached plugin %s in %" PRIu64 " usec", lib, core_clock_us() - load_start);
 	free(lib);
 
 	plugin_handle = realloc(plugin_handle, (plugins + 1) * sizeof(void*));
@@ -166,6 +169,40 @@ load_done:
 #endif
 }
 
+int plugins_load_selected(char* path, char** backends){
+	size_t u;
+	int rv = 0;
+	char* lib = NULL;
+	struct stat file_stat;
+	#ifdef _WIN32
+	char* extension = ".dll", *path_separator = "\\";
+	#else
+	char* extension = ".so", *path_separator = "/";
+	#endif
+
+	for(u = 0; !rv && backends[u]; u++){
+		//plugins are named after the backend they provide
+		lib = calloc(strlen(path) + strlen(backends[u]) + strlen(extension) + 2, sizeof(char));
+		if(!lib){
+			LOG("Failed to allocate memory");
+			return -1;
+		}
+		sprintf(lib, "%s%s%s%s", path,
+				(path[strlen(path) - 1] == path_separator[0]) ? "" : path_separator,
+				backends[u], extension);
+
+		//unknown backends are reported while parsing the configuration
+		if(stat(lib, &file_stat) || !S_ISREG(file_stat.st_mode)){
+			LOGPF("No plugin found for backend %s", backends[u]);
+		}
+		else{
+			rv = plugin_attach(path, lib + strlen(lib) - strlen(backends[u]) - strlen(extension));
+		}
+		free(lib);
+	}
+	return rv;
+}
+
 int plugins_close(){
 	size_t u;
 
@@ -2,4 +2,5 @@ typedef int (*plugin_init)();
 
 /* Internal API */
 int plugins_load(char* dir);
+int plugins_load_selected(char* dir, char** backends);
 int plugins_close();
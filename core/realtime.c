@@ -0,0 +1,144 @@
+#ifdef __linux__
+	//required for the CPU affinity macros
+	#define _GNU_SOURCE
+#endif
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/rtm"
+#include "midimonster.h"
+#include "realtime.h"
+#include "shard.h"
+
+#ifdef MM_REALTIME
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+static struct {
+	//SCHED_FIFO priority, 0 keeps the default policy
+	int priority;
+	//CPU per shard, shards beyond the list are not pinned
+	size_t cpus;
+	int cpu[MM_SHARDS_MAX];
+	uint8_t lock;
+	//affinity of the process before pinning any thread
+	uint8_t inherited;
+	cpu_set_t initial;
+} realtime = {
+	0
+};
+
+static int realtime_cpus(char* list){
+	char* value = list, *next = list;
+	long cpu;
+
+	for(realtime.cpus = 0; *next; realtime.cpus++){
+		cpu = strtol(value, &next, 10);
+		if(next == value || cpu < 0 || cpu >= CPU_SETSIZE || (*next && *next != ',') || realtime.cpus >= MM_SHARDS_MAX){
+			LOGPF("Invalid CPU list %s", list);
+			realtime.cpus = 0;
+			return 1;
+		}
+		realtime.cpu[realtime.cpus] = cpu;
+		value = *next ? next + 1 : next;
+	}
+	return 0;
+}
+#endif
+
+int realtime_configure(char* option, char* value){
+	#ifdef MM_REALTIME
+	char* next = value;
+
+	if(!strcmp(option, "priority")){
+		realtime.priority = strtol(value, &next, 10);
+		if(*next || (realtime.priority && (realtime.priority < sched_get_priority_min(SCHED_FIFO) || realtime.priority > sched_get_priority_max(SCHED_FIFO)))){
+			LOGPF("Invalid realtime priority %s, valid priorities are %d to %d", value,
+					sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+			realtime.priority = 0;
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "cpu")){
+		return realtime_cpus(value);
+	}
+	else if(!strcmp(option, "lock")){
+		realtime.lock = 0;
+		if(!strcmp(value, "on")){
+			realtime.lock = 1;
+		}
+		return 0;
+	}
+
+	LOGPF("Unknown realtime option %s", option);
+	return 1;
+	#else
+	LOGPF("Realtime option %s is not supported on this platform", option);
+	return 1;
+	#endif
+}
+
+int realtime_start(){
+	#ifdef MM_REALTIME
+	if(sched_getaffinity(0, sizeof(realtime.initial), &realtime.initial)){
+		LOGPF("Failed to query CPU affinity: %s", strerror(errno));
+		return 1;
+	}
+	realtime.inherited = 1;
+
+	/*
+	 * Lock all current and future mappings, which also prefaults the event arenas
+	 * allocated afterwards. Page faults can thus not delay the event processing.
+	 */
+	if(realtime.lock){
+		if(mlockall(MCL_CURRENT | MCL_FUTURE)){
+			LOGPF("Failed to lock process memory: %s", strerror(errno));
+			return 1;
+		}
+		LOG("Process memory locked");
+	}
+	#endif
+	return 0;
+}
+
+int realtime_thread(size_t shard){
+	#ifdef MM_REALTIME
+	struct sched_param param = {
+		.sched_priority = realtime.priority
+	};
+	cpu_set_t cpus;
+	int error;
+
+	//worker threads inherit the affinity of the main shard, which needs to be reset for unpinned workers
+	if(shard < realtime.cpus){
+		CPU_ZERO(&cpus);
+		CPU_SET(realtime.cpu[shard], &cpus);
+		if(sched_setaffinity(0, sizeof(cpus), &cpus)){
+			LOGPF("Failed to pin shard %" PRIsize_t " to CPU %d: %s", shard, realtime.cpu[shard], strerror(errno));
+			return 1;
+		}
+		LOGPF("Shard %" PRIsize_t " pinned to CPU %d", shard, realtime.cpu[shard]);
+	}
+	else if(realtime.cpus && realtime.inherited && sched_setaffinity(0, sizeof(realtime.initial), &realtime.initial)){
+		LOGPF("Failed to reset CPU affinity for shard %" PRIsize_t ": %s", shard, strerror(errno));
+		return 1;
+	}
+
+	if(realtime.priority){
+		error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(error){
+			LOGPF("Failed to set realtime priority %d for shard %" PRIsize_t ": %s", realtime.priority, shard, strerror(error));
+			return 1;
+		}
+		LOGPF("Shard %" PRIsize_t " running with realtime priority %d", shard, realtime.priority);
+	}
+	#endif
+	return 0;
+}
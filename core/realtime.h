@@ -0,0 +1,14 @@
+/*
+ * Realtime execution options for the threads running the core, configured in
+ * the `[backend core]` section. Only supported on Linux.
+ * The memory lock is process-wide and applied once before the event arenas are
+ * allocated, scheduling policy and CPU affinity are applied per shard.
+ */
+#if defined(__linux__)
+	#define MM_REALTIME
+#endif
+
+/* Internal API */
+int realtime_configure(char* option, char* value);
+int realtime_start();
+int realtime_thread(size_t shard);
@@ -12,157 +12,1181 @@
 
 #define BACKEND_NAME "core/rt"
 #define MM_SWAP_LIMIT 20
+#define MM_EVENT_BUDGET 65536
+//minimum capacity of an event collection arena
+#define MM_ARENA_MIN 64
+#define ROUTING_MAP_INITIAL 1024
 #include "midimonster.h"
 #include "routing.h"
 #include "backend.h"
+#include "shard.h"
+#include "latency.h"
+#include "transform.h"
+#include "capture.h"
 
 /* Core-internal structures */
+/*
+ * All arrays of an event collection are carved from one arena allocation,
+ * values first to keep them aligned. The arrays are kept separate, as they
+ * are handed to the backends as-is.
+ */
 typedef struct /*_event_collection*/ {
 	size_t alloc;
 	size_t n;
+	void* arena;
 	channel** channel;
 	channel_value* value;
+	#ifdef MM_LATENCY
+	//time the event entered the core and the instance it originated from
+	uint64_t* ingress;
+	instance** origin;
+	#endif
 } event_collection;
 
 typedef struct /*_mm_channel_mapping*/ {
 	channel* from;
 	size_t destinations;
+	size_t alloc;
 	channel** to;
+	transform_chain** transform;
 } channel_mapping;
 
+/*
+ * Delivery state for destination channels with delivery attributes, kept in
+ * an open-addressed table keyed by the channel. Filtering happens on the shard
+ * delivering to the channel, so the state is never shared between threads.
+ */
+typedef struct /*_mm_routing_filter*/ {
+	channel* target;
+	uint8_t attributes;
+	//last value delivered to the channel, only valid if delivered is set
+	uint8_t delivered;
+	channel_value last;
+	//position of the pending event for the channel within the batch being filtered
+	size_t slot;
+	uint64_t batch;
+} routing_filter;
+
+/*
+ * The compiled routing graph stores all destinations in one contiguous array,
+ * with the destinations for route `r` (as stored in the `route` member of the
+ * source channel, offset by one) located at destination[offset[r]] up to
+ * destination[offset[r + 1] - 1].
+ */
+typedef struct /*_mm_routing_graph*/ {
+	size_t sources;
+	channel** source;
+	size_t* offset;
+	channel** destination;
+	//per-destination value transforms, NULL if no mapping uses transforms
+	transform_chain** transform;
+	//delivery state table, NULL if no mapping uses delivery attributes
+	size_t filters;
+	routing_filter* filter;
+	size_t max_fanout;
+} routing_graph;
+
 static struct {
-	//routing_hash is set up for 256 buckets
-	size_t entries[256];
-	channel_mapping* map[256];
+	//construction map keyed by the source channel, only used while building the mapping
+	//open-addressing table with linear probing, kept at most half full
+	size_t size;
+	size_t entries;
+	channel_mapping* map;
 
-	event_collection pool[2];
-	event_collection* events;
+	//graph loaded from a compiled configuration, installed as-is if nothing else is mapped
+	routing_graph loaded;
+
+	routing_graph graph;
 } routing = {
-	.events = routing.pool
+	.size = 0
+};
+
+//event collections are kept per shard, the routing graph is shared read-only
+static SHARD_LOCAL struct {
+	event_collection pool[2];
+	//index of the primary collection within the pool
+	size_t primary;
+	//events to be handed over to other shards
+	event_collection outbox[MM_SHARDS_MAX];
+	//set while events are being deferred to later iterations
+	uint8_t deferring;
+	//counter identifying the batch currently being filtered
+	uint64_t batch;
+} collector = {
+	.primary = 0
+};
+
+//largest number of events delivered at once, per shard
+static size_t high_water[MM_SHARDS_MAX] = {
+	0
+};
+
+//number of event arena reallocations after startup, per shard
+static size_t arena_growth[MM_SHARDS_MAX] = {
+	0
 };
 
-static size_t routing_hash(channel* key){
-	uint64_t repr = (uint64_t) key;
-	//return 8bit hash for 256 buckets, not ideal but it works
-	return (repr ^ (repr >> 8) ^ (repr >> 16) ^ (repr >> 24) ^ (repr >> 32)) & 0xFF;
+/*
+ * Scratch space for finding strongly connected components in the routing graph.
+ * Nodes are the routes (i.e. source channels) followed by one node per instance
+ * of a backend flagged with mmbackend_feedback, which stands in for all routes
+ * originating from that instance.
+ */
+typedef struct /*_routing_loop_search*/ {
+	size_t nodes;
+	size_t counter;
+	size_t* index;
+	size_t* lowlink;
+	uint8_t* onstack;
+	size_t* stack;
+	size_t depth;
+	size_t* frame;
+	size_t* cursor;
+	size_t frames;
+	//routes grouped by the index of their source instance
+	size_t* instance_offset;
+	size_t* instance_route;
+} routing_loop_search;
+
+static void routing_graph_free(routing_graph* graph){
+	size_t u;
+
+	for(u = 0; graph->transform && u < graph->offset[graph->sources]; u++){
+		transform_free(graph->transform[u]);
+	}
+	free(graph->transform);
+	graph->transform = NULL;
+	free(graph->filter);
+	graph->filter = NULL;
+	graph->filters = 0;
+	free(graph->source);
+	free(graph->offset);
+	free(graph->destination);
+	graph->source = graph->destination = NULL;
+	graph->offset = NULL;
+	graph->sources = graph->max_fanout = 0;
+}
+
+static size_t routing_channel_hash(channel* c, size_t size){
+	//fibonacci hashing, the table size is a power of two
+	return (((uint64_t) c) * 0x9E3779B97F4A7C15ULL >> 32) & (size - 1);
+}
+
+//returns the slot containing the mapping for a source channel, or the empty slot terminating its probe sequence
+static size_t routing_map_slot(channel_mapping* map, size_t size, channel* from){
+	size_t slot = routing_channel_hash(from, size);
+
+	for(; map[slot].from && map[slot].from != from; slot = (slot + 1) & (size - 1)){
+	}
+	return slot;
+}
+
+static int routing_map_resize(size_t size){
+	size_t u;
+	channel_mapping* map = calloc(size, sizeof(channel_mapping));
+
+	if(!map){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	for(u = 0; u < routing.size; u++){
+		if(routing.map[u].from){
+			map[routing_map_slot(map, size, routing.map[u].from)] = routing.map[u];
+		}
+	}
+
+	free(routing.map);
+	routing.map = map;
+	routing.size = size;
+	return 0;
 }
 
-int mm_map_channel(channel* from, channel* to){
-	size_t u, m, bucket = routing_hash(from);
+//merge a loaded graph into the construction map, keeping the order in which mappings were specified
+static int routing_load_flush(){
+	size_t u, d;
+	int rv = 0;
+	routing_graph loaded = routing.loaded;
 
-	//find existing source mapping
-	for(u = 0; u < routing.entries[bucket]; u++){
-		if(routing.map[bucket][u].from == from){
-			break;
+	memset(&routing.loaded, 0, sizeof(routing.loaded));
+	for(u = 0; !rv && u < loaded.sources; u++){
+		for(d = loaded.offset[u]; !rv && d < loaded.offset[u + 1]; d++){
+			//the map takes ownership of the transform
+			rv = mm_map_channel(loaded.source[u], loaded.destination[d], loaded.transform ? loaded.transform[d] : NULL);
+			if(loaded.transform){
+				loaded.transform[d] = NULL;
+			}
 		}
 	}
 
-	//create new entry
-	if(u == routing.entries[bucket]){
-		routing.map[bucket] = realloc(routing.map[bucket], (routing.entries[bucket] + 1) * sizeof(channel_mapping));
-		if(!routing.map[bucket]){
-			routing.entries[bucket] = 0;
+	routing_graph_free(&loaded);
+	return rv;
+}
+
+int mm_map_channel(channel* from, channel* to, transform_chain* transform){
+	size_t m, alloc;
+	channel_mapping* mapping = NULL;
+	channel** grown_to = NULL;
+	transform_chain** grown_transform = NULL;
+
+	//mappings specified after loading a compiled configuration may override its edges
+	if(routing.loaded.sources && routing_load_flush()){
+		transform_free(transform);
+		return 1;
+	}
+
+	if((routing.entries + 1) * 2 > routing.size
+			&& routing_map_resize(routing.size ? routing.size * 2 : ROUTING_MAP_INITIAL)){
+		transform_free(transform);
+		return 1;
+	}
+
+	//find or create the source mapping
+	mapping = routing.map + routing_map_slot(routing.map, routing.size, from);
+	if(!mapping->from){
+		mapping->from = from;
+		routing.entries++;
+	}
+
+	//check whether the target is already mapped, the last transform specified wins
+	for(m = 0; m < mapping->destinations; m++){
+		if(mapping->to[m] == to){
+			transform_free(mapping->transform[m]);
+			mapping->transform[m] = transform;
+			return 0;
+		}
+	}
+
+	//add a mapping target, growing the arrays geometrically
+	if(mapping->destinations == mapping->alloc){
+		alloc = mapping->alloc ? mapping->alloc * 2 : 1;
+		grown_to = realloc(mapping->to, alloc * sizeof(channel*));
+		if(grown_to){
+			mapping->to = grown_to;
+			grown_transform = realloc(mapping->transform, alloc * sizeof(transform_chain*));
+		}
+		if(!grown_transform){
 			LOG("Failed to allocate memory");
+			transform_free(transform);
 			return 1;
 		}
+		mapping->transform = grown_transform;
+		mapping->alloc = alloc;
+	}
+
+	mapping->to[mapping->destinations] = to;
+	mapping->transform[mapping->destinations] = transform;
+	mapping->destinations++;
+	return 0;
+}
+
+int routing_load(size_t channels, channel** table, size_t sources, uint32_t* source, size_t* offset, uint32_t* destination, transform_chain** transform){
+	size_t u, slot, size = 2;
+	uint8_t distinct = 1;
+	channel** set = NULL;
+	transform_chain* chain = NULL;
+	routing_graph graph = {
+		.sources = sources
+	};
 
-		memset(routing.map[bucket] + routing.entries[bucket], 0, sizeof(channel_mapping));
-		routing.entries[bucket]++;
-		routing.map[bucket][u].from = from;
+	//mappings loaded earlier precede this graph
+	if(routing.loaded.sources && routing_load_flush()){
+		goto bail;
 	}
 
-	//check whether the target is already mapped
-	for(m = 0; m < routing.map[bucket][u].destinations; m++){
-		if(routing.map[bucket][u].to[m] == to){
-			return 0;
+	//the edges are only unique if no two table entries resolved to the same channel
+	for(; size < channels * 2; size *= 2){
+	}
+	set = calloc(size, sizeof(channel*));
+	if(!set){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	for(u = 0; distinct && u < channels; u++){
+		for(slot = routing_channel_hash(table[u], size); set[slot] && set[slot] != table[u]; slot = (slot + 1) & (size - 1)){
+		}
+		distinct = set[slot] ? 0 : 1;
+		set[slot] = table[u];
+	}
+	free(set);
+
+	//otherwise, the construction map merges the duplicate edges
+	if(!distinct){
+		LOG("Channels of the compiled configuration were resolved to the same channel, merging their mappings");
+		for(u = 0; u < sources; u++){
+			for(slot = offset[u]; slot < offset[u + 1]; slot++){
+				//the map takes ownership of the transform, even if mapping fails
+				chain = transform ? transform[slot] : NULL;
+				if(transform){
+					transform[slot] = NULL;
+				}
+				if(mm_map_channel(table[source[u]], table[destination[slot]], chain)){
+					goto bail;
+				}
+			}
 		}
+		free(transform);
+		return 0;
 	}
 
-	//add a mapping target
-	routing.map[bucket][u].to = realloc(routing.map[bucket][u].to, (routing.map[bucket][u].destinations + 1) * sizeof(channel*));
-	if(!routing.map[bucket][u].to){
+	if(!sources){
+		free(transform);
+		return 0;
+	}
+
+	graph.source = calloc(sources, sizeof(channel*));
+	graph.offset = calloc(sources + 1, sizeof(size_t));
+	graph.destination = calloc(offset[sources], sizeof(channel*));
+	if(!graph.source || !graph.offset || !graph.destination){
 		LOG("Failed to allocate memory");
-		routing.map[bucket][u].destinations = 0;
+		routing_graph_free(&graph);
+		goto bail;
+	}
+
+	for(u = 0; u < sources; u++){
+		graph.source[u] = table[source[u]];
+		graph.max_fanout = max(graph.max_fanout, offset[u + 1] - offset[u]);
+	}
+	for(u = 0; u < offset[sources]; u++){
+		graph.destination[u] = table[destination[u]];
+	}
+	memcpy(graph.offset, offset, (sources + 1) * sizeof(size_t));
+	//the graph takes ownership of the transform table
+	graph.transform = transform;
+	routing.loaded = graph;
+	return 0;
+
+bail:
+	for(u = 0; transform && u < offset[sources]; u++){
+		transform_free(transform[u]);
+	}
+	free(transform);
+	return 1;
+}
+
+//returns the route index for a source channel, or routing.graph.sources if the channel is not routed
+static inline size_t routing_route(channel* c){
+	//an unset route index wraps around and fails the range check
+	size_t route = c->route - 1;
+
+	//channels not registered as sources (or foreign channel structures) are not routed
+	if(route >= routing.graph.sources || routing.graph.source[route] != c){
+		return routing.graph.sources;
+	}
+	return route;
+}
+
+static routing_filter* routing_filter_find(routing_graph* graph, channel* c){
+	size_t u = routing_channel_hash(c, graph->filters);
+
+	for(; graph->filter[u].target; u = (u + 1) & (graph->filters - 1)){
+		if(graph->filter[u].target == c){
+			return graph->filter + u;
+		}
+	}
+	return NULL;
+}
+
+static inline void routing_event_move(event_collection* events, size_t to, size_t from){
+	events->channel[to] = events->channel[from];
+	events->value[to] = events->value[from];
+	#ifdef MM_LATENCY
+	events->ingress[to] = events->ingress[from];
+	events->origin[to] = events->origin[from];
+	#endif
+}
+
+/*
+ * Apply delivery attributes to a batch about to be delivered. Coalesced events
+ * replace the value of the first event for the same channel in place, so the
+ * remaining event keeps its position within the batch. Change detection is
+ * applied to the coalesced batch.
+ */
+static void routing_filter_batch(event_collection* events){
+	size_t u, n = 0;
+	routing_filter* filter = NULL;
+
+	collector.batch++;
+	for(u = 0; u < events->n; u++){
+		filter = routing_filter_find(&routing.graph, events->channel[u]);
+		if(filter && filter->attributes & transform_coalesce){
+			if(filter->batch == collector.batch){
+				//the surviving event takes over the value and latency tracking data of the last one
+				events->value[filter->slot] = events->value[u];
+				#ifdef MM_LATENCY
+				events->ingress[filter->slot] = events->ingress[u];
+				events->origin[filter->slot] = events->origin[u];
+				#endif
+				continue;
+			}
+			filter->batch = collector.batch;
+			filter->slot = n;
+		}
+		routing_event_move(events, n++, u);
+	}
+	events->n = n;
+
+	for(u = 0, n = 0; u < events->n; u++){
+		filter = routing_filter_find(&routing.graph, events->channel[u]);
+		if(filter && filter->attributes & transform_changed){
+			if(filter->delivered
+					&& filter->last.normalised == events->value[u].normalised
+					&& filter->last.raw.u64 == events->value[u].raw.u64){
+				continue;
+			}
+			filter->last = events->value[u];
+			filter->delivered = 1;
+		}
+		routing_event_move(events, n++, u);
+	}
+	events->n = n;
+}
+
+static int routing_arena_resize(event_collection* collection, size_t alloc){
+	size_t event_size = sizeof(channel_value) + sizeof(channel*);
+	event_collection resized = {
+		.alloc = alloc,
+		.n = collection->n
+	};
+
+	#ifdef MM_LATENCY
+	event_size += sizeof(uint64_t) + sizeof(instance*);
+	#endif
+
+	resized.arena = malloc(alloc * event_size);
+	if(!resized.arena){
+		LOG("Failed to allocate memory");
+		free(collection->arena);
+		memset(collection, 0, sizeof(event_collection));
 		return 1;
 	}
 
-	routing.map[bucket][u].to[routing.map[bucket][u].destinations] = to;
-	routing.map[bucket][u].destinations++;
+	resized.value = resized.arena;
+	#ifdef MM_LATENCY
+	resized.ingress = (uint64_t*) (resized.value + alloc);
+	resized.channel = (channel**) (resized.ingress + alloc);
+	resized.origin = (instance**) (resized.channel + alloc);
+	#else
+	resized.channel = (channel**) (resized.value + alloc);
+	#endif
+
+	//move pending events
+	if(collection->n){
+		memcpy(resized.value, collection->value, collection->n * sizeof(channel_value));
+		memcpy(resized.channel, collection->channel, collection->n * sizeof(channel*));
+		#ifdef MM_LATENCY
+		memcpy(resized.ingress, collection->ingress, collection->n * sizeof(uint64_t));
+		memcpy(resized.origin, collection->origin, collection->n * sizeof(instance*));
+		#endif
+	}
+
+	free(collection->arena);
+	*collection = resized;
 	return 0;
 }
 
-MM_API int mm_channel_event(channel* c, channel_value v){
-	size_t u, p, bucket = routing_hash(c);
+static int routing_reserve(event_collection* collection, size_t events){
+	size_t alloc = max(collection->alloc, MM_ARENA_MIN);
+
+	if(collection->n + events <= collection->alloc){
+		return 0;
+	}
+
+	//grow geometrically to keep reallocations out of bursts
+	for(; alloc < collection->n + events; alloc *= 2){
+	}
 
-	//find mapped channels
-	for(u = 0; u < routing.entries[bucket]; u++){
-		if(routing.map[bucket][u].from == c){
-			break;
+	if(collection->alloc){
+		arena_growth[shard_current()]++;
+		DBGPF("Growing event arena from %" PRIsize_t " to %" PRIsize_t " events", collection->alloc, alloc);
+	}
+	return routing_arena_resize(collection, alloc);
+}
+
+static inline void routing_enqueue(size_t route, channel_value v){
+	event_collection* events = collector.pool + collector.primary;
+	size_t p, n = 0, fanout = routing.graph.offset[route + 1] - routing.graph.offset[route];
+	transform_chain** transform = routing.graph.transform ? routing.graph.transform + routing.graph.offset[route] : NULL;
+	channel** destination = routing.graph.destination + routing.graph.offset[route];
+
+	//enqueue channel events
+	/*
+	 * This might lead to one channel being mentioned multiple times in an apply call.
+	 * That effect should not be eliminated as there are legitimate uses for one channel
+	 * being set multiple times in one core iteration (e.g. for stateful layer selection messages).
+	 * Mappings may opt in to coalescing with the `coalesce` attribute, see routing_filter_batch.
+	 */
+	if(!transform){
+		memcpy(events->channel + events->n, destination, fanout * sizeof(channel*));
+		for(n = 0; n < fanout; n++){
+			events->value[events->n + n] = v;
 		}
 	}
+	else{
+		//transforms may drop events, so the collection is filled sequentially
+		for(p = 0; p < fanout; p++){
+			events->value[events->n + n] = v;
+			if(transform[p] && transform_apply(transform[p], events->value + events->n + n)){
+				continue;
+			}
+			events->channel[events->n + n] = destination[p];
+			n++;
+		}
+	}
+
+	#ifdef MM_LATENCY
+	for(p = 0; p < n; p++){
+		events->ingress[events->n + p] = mm_timestamp_us();
+		events->origin[events->n + p] = routing.graph.source[route]->instance;
+	}
+	#endif
+
+	events->n += n;
+}
 
-	if(u == routing.entries[bucket]){
+MM_API int mm_channel_event(channel* c, channel_value v){
+	size_t route = routing_route(c);
+
+	c->instance->stats.events_in++;
+	capture_events(1, &c, &v);
+	if(route == routing.graph.sources){
 		//target-only channel
 		return 0;
 	}
 
-	//resize event structures to fit additional events
-	if(routing.events->n + routing.map[bucket][u].destinations >= routing.events->alloc){
-		routing.events->channel = realloc(routing.events->channel, (routing.events->alloc + routing.map[bucket][u].destinations) * sizeof(channel*));
-		routing.events->value = realloc(routing.events->value, (routing.events->alloc + routing.map[bucket][u].destinations) * sizeof(channel_value));
+	if(routing_reserve(collector.pool + collector.primary, routing.graph.offset[route + 1] - routing.graph.offset[route])){
+		return 1;
+	}
+
+	routing_enqueue(route, v);
+	return 0;
+}
+
+MM_API int mm_channel_events(size_t n, channel** c, channel_value* v){
+	size_t u, route, events = 0;
+
+	capture_events(n, c, v);
+	//sum up the fan-out of all routed channels to reserve capacity once
+	for(u = 0; u < n; u++){
+		c[u]->instance->stats.events_in++;
+		route = routing_route(c[u]);
+		if(route != routing.graph.sources){
+			events += routing.graph.offset[route + 1] - routing.graph.offset[route];
+		}
+	}
+
+	if(!events){
+		return 0;
+	}
+
+	if(routing_reserve(collector.pool + collector.primary, events)){
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		route = routing_route(c[u]);
+		if(route != routing.graph.sources){
+			routing_enqueue(route, v[u]);
+		}
+	}
+	return 0;
+}
+
+MM_API int mm_routed_channels(char* name, size_t* n, channel*** channels){
+	size_t u, found = 0;
+	instance* inst = instance_match(name);
 
-		if(!routing.events->channel || !routing.events->value){
+	*n = 0;
+	*channels = NULL;
+	if(!inst){
+		return 1;
+	}
+
+	for(u = 0; u < routing.graph.sources; u++){
+		found += (routing.graph.source[u]->instance == inst) ? 1 : 0;
+	}
+
+	if(!found){
+		return 0;
+	}
+
+	*channels = calloc(found, sizeof(channel*));
+	if(!*channels){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+
+	for(u = 0; u < routing.graph.sources; u++){
+		if(routing.graph.source[u]->instance == inst){
+			(*channels)[(*n)++] = routing.graph.source[u];
+		}
+	}
+	return 0;
+}
+
+static void routing_map_free(){
+	size_t u, d;
+
+	for(u = 0; u < routing.size; u++){
+		//transforms not moved to a graph are still owned by the mapping
+		for(d = 0; d < routing.map[u].destinations; d++){
+			transform_free(routing.map[u].transform[d]);
+		}
+		free(routing.map[u].to);
+		free(routing.map[u].transform);
+	}
+	free(routing.map);
+	routing.map = NULL;
+	routing.size = 0;
+	routing.entries = 0;
+	routing_graph_free(&routing.loaded);
+}
+
+//returns the next successor of a node in the loop search graph, or search->nodes if there is none
+static size_t routing_loop_successor(routing_loop_search* search, size_t node, size_t* cursor){
+	channel* destination = NULL;
+	size_t route;
+
+	//instance nodes connect to all routes of that instance
+	if(node >= routing.graph.sources){
+		node -= routing.graph.sources;
+		if(search->instance_offset[node] + *cursor < search->instance_offset[node + 1]){
+			return search->instance_route[search->instance_offset[node] + (*cursor)++];
+		}
+		return search->nodes;
+	}
+
+	while(routing.graph.offset[node] + *cursor < routing.graph.offset[node + 1]){
+		destination = routing.graph.destination[routing.graph.offset[node] + (*cursor)++];
+		//setting the channel on a feedback instance may generate events on any of its channels
+		if(destination->instance->backend->flags & mmbackend_feedback){
+			return routing.graph.sources + destination->instance->index;
+		}
+
+		//setting the channel on an echoing instance generates an event on the same channel
+		route = routing_route(destination);
+		if(destination->instance->backend->flags & mmbackend_echo && route != routing.graph.sources){
+			return route;
+		}
+	}
+	return search->nodes;
+}
+
+static void routing_loop_visit(routing_loop_search* search, size_t node){
+	search->index[node] = search->lowlink[node] = ++search->counter;
+	search->stack[search->depth++] = node;
+	search->onstack[node] = 1;
+	search->frame[search->frames] = node;
+	search->cursor[search->frames++] = 0;
+}
+
+static void routing_loop_report(routing_loop_search* search, size_t root){
+	size_t node, routes = 0, self = 0, cursor = 0, members = 0;
+	channel* sample = NULL;
+
+	do{
+		node = search->stack[--search->depth];
+		search->onstack[node] = 0;
+		members++;
+		if(node < routing.graph.sources){
+			sample = routing.graph.source[node];
+			routes++;
+		}
+	} while(node != root);
+
+	//single routes only form a loop when mapped onto themselves
+	if(members == 1 && root < routing.graph.sources){
+		for(node = routing_loop_successor(search, root, &cursor); node < search->nodes; node = routing_loop_successor(search, root, &cursor)){
+			self |= (node == root);
+		}
+	}
+
+	if(sample && (members > 1 || self)){
+		LOGRPF("Mapping contains a potential event loop through %" PRIsize_t " channels, including instance %s", routes, sample->instance->name);
+	}
+}
+
+static int routing_loops(){
+	size_t u, node, next, instances = 0;
+	routing_loop_search search = {
+		0
+	};
+
+	//size the instance node space to the highest instance index in use
+	for(u = 0; u < routing.graph.sources; u++){
+		instances = max(instances, routing.graph.source[u]->instance->index + 1);
+	}
+	for(u = 0; routing.graph.sources && u < routing.graph.offset[routing.graph.sources]; u++){
+		instances = max(instances, routing.graph.destination[u]->instance->index + 1);
+	}
+
+	search.nodes = routing.graph.sources + instances;
+	if(!search.nodes){
+		return 0;
+	}
+
+	search.index = calloc(search.nodes, sizeof(size_t));
+	search.lowlink = calloc(search.nodes, sizeof(size_t));
+	search.onstack = calloc(search.nodes, sizeof(uint8_t));
+	search.stack = calloc(search.nodes, sizeof(size_t));
+	search.frame = calloc(search.nodes, sizeof(size_t));
+	search.cursor = calloc(search.nodes, sizeof(size_t));
+	search.instance_offset = calloc(instances + 1, sizeof(size_t));
+	search.instance_route = calloc(routing.graph.sources + 1, sizeof(size_t));
+	if(!search.index || !search.lowlink || !search.onstack || !search.stack
+			|| !search.frame || !search.cursor || !search.instance_offset || !search.instance_route){
+		LOG("Failed to allocate memory");
+		goto bail;
+	}
+
+	//group routes by source instance
+	for(u = 0; u < routing.graph.sources; u++){
+		search.instance_offset[routing.graph.source[u]->instance->index + 1]++;
+	}
+	for(u = 0; u < instances; u++){
+		search.instance_offset[u + 1] += search.instance_offset[u];
+	}
+	for(u = 0; u < routing.graph.sources; u++){
+		search.instance_route[search.cursor[routing.graph.source[u]->instance->index] + search.instance_offset[routing.graph.source[u]->instance->index]] = u;
+		search.cursor[routing.graph.source[u]->instance->index]++;
+	}
+	memset(search.cursor, 0, search.nodes * sizeof(size_t));
+
+	//iterative variant of Tarjans algorithm, every component with a cycle is a potential event loop
+	for(u = 0; u < search.nodes; u++){
+		if(search.index[u]){
+			continue;
+		}
+
+		routing_loop_visit(&search, u);
+		while(search.frames){
+			node = search.frame[search.frames - 1];
+			next = routing_loop_successor(&search, node, search.cursor + search.frames - 1);
+			if(next < search.nodes){
+				if(!search.index[next]){
+					routing_loop_visit(&search, next);
+				}
+				else if(search.onstack[next]){
+					search.lowlink[node] = min(search.lowlink[node], search.index[next]);
+				}
+				continue;
+			}
+
+			//all successors visited, propagate to the parent
+			search.frames--;
+			if(search.frames){
+				search.lowlink[search.frame[search.frames - 1]] = min(search.lowlink[search.frame[search.frames - 1]], search.lowlink[node]);
+			}
+
+			if(search.lowlink[node] == search.index[node]){
+				routing_loop_report(&search, node);
+			}
+		}
+	}
+
+bail:
+	free(search.index);
+	free(search.lowlink);
+	free(search.onstack);
+	free(search.stack);
+	free(search.frame);
+	free(search.cursor);
+	free(search.instance_offset);
+	free(search.instance_route);
+	return 0;
+}
+
+static int routing_compile_filters(routing_graph* graph, size_t attributed){
+	size_t u, slot;
+	transform_chain* chain = NULL;
+
+	if(!attributed){
+		return 0;
+	}
+
+	//keep the load factor below one half
+	for(graph->filters = 2; graph->filters < attributed * 2; graph->filters <<= 1){
+	}
+	graph->filter = calloc(graph->filters, sizeof(routing_filter));
+	if(!graph->filter){
+		LOG("Failed to allocate memory");
+		graph->filters = 0;
+		return 1;
+	}
+
+	//the attributes of all edges into a channel are combined
+	for(u = 0; u < graph->offset[graph->sources]; u++){
+		chain = graph->transform[u];
+		if(!chain || !chain->attributes){
+			continue;
+		}
+
+		for(slot = routing_channel_hash(graph->destination[u], graph->filters);
+				graph->filter[slot].target && graph->filter[slot].target != graph->destination[u];
+				slot = (slot + 1) & (graph->filters - 1)){
+		}
+		graph->filter[slot].target = graph->destination[u];
+		graph->filter[slot].attributes |= chain->attributes;
+	}
+	return 0;
+}
+
+//returns the index of an edge in the live graph, or the number of edges if there is no such edge
+static size_t routing_graph_edge(size_t route, channel* destination, transform_chain* transform){
+	size_t u, edges = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
+
+	if(route >= routing.graph.sources){
+		return edges;
+	}
+
+	for(u = routing.graph.offset[route]; u < routing.graph.offset[route + 1]; u++){
+		if(routing.graph.destination[u] == destination){
+			return transform_equal(routing.graph.transform ? routing.graph.transform[u] : NULL, transform) ? u : edges;
+		}
+	}
+	return edges;
+}
+
+/*
+ * Hand the transform chains and delivery state of edges present in both the live and a newly
+ * compiled graph over to the new graph, so a reload does not reset e.g. deadband or change
+ * detection state. The new (identical) chains are released with the live graph.
+ */
+static void routing_carry_state(routing_graph* graph){
+	size_t u, edge, match, route, edges = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
+	transform_chain* xchg = NULL;
+	routing_filter* filter = NULL;
+
+	for(u = 0; routing.graph.transform && graph->transform && u < graph->sources; u++){
+		route = routing_route(graph->source[u]);
+		if(route == routing.graph.sources){
+			continue;
+		}
+
+		for(edge = graph->offset[u]; edge < graph->offset[u + 1]; edge++){
+			if(!graph->transform[edge]){
+				continue;
+			}
+
+			match = routing_graph_edge(route, graph->destination[edge], graph->transform[edge]);
+			if(match < edges){
+				xchg = graph->transform[edge];
+				graph->transform[edge] = routing.graph.transform[match];
+				routing.graph.transform[match] = xchg;
+			}
+		}
+	}
+
+	for(u = 0; routing.graph.filters && u < graph->filters; u++){
+		if(graph->filter[u].target){
+			filter = routing_filter_find(&routing.graph, graph->filter[u].target);
+			if(filter && filter->attributes == graph->filter[u].attributes){
+				graph->filter[u].delivered = filter->delivered;
+				graph->filter[u].last = filter->last;
+			}
+		}
+	}
+}
+
+//flatten the construction map into a graph
+static int routing_flatten(routing_graph* graph){
+	size_t u, d, route = 0, destinations = 0, transforms = 0;
+	channel_mapping* mapping = NULL;
+
+	//count destinations and transformed edges
+	graph->sources = routing.entries;
+	for(u = 0; u < routing.size; u++){
+		mapping = routing.map + u;
+		destinations += mapping->destinations;
+		for(d = 0; d < mapping->destinations; d++){
+			transforms += mapping->transform[d] ? 1 : 0;
+		}
+	}
+
+	if(graph->sources){
+		graph->source = calloc(graph->sources, sizeof(channel*));
+		graph->offset = calloc(graph->sources + 1, sizeof(size_t));
+		graph->destination = calloc(destinations, sizeof(channel*));
+		if(!graph->source || !graph->offset || !graph->destination){
+			LOG("Failed to allocate memory");
+			return 1;
+		}
+	}
+
+	//the transform table is only allocated when required, which keeps the plain fan-out path
+	if(transforms){
+		graph->transform = calloc(destinations, sizeof(transform_chain*));
+		if(!graph->transform){
 			LOG("Failed to allocate memory");
-			routing.events->alloc = 0;
-			routing.events->n = 0;
 			return 1;
 		}
+	}
 
-		routing.events->alloc += routing.map[bucket][u].destinations;
+	for(u = 0; u < routing.size; u++){
+		mapping = routing.map + u;
+		if(!mapping->from){
+			continue;
+		}
+		graph->source[route] = mapping->from;
+		graph->offset[route + 1] = graph->offset[route] + mapping->destinations;
+		memcpy(graph->destination + graph->offset[route], mapping->to, mapping->destinations * sizeof(channel*));
+		graph->max_fanout = max(graph->max_fanout, mapping->destinations);
+		//move the transform chains into the graph
+		for(d = 0; graph->transform && d < mapping->destinations; d++){
+			graph->transform[graph->offset[route] + d] = mapping->transform[d];
+			mapping->transform[d] = NULL;
+		}
+		route++;
 	}
+	return 0;
+}
+
+int routing_compile(){
+	size_t u, attributed = 0;
+	routing_graph graph = {
+		0
+	};
+
+	//a loaded graph is used directly, unless other mappings need to be merged into it
+	if(routing.loaded.sources && routing.entries && routing_load_flush()){
+		return 1;
+	}
+
+	if(routing.loaded.sources){
+		graph = routing.loaded;
+		memset(&routing.loaded, 0, sizeof(routing.loaded));
+	}
+	else if(routing_flatten(&graph)){
+		routing_graph_free(&graph);
+		return 1;
+	}
+
+	for(u = 0; graph.transform && u < graph.offset[graph.sources]; u++){
+		attributed += (graph.transform[u] && graph.transform[u]->attributes) ? 1 : 0;
+	}
+
+	if(routing_compile_filters(&graph, attributed)){
+		routing_graph_free(&graph);
+		return 1;
+	}
+
+	//carry over the state of unchanged edges while the route indices still refer to the live graph
+	routing_carry_state(&graph);
+	for(u = 0; u < graph.sources; u++){
+		graph.source[u]->route = u + 1;
+	}
+
+	//the graph is immutable from here on, the construction map is no longer required
+	routing_graph_free(&routing.graph);
+	routing.graph = graph;
+	routing_map_free();
+
+	//loops are legitimate in some setups, so only warn about them
+	return routing_loops();
+}
+
+int routing_update(){
+	size_t u, d, route, added = 0, kept = 0;
+	size_t previous = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
+	channel_mapping* mapping = NULL;
+
+	//edges loaded from a compiled configuration are compared via the construction map
+	if(routing_load_flush()){
+		routing_map_free();
+		return 1;
+	}
+
+	//compare the new mapping against the live graph
+	for(u = 0; u < routing.size; u++){
+		mapping = routing.map + u;
+		if(!mapping->from){
+			continue;
+		}
+		route = routing_route(mapping->from);
+		for(d = 0; d < mapping->destinations; d++){
+			//an edge with a changed transform is counted as removed and added
+			if(routing_graph_edge(route, mapping->to[d], mapping->transform[d]) < previous){
+				kept++;
+			}
+			else{
+				added++;
+			}
+		}
+	}
+
+	LOGPF("Configuration reloaded, %" PRIsize_t " mappings added, %" PRIsize_t " removed, %" PRIsize_t " unchanged",
+			added, previous - kept, kept);
+
+	if(!added && kept == previous){
+		routing_map_free();
+		return 0;
+	}
+
+	if(routing_compile()){
+		routing_map_free();
+		return 1;
+	}
+	routing_stats();
+	return 0;
+}
+
+void routing_discard(){
+	routing_map_free();
+}
+
+void routing_stats(){
+	size_t destinations = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
+
+	LOGPF("Routing %" PRIsize_t " sources to %" PRIsize_t " destinations, maximum fan-out %" PRIsize_t " (%" PRIsize_t " bytes)",
+			routing.graph.sources,
+			destinations,
+			routing.graph.max_fanout,
+			routing.graph.sources * sizeof(channel*) + (routing.graph.sources + 1) * sizeof(size_t)
+			+ destinations * sizeof(channel*) * (routing.graph.transform ? 2 : 1)
+			+ routing.graph.filters * sizeof(routing_filter));
+}
+
+void routing_table(size_t* sources, size_t* destinations, size_t* max_fanout){
+	*sources = routing.graph.sources;
+	*destinations = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
+	*max_fanout = routing.graph.max_fanout;
+}
+
+void routing_export(channel*** source, size_t** offset, channel*** destination, transform_chain*** transform){
+	*source = routing.graph.source;
+	*offset = routing.graph.offset;
+	*destination = routing.graph.destination;
+	*transform = routing.graph.transform;
+}
+
+size_t routing_high_water(size_t shard){
+	return high_water[shard];
+}
+
+size_t routing_arena_growth(size_t shard){
+	return arena_growth[shard];
+}
+
+int routing_collector_start(){
+	size_t u, events = routing.graph.sources ? routing.graph.offset[routing.graph.sources] : 0;
 
-	//enqueue channel events
 	/*
-	 * This might lead to one channel being mentioned multiple times in an apply call.
-	 * That effect should not be eliminated as there are legitimate uses for one channel
-	 * being set multiple times in one core iteration (e.g. for stateful layer selection messages)
+	 * Size the arenas for every source firing once per iteration, which includes the
+	 * largest fan-out. Anything beyond that is handled by growing the arena on demand.
 	 */
-	memcpy(routing.events->channel + routing.events->n, routing.map[bucket][u].to, routing.map[bucket][u].destinations * sizeof(channel*));
-	for(p = 0; p < routing.map[bucket][u].destinations; p++){
-		routing.events->value[routing.events->n + p] = v;
+	events = min(max(events, routing.graph.max_fanout), MM_EVENT_BUDGET);
+	for(u = 0; u < sizeof(collector.pool) / sizeof(collector.pool[0]); u++){
+		if(routing_reserve(collector.pool + u, events)){
+			return 1;
+		}
 	}
 
-	routing.events->n += routing.map[bucket][u].destinations;
+	//outboxes are only used to hand over events to other shards
+	for(u = 0; shards_count() > 1 && u < shards_count(); u++){
+		if(u != shard_current() && routing_reserve(collector.outbox + u, events)){
+			return 1;
+		}
+	}
 	return 0;
 }
 
-void routing_stats(){
-	size_t n = 0, u, max = 0;
+int routing_inbox(){
+	event_collection* events = collector.pool + collector.primary;
+	shard_batch* batch = NULL;
+
+	//append events routed to this shard by other shards, they are already resolved to their destinations
+	for(batch = shard_pop(); batch; batch = shard_pop()){
+		if(routing_reserve(events, batch->n)){
+			return 1;
+		}
 
-	//count and report mappings
-	for(u = 0; u < sizeof(routing.map) / sizeof(routing.map[0]); u++){
-		n += routing.entries[u];
-		max = max(max, routing.entries[u]);
+		memcpy(events->channel + events->n, batch->channel, batch->n * sizeof(channel*));
+		memcpy(events->value + events->n, batch->value, batch->n * sizeof(channel_value));
+		#ifdef MM_LATENCY
+		memcpy(events->ingress + events->n, batch->ingress, batch->n * sizeof(uint64_t));
+		memcpy(events->origin + events->n, batch->origin, batch->n * sizeof(instance*));
+		#endif
+		events->n += batch->n;
 	}
+	return 0;
+}
+
+static int routing_handover(event_collection* events){
+	size_t u, shard, local = 0;
+	shard_batch batch;
 
-	LOGPF("Routing %" PRIsize_t " sources, largest bucket has %" PRIsize_t " entries",
-			n, max);
+	//keep events for this shard in place, move all others to the respective outbox
+	for(u = 0; u < events->n; u++){
+		shard = instance_shard(events->channel[u]->instance);
+		if(shard == shard_current()){
+			events->channel[local] = events->channel[u];
+			events->value[local] = events->value[u];
+			#ifdef MM_LATENCY
+			events->ingress[local] = events->ingress[u];
+			events->origin[local] = events->origin[u];
+			#endif
+			local++;
+			continue;
+		}
+
+		if(routing_reserve(collector.outbox + shard, 1)){
+			return 1;
+		}
+		collector.outbox[shard].channel[collector.outbox[shard].n] = events->channel[u];
+		collector.outbox[shard].value[collector.outbox[shard].n] = events->value[u];
+		#ifdef MM_LATENCY
+		collector.outbox[shard].ingress[collector.outbox[shard].n] = events->ingress[u];
+		collector.outbox[shard].origin[collector.outbox[shard].n] = events->origin[u];
+		#endif
+		collector.outbox[shard].n++;
+	}
+	events->n = local;
+
+	//hand over one batch per target shard
+	for(u = 0; u < shards_count(); u++){
+		if(collector.outbox[u].n){
+			batch.n = collector.outbox[u].n;
+			batch.channel = collector.outbox[u].channel;
+			batch.value = collector.outbox[u].value;
+			#ifdef MM_LATENCY
+			batch.ingress = collector.outbox[u].ingress;
+			batch.origin = collector.outbox[u].origin;
+			#endif
+			if(shard_push(u, &batch)){
+				return 1;
+			}
+			collector.outbox[u].n = 0;
+		}
+	}
+	return 0;
+}
+
+int routing_pending(){
+	return collector.pool[collector.primary].n != 0;
 }
 
 int routing_iteration(){
 	event_collection* secondary = NULL;
-	size_t u, swaps = 0;
+	size_t swaps = 0, delivered = 0;
 
-	//limit number of collector swaps per iteration to prevent complete deadlock
-	while(routing.events->n && swaps < MM_SWAP_LIMIT){
+	//limit collector swaps and delivered events per iteration to keep feedback loops from starving all other processing
+	while(collector.pool[collector.primary].n && swaps < MM_SWAP_LIMIT && delivered < MM_EVENT_BUDGET){
 		//swap primary and secondary event collectors
-		DBGPF("Swapping event collectors, %" PRIsize_t " events in primary", routing.events->n);
-		for(u = 0; u < sizeof(routing.pool) / sizeof(routing.pool[0]); u++){
-			if(routing.events != routing.pool + u){
-				secondary = routing.events;
-				routing.events = routing.pool + u;
-				break;
-			}
+		DBGPF("Swapping event collectors, %" PRIsize_t " events in primary", collector.pool[collector.primary].n);
+		secondary = collector.pool + collector.primary;
+		collector.primary ^= 1;
+		high_water[shard_current()] = max(high_water[shard_current()], secondary->n);
+
+		//deliver events for instances on other shards through their inbox
+		if(shards_count() > 1 && routing_handover(secondary)){
+			LOG("Failed to hand over events to other shards");
+			return 1;
+		}
+
+		//apply delivery attributes
+		if(routing.graph.filter){
+			routing_filter_batch(secondary);
 		}
 
 		//push collected events to target backends
@@ -171,32 +1195,51 @@ int routing_iteration(){
 			return 1;
 		}
 
+		#ifdef MM_LATENCY
+		latency_record(secondary->n, secondary->origin, secondary->channel, secondary->ingress);
+		#endif
+
 		//reset the event count
+		delivered += secondary->n;
 		secondary->n = 0;
+		swaps++;
 	}
 
-	if(swaps == MM_SWAP_LIMIT){
-		LOG("Iteration swap limit hit, a backend may be configured to route events in an infinite loop");
+	//remaining events stay in the primary collector and are delivered in the next iteration
+	if(collector.pool[collector.primary].n){
+		if(!collector.deferring){
+			LOGPF("Iteration limit hit after %" PRIsize_t " events, deferring %" PRIsize_t " events. A backend may be configured to route events in an infinite loop",
+					delivered, collector.pool[collector.primary].n);
+		}
+		collector.deferring = 1;
+	}
+	else{
+		collector.deferring = 0;
 	}
 
 	return 0;
 }
 
-void routing_cleanup(){
-	size_t u, n;
+void routing_collector_free(){
+	size_t u;
 
-	for(u = 0; u < sizeof(routing.map) / sizeof(routing.map[0]); u++){
-		for(n = 0; n < routing.entries[u]; n++){
-			free(routing.map[u][n].to);
-		}
-		free(routing.map[u]);
-		routing.map[u] = NULL;
-		routing.entries[u] = 0;
+	for(u = 0; u < sizeof(collector.pool) / sizeof(collector.pool[0]); u++){
+		free(collector.pool[u].arena);
+		memset(collector.pool + u, 0, sizeof(event_collection));
 	}
 
-	for(u = 0; u < sizeof(routing.pool) / sizeof(routing.pool[0]); u++){
-		free(routing.pool[u].channel);
-		free(routing.pool[u].value);
-		routing.pool[u].alloc = 0;
+	for(u = 0; u < sizeof(collector.outbox) / sizeof(collector.outbox[0]); u++){
+		free(collector.outbox[u].arena);
+		memset(collector.outbox + u, 0, sizeof(event_collection));
 	}
+	collector.primary = 0;
+	collector.deferring = 0;
+}
+
+void routing_cleanup(){
+	memset(high_water, 0, sizeof(high_water));
+	memset(arena_growth, 0, sizeof(arena_growth));
+	routing_map_free();
+	routing_graph_free(&routing.graph);
+	routing_collector_free();
 }
@@ -1,9 +1,23 @@
 /* Internal API */
-int mm_map_channel(channel* from, channel* to);
+int mm_map_channel(channel* from, channel* to, struct _mm_transform_chain* transform);
+int routing_load(size_t channels, channel** table, size_t sources, uint32_t* source, size_t* offset, uint32_t* destination, struct _mm_transform_chain** transform);
+int routing_compile();
+int routing_update();
+void routing_discard();
+int routing_inbox();
+int routing_pending();
 int routing_iteration();
 void routing_stats();
+void routing_table(size_t* sources, size_t* destinations, size_t* max_fanout);
+void routing_export(channel*** source, size_t** offset, channel*** destination, struct _mm_transform_chain*** transform);
+size_t routing_high_water(size_t shard);
+size_t routing_arena_growth(size_t shard);
+int routing_collector_start();
+void routing_collector_free();
 void routing_cleanup();
 
 /* Public backend API */
 MM_API int mm_channel_event(channel* c, channel_value v);
+MM_API int mm_channel_events(size_t n, channel** c, channel_value* v);
 
+MM_API int mm_routed_channels(char* name, size_t* n, channel*** channels);
@@ -0,0 +1,454 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/sh"
+#include "midimonster.h"
+#include "shard.h"
+
+#ifdef MM_SHARDS
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/eventfd.h>
+
+/*
+ * Cross-shard event delivery uses one intrusive multi-producer/single-consumer
+ * queue per shard (after D. Vyukov). Producers only ever swap the head pointer,
+ * the consuming shard owns the tail. The stub node keeps the queue non-empty.
+ */
+typedef struct _shard_node {
+	_Atomic(struct _shard_node*) next;
+	//producing shard, which receives the node back once it has been consumed
+	size_t owner;
+	//nodes are recycled per capacity class, see shard_node_get
+	size_t size_class;
+	struct _shard_node* free;
+	shard_batch batch;
+} shard_node;
+
+typedef struct /*_shard_inbox*/ {
+	_Atomic(shard_node*) head;
+	shard_node* tail;
+	shard_node stub;
+	//batch handed out by the last shard_pop, returned to its owner on the next call
+	shard_node* pending;
+	int wakeup;
+} shard_inbox;
+
+/*
+ * Batch nodes are recycled by the shard that allocated them. Consumers return spent nodes
+ * through a queue of the same kind as the inbox, the owner drains it into per-class
+ * free lists before pushing the next batch, so steady-state delivery does not allocate.
+ */
+typedef struct /*_shard_pool*/ {
+	shard_inbox returned;
+	//only accessed by the owning shard
+	shard_node* free[SHARD_NODE_CLASSES];
+	size_t cached[SHARD_NODE_CLASSES];
+} shard_pool;
+
+static _Thread_local size_t current_shard = 0;
+
+static struct {
+	size_t n;
+	void* (*worker)(void*);
+	pthread_t thread[MM_SHARDS_MAX];
+	shard_inbox inbox[MM_SHARDS_MAX];
+	shard_pool pool[MM_SHARDS_MAX];
+	//startup synchronization
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+	size_t started;
+	size_t threads;
+	atomic_int running;
+	atomic_int failed;
+} shards = {
+	.n = 1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.change = PTHREAD_COND_INITIALIZER
+};
+
+static void shard_enqueue(shard_inbox* queue, shard_node* node){
+	shard_node* prev = NULL;
+
+	atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange_explicit(&queue->head, node, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+static shard_node* shard_dequeue(shard_inbox* queue){
+	shard_node* tail = queue->tail, *head = NULL;
+	shard_node* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+	//skip the stub node
+	if(tail == &queue->stub){
+		if(!next){
+			return NULL;
+		}
+		queue->tail = next;
+		tail = next;
+		next = atomic_load_explicit(&next->next, memory_order_acquire);
+	}
+
+	if(next){
+		queue->tail = next;
+		return tail;
+	}
+
+	//a producer is still linking its node, it will signal the wakeup descriptor once done
+	head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if(tail != head){
+		return NULL;
+	}
+
+	//re-insert the stub to be able to hand out the last node
+	shard_enqueue(queue, &queue->stub);
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if(next){
+		queue->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+static void shard_queue_init(shard_inbox* queue){
+	atomic_init(&queue->head, &queue->stub);
+	atomic_init(&queue->stub.next, NULL);
+	queue->tail = &queue->stub;
+	queue->pending = NULL;
+}
+
+//take back the nodes returned by the consumers, caching a limited number per size class
+static void shard_pool_drain(shard_pool* pool){
+	shard_node* node = NULL;
+
+	for(node = shard_dequeue(&pool->returned); node; node = shard_dequeue(&pool->returned)){
+		if(node->size_class >= SHARD_NODE_CLASSES || pool->cached[node->size_class] >= SHARD_POOL_DEPTH){
+			free(node);
+			continue;
+		}
+
+		node->free = pool->free[node->size_class];
+		pool->free[node->size_class] = node;
+		pool->cached[node->size_class]++;
+	}
+}
+
+static void shard_pool_free(shard_pool* pool){
+	size_t u;
+	shard_node* node = NULL;
+
+	shard_pool_drain(pool);
+	for(u = 0; u < SHARD_NODE_CLASSES; u++){
+		for(node = pool->free[u]; node; node = pool->free[u]){
+			pool->free[u] = node->free;
+			free(node);
+		}
+		pool->cached[u] = 0;
+	}
+	pool->returned.tail = NULL;
+}
+
+static shard_node* shard_node_get(size_t n){
+	shard_pool* pool = shards.pool + current_shard;
+	size_t size_class = 0, size = SHARD_NODE_MIN;
+	size_t event_size = sizeof(channel_value) + sizeof(channel*);
+	shard_node* node = NULL;
+
+	#ifdef MM_LATENCY
+	event_size += sizeof(uint64_t) + sizeof(instance*);
+	#endif
+
+	for(; size < n && size_class < SHARD_NODE_CLASSES; size_class++){
+		size *= 2;
+	}
+
+	//batches beyond the largest class are allocated to size and not cached
+	if(size_class >= SHARD_NODE_CLASSES){
+		size = n;
+	}
+	else{
+		shard_pool_drain(pool);
+		if(pool->free[size_class]){
+			node = pool->free[size_class];
+			pool->free[size_class] = node->free;
+			pool->cached[size_class]--;
+			return node;
+		}
+	}
+
+	//allocate the node and all arrays in one block, values first to keep them aligned
+	node = calloc(1, sizeof(shard_node) + size * event_size);
+	if(!node){
+		LOG("Failed to allocate memory");
+		return NULL;
+	}
+
+	node->owner = current_shard;
+	node->size_class = size_class;
+	node->batch.value = (channel_value*) (node + 1);
+	#ifdef MM_LATENCY
+	node->batch.ingress = (uint64_t*) (node->batch.value + size);
+	node->batch.channel = (channel**) (node->batch.ingress + size);
+	node->batch.origin = (instance**) (node->batch.channel + size);
+	#else
+	node->batch.channel = (channel**) (node->batch.value + size);
+	#endif
+	return node;
+}
+
+static void shard_wake(size_t shard){
+	uint64_t count = 1;
+	if(write(shards.inbox[shard].wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN){
+		LOGPF("Failed to wake up shard %" PRIsize_t ": %s", shard, strerror(errno));
+	}
+}
+
+static void* shard_thread(void* arg){
+	current_shard = (size_t) arg;
+	return shards.worker(arg);
+}
+#endif
+
+size_t shard_current(){
+	#ifdef MM_SHARDS
+	return current_shard;
+	#else
+	return 0;
+	#endif
+}
+
+size_t shards_count(){
+	#ifdef MM_SHARDS
+	return shards.n;
+	#else
+	return 1;
+	#endif
+}
+
+int shards_configure(size_t threads){
+	if(threads < 1 || threads > MM_SHARDS_MAX){
+		LOGPF("Thread count must be between 1 and %d", MM_SHARDS_MAX);
+		return 1;
+	}
+
+	#ifdef MM_SHARDS
+	shards.n = threads;
+	return 0;
+	#else
+	if(threads > 1){
+		LOG("Multi-threaded operation is not supported on this platform");
+		return 1;
+	}
+	return 0;
+	#endif
+}
+
+int shards_start(void* (*worker)(void*)){
+	#ifdef MM_SHARDS
+	size_t u;
+	sigset_t signals, previous;
+
+	if(shards.n < 2){
+		return 0;
+	}
+
+	for(u = 0; u < shards.n; u++){
+		shard_queue_init(shards.inbox + u);
+		shard_queue_init(&shards.pool[u].returned);
+		shards.inbox[u].wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(shards.inbox[u].wakeup < 0){
+			LOGPF("Failed to create wakeup descriptor for shard %" PRIsize_t ": %s", u, strerror(errno));
+			return 1;
+		}
+	}
+
+	atomic_store(&shards.running, 1);
+	shards.worker = worker;
+	shards.started = 0;
+	shards.threads = shards.n;
+
+	//signals are handled by the frontend thread only, workers inherit the blocked mask
+	sigfillset(&signals);
+	pthread_sigmask(SIG_BLOCK, &signals, &previous);
+	for(u = 1; u < shards.n; u++){
+		if(pthread_create(shards.thread + u, NULL, shard_thread, (void*) u)){
+			LOGPF("Failed to start worker thread for shard %" PRIsize_t, u);
+			pthread_sigmask(SIG_SETMASK, &previous, NULL);
+			//only wait for the threads that were actually created
+			pthread_mutex_lock(&shards.lock);
+			shards.threads = u;
+			pthread_cond_broadcast(&shards.change);
+			pthread_mutex_unlock(&shards.lock);
+			atomic_store(&shards.failed, 1);
+			return 1;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	LOGPF("Started %" PRIsize_t " worker threads", shards.n - 1);
+	#endif
+	return 0;
+}
+
+int shards_started(int status){
+	#ifdef MM_SHARDS
+	if(status){
+		shards_fail();
+	}
+
+	//wait for all shards to finish starting their backends
+	if(shards.n > 1){
+		pthread_mutex_lock(&shards.lock);
+		shards.started++;
+		pthread_cond_broadcast(&shards.change);
+		while(shards.started < shards.threads){
+			pthread_cond_wait(&shards.change, &shards.lock);
+		}
+		pthread_mutex_unlock(&shards.lock);
+	}
+	#endif
+	return shards_failed();
+}
+
+int shards_running(){
+	#ifdef MM_SHARDS
+	return atomic_load_explicit(&shards.running, memory_order_relaxed);
+	#else
+	return 0;
+	#endif
+}
+
+void shards_fail(){
+	#ifdef MM_SHARDS
+	atomic_store(&shards.failed, 1);
+	if(shards.inbox[0].tail){
+		shard_wake(0);
+	}
+	#endif
+}
+
+int shards_failed(){
+	#ifdef MM_SHARDS
+	return atomic_load_explicit(&shards.failed, memory_order_relaxed);
+	#else
+	return 0;
+	#endif
+}
+
+void shards_stop(){
+	#ifdef MM_SHARDS
+	size_t u;
+	shard_node* node = NULL;
+
+	if(atomic_exchange(&shards.running, 0)){
+		for(u = 1; u < shards.threads; u++){
+			shard_wake(u);
+		}
+
+		for(u = 1; u < shards.threads; u++){
+			pthread_join(shards.thread[u], NULL);
+		}
+	}
+
+	//release undelivered events
+	for(u = 0; u < shards.n; u++){
+		if(shards.inbox[u].tail){
+			if(shards.inbox[u].pending){
+				shard_enqueue(&shards.pool[shards.inbox[u].pending->owner].returned, shards.inbox[u].pending);
+				shards.inbox[u].pending = NULL;
+			}
+
+			for(node = shard_dequeue(shards.inbox + u); node; node = shard_dequeue(shards.inbox + u)){
+				free(node);
+			}
+
+			close(shards.inbox[u].wakeup);
+			shards.inbox[u].wakeup = -1;
+			shards.inbox[u].tail = NULL;
+		}
+	}
+
+	//all nodes have been returned to their owners once the inboxes are empty
+	for(u = 0; u < shards.n; u++){
+		if(shards.pool[u].returned.tail){
+			shard_pool_free(shards.pool + u);
+		}
+	}
+
+	atomic_store(&shards.failed, 0);
+	shards.n = 1;
+	#endif
+}
+
+int shard_wakeup_fd(){
+	#ifdef MM_SHARDS
+	if(shards.inbox[current_shard].tail){
+		return shards.inbox[current_shard].wakeup;
+	}
+	#endif
+	return -1;
+}
+
+void shard_wakeup_ack(){
+	#ifdef MM_SHARDS
+	uint64_t count;
+	if(read(shards.inbox[current_shard].wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN){
+		LOGPF("Failed to acknowledge shard wakeup: %s", strerror(errno));
+	}
+	#endif
+}
+
+int shard_push(size_t shard, shard_batch* batch){
+	#ifdef MM_SHARDS
+	size_t n = batch->n;
+	shard_node* node = shard_node_get(n);
+
+	if(!node){
+		return 1;
+	}
+
+	node->batch.n = n;
+	memcpy(node->batch.value, batch->value, n * sizeof(channel_value));
+	memcpy(node->batch.channel, batch->channel, n * sizeof(channel*));
+	#ifdef MM_LATENCY
+	memcpy(node->batch.ingress, batch->ingress, n * sizeof(uint64_t));
+	memcpy(node->batch.origin, batch->origin, n * sizeof(instance*));
+	#endif
+
+	shard_enqueue(shards.inbox + shard, node);
+	shard_wake(shard);
+	#endif
+	return 0;
+}
+
+shard_batch* shard_pop(){
+	#ifdef MM_SHARDS
+	shard_inbox* inbox = shards.inbox + current_shard;
+	shard_node* node = NULL;
+
+	if(!inbox->tail){
+		return NULL;
+	}
+
+	//the previously handed out batch is returned to its owner on the next call
+	if(inbox->pending){
+		shard_enqueue(&shards.pool[inbox->pending->owner].returned, inbox->pending);
+		inbox->pending = NULL;
+	}
+
+	node = shard_dequeue(inbox);
+	if(node){
+		inbox->pending = node;
+		return &node->batch;
+	}
+	#endif
+	return NULL;
+}
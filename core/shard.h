@@ -0,0 +1,49 @@
+//worker threads are only supported together with the epoll multiplexer
+#if defined(__linux__) && !defined(MM_SELECT)
+	#define MM_SHARDS
+	//state that exists once per shard (i.e. per thread running core_iteration)
+	#define SHARD_LOCAL _Thread_local
+#else
+	#define SHARD_LOCAL
+#endif
+
+//upper limit for the `threads` core option
+#define MM_SHARDS_MAX 64
+//shard sets are stored as bit masks
+#define SHARD_BIT(shard) (1ULL << (shard))
+
+//capacity of the smallest batch node in events, each further size class doubles it
+#define SHARD_NODE_MIN 64
+#define SHARD_NODE_CLASSES 12
+//maximum number of spent nodes cached per size class and shard
+#define SHARD_POOL_DEPTH 32
+
+/*
+ * Batch of resolved channel events handed from one shard to another.
+ * Copied into a node owned by the producing shard, which is handed back
+ * to it for reuse once the consuming shard has processed the batch.
+ */
+typedef struct /*_shard_batch*/ {
+	size_t n;
+	channel** channel;
+	channel_value* value;
+	#ifdef MM_LATENCY
+	uint64_t* ingress;
+	instance** origin;
+	#endif
+} shard_batch;
+
+/* Internal API */
+size_t shard_current();
+size_t shards_count();
+int shards_configure(size_t threads);
+int shards_start(void* (*worker)(void*));
+int shards_started(int status);
+int shards_running();
+void shards_fail();
+int shards_failed();
+void shards_stop();
+int shard_wakeup_fd();
+void shard_wakeup_ack();
+int shard_push(size_t shard, shard_batch* batch);
+shard_batch* shard_pop();
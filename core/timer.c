@@ -0,0 +1,286 @@
+#include <string.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/tm"
+#include "midimonster.h"
+#include "timer.h"
+#include "core.h"
+#include "shard.h"
+
+/* Core-internal structures */
+typedef struct /*_mm_timer*/ {
+	uint64_t due;
+	instance* inst;
+	mmbackend_timer callback;
+	//position in the pending heap + 1, 0 if not pending
+	size_t position;
+	//set while an expired timer waits for its dispatch
+	uint8_t dispatch;
+} mm_timer;
+
+/*
+ * Timers are identified by their (instance, callback) pair. Each pair is registered
+ * once and keeps its registry entry, with an open-addressing index (kept at most half full)
+ * for the lookup and its heap position tracked in the entry, so moving or cancelling
+ * a timer is a single sift instead of a scan.
+ * Timers are dispatched by the shard they were registered on.
+ */
+static SHARD_LOCAL struct {
+	//registered timers, entries keep their index once created
+	size_t n;
+	size_t alloc;
+	mm_timer* timer;
+	//index table size (always a power of two), slots store the registry index + 1
+	size_t size;
+	size_t* slot;
+	//pending timers by registry index, ordered as a binary min-heap on the deadline
+	size_t pending;
+	size_t* heap;
+	//timers currently being dispatched, removed from the heap before calling back
+	size_t expired;
+	size_t* dispatch;
+} timers = {
+	0
+};
+
+static size_t timer_hash(instance* inst, mmbackend_timer callback){
+	//64bit finalizer mix of the instance and callback addresses
+	uint64_t repr = ((uint64_t) (uintptr_t) inst) ^ (((uint64_t) (uintptr_t) callback) * 0x9E3779B97F4A7C15ULL);
+	repr ^= repr >> 33;
+	repr *= 0xFF51AFD7ED558CCDULL;
+	repr ^= repr >> 33;
+	return repr & (timers.size - 1);
+}
+
+//returns the slot containing the timer, or the empty slot terminating its probe sequence
+static size_t timer_slot(instance* inst, mmbackend_timer callback){
+	size_t slot = timer_hash(inst, callback);
+
+	for(; timers.slot[slot]; slot = (slot + 1) & (timers.size - 1)){
+		if(timers.timer[timers.slot[slot] - 1].inst == inst
+				&& timers.timer[timers.slot[slot] - 1].callback == callback){
+			break;
+		}
+	}
+	return slot;
+}
+
+static int timer_resize(size_t size){
+	size_t u;
+	size_t* previous = timers.slot;
+
+	timers.slot = calloc(size, sizeof(size_t));
+	if(!timers.slot){
+		LOG("Failed to allocate memory");
+		timers.slot = previous;
+		return 1;
+	}
+	free(previous);
+	timers.size = size;
+
+	for(u = 0; u < timers.n; u++){
+		timers.slot[timer_slot(timers.timer[u].inst, timers.timer[u].callback)] = u + 1;
+	}
+	return 0;
+}
+
+//the heap and the dispatch list can hold every registered timer at once
+static int timer_grow(){
+	size_t alloc = timers.alloc ? timers.alloc * 2 : 8;
+	mm_timer* timer = NULL;
+	size_t* heap = NULL, *dispatch = NULL;
+
+	timer = realloc(timers.timer, alloc * sizeof(mm_timer));
+	if(timer){
+		timers.timer = timer;
+		heap = realloc(timers.heap, alloc * sizeof(size_t));
+	}
+	if(heap){
+		timers.heap = heap;
+		dispatch = realloc(timers.dispatch, alloc * sizeof(size_t));
+	}
+	if(!dispatch){
+		LOG("Failed to allocate memory");
+		return 1;
+	}
+	timers.dispatch = dispatch;
+	timers.alloc = alloc;
+	return 0;
+}
+
+//look up the registry index of a timer, registering it if requested. Returns timers.n if not found
+static size_t timer_index(instance* inst, mmbackend_timer callback, uint8_t create){
+	size_t slot;
+
+	if(timers.size){
+		slot = timer_slot(inst, callback);
+		if(timers.slot[slot]){
+			return timers.slot[slot] - 1;
+		}
+	}
+
+	if(!create){
+		return timers.n;
+	}
+
+	if((timers.n + 1) * 2 > timers.size && timer_resize(timers.size ? timers.size * 2 : 16)){
+		return timers.n;
+	}
+
+	if(timers.n >= timers.alloc && timer_grow()){
+		return timers.n;
+	}
+
+	timers.timer[timers.n] = (mm_timer) {
+		.inst = inst,
+		.callback = callback
+	};
+	timers.slot[timer_slot(inst, callback)] = timers.n + 1;
+	return timers.n++;
+}
+
+static void timer_swap(size_t a, size_t b){
+	size_t xchg = timers.heap[a];
+	timers.heap[a] = timers.heap[b];
+	timers.heap[b] = xchg;
+	timers.timer[timers.heap[a]].position = a + 1;
+	timers.timer[timers.heap[b]].position = b + 1;
+}
+
+static uint64_t timer_due(size_t u){
+	return timers.timer[timers.heap[u]].due;
+}
+
+static void timer_sift_up(size_t u){
+	for(; u && timer_due(u) < timer_due((u - 1) / 2); u = (u - 1) / 2){
+		timer_swap(u, (u - 1) / 2);
+	}
+}
+
+static void timer_sift_down(size_t u){
+	size_t child;
+
+	for(child = 2 * u + 1; child < timers.pending; child = 2 * u + 1){
+		if(child + 1 < timers.pending && timer_due(child + 1) < timer_due(child)){
+			child++;
+		}
+
+		if(timer_due(u) <= timer_due(child)){
+			break;
+		}
+
+		timer_swap(u, child);
+		u = child;
+	}
+}
+
+static void timer_remove(size_t u){
+	timers.timer[timers.heap[u]].position = 0;
+	timers.pending--;
+	if(u == timers.pending){
+		return;
+	}
+
+	timers.heap[u] = timers.heap[timers.pending];
+	timers.timer[timers.heap[u]].position = u + 1;
+	timer_sift_down(u);
+	timer_sift_up(u);
+}
+
+MM_API int mm_timer_add(instance* inst, uint64_t due, mmbackend_timer callback){
+	size_t u;
+	mm_timer* timer = NULL;
+
+	if(!callback){
+		LOG("Timer registered without callback");
+		return 1;
+	}
+
+	//cancelling a timer that was never registered does not need an entry
+	u = timer_index(inst, callback, due ? 1 : 0);
+	if(u == timers.n){
+		return due ? 1 : 0;
+	}
+	timer = timers.timer + u;
+
+	//a new deadline supersedes a dispatch that has not happened yet
+	timer->dispatch = 0;
+
+	//move or cancel the timer if it is already pending
+	if(timer->position){
+		if(!due){
+			timer_remove(timer->position - 1);
+			return 0;
+		}
+
+		timer->due = due;
+		u = timer->position - 1;
+		timer_sift_down(u);
+		timer_sift_up(u);
+		return 0;
+	}
+
+	if(!due){
+		return 0;
+	}
+
+	timer->due = due;
+	timers.heap[timers.pending] = u;
+	timer->position = ++timers.pending;
+	timer_sift_up(timers.pending - 1);
+	return 0;
+}
+
+uint64_t timers_next(){
+	return timers.pending ? timer_due(0) : 0;
+}
+
+int timers_process(){
+	size_t u;
+	mm_timer* timer = NULL;
+	int rv = 0;
+	uint64_t now = mm_timestamp();
+
+	//collect all expired timers first, callbacks re-adding themselves are dispatched in the next iteration
+	for(timers.expired = 0; timers.pending && timer_due(0) <= now; timers.expired++){
+		timers.dispatch[timers.expired] = timers.heap[0];
+		timers.timer[timers.heap[0]].dispatch = 1;
+		timer_remove(0);
+	}
+
+	//callbacks may register new timers, which can move the registry
+	for(u = 0; u < timers.expired && !rv; u++){
+		timer = timers.timer + timers.dispatch[u];
+		if(timer->dispatch){
+			timer->dispatch = 0;
+			DBGPF("Dispatching timer for %s, %" PRIu64 " msec late", timer->inst ? timer->inst->name : "backend", now - timer->due);
+			rv |= timer->callback(timer->inst);
+			if(rv){
+				timer = timers.timer + timers.dispatch[u];
+				LOGPF("Timer callback for %s failed", timer->inst ? timer->inst->name : "backend");
+			}
+		}
+	}
+
+	//dispatches skipped after a failure are dropped
+	for(u = 0; u < timers.expired; u++){
+		timers.timer[timers.dispatch[u]].dispatch = 0;
+	}
+	timers.expired = 0;
+	return rv;
+}
+
+void timers_cleanup(){
+	free(timers.timer);
+	free(timers.slot);
+	free(timers.heap);
+	free(timers.dispatch);
+	timers.timer = NULL;
+	timers.slot = timers.heap = timers.dispatch = NULL;
+	timers.n = timers.alloc = timers.size = 0;
+	timers.pending = timers.expired = 0;
+}
@@ -0,0 +1,7 @@
+/* Internal API */
+uint64_t timers_next();
+int timers_process();
+void timers_cleanup();
+
+/* Public backend API */
+MM_API int mm_timer_add(instance* inst, uint64_t due, mmbackend_timer callback);
@@ -0,0 +1,390 @@
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#ifndef _WIN32
+	#define MM_API __attribute__((visibility ("default")))
+#else
+	#define MM_API __attribute__((dllexport))
+#endif
+
+#define BACKEND_NAME "core/tf"
+#include "midimonster.h"
+#include "transform.h"
+
+static struct {
+	char* name;
+	transform_type type;
+	//accepted parameter counts
+	size_t min;
+	size_t max;
+} transform_operators[] = {
+	{"range", transform_range, 2, 4},
+	{"invert", transform_invert, 0, 0},
+	{"gamma", transform_gamma, 1, 1},
+	{"lut", transform_lut, 2, 256},
+	{"threshold", transform_threshold, 1, 1},
+	{"deadband", transform_deadband, 1, 1}
+};
+
+static struct {
+	char* name;
+	uint8_t attribute;
+} transform_attributes[] = {
+	{"coalesce", transform_coalesce},
+	{"changed", transform_changed}
+};
+
+static int transform_append(transform_chain* chain, transform_op* op){
+	chain->op = realloc(chain->op, (chain->n + 1) * sizeof(transform_op));
+	if(!chain->op){
+		LOG("Failed to allocate memory");
+		chain->n = 0;
+		return 1;
+	}
+
+	chain->op[chain->n] = *op;
+	chain->n++;
+	return 0;
+}
+
+static int transform_parse_op(transform_chain* chain, char* spec){
+	size_t u, params = 0;
+	char* token = spec, *next = NULL;
+	double param[256];
+	transform_op op = {
+		.last = -1.0
+	};
+
+	//find the operator name
+	for(; isspace(*token); token++){
+	}
+	for(next = token; *next && !isspace(*next); next++){
+	}
+
+	//delivery attributes take no parameters and are not part of the operator chain
+	for(u = 0; u < sizeof(transform_attributes) / sizeof(transform_attributes[0]); u++){
+		if(strlen(transform_attributes[u].name) == next - token
+				&& !strncmp(transform_attributes[u].name, token, next - token)){
+			for(; isspace(*next); next++){
+			}
+			if(*next){
+				LOGPF("Attribute %s does not take parameters", transform_attributes[u].name);
+				return 1;
+			}
+			chain->attributes |= transform_attributes[u].attribute;
+			return 0;
+		}
+	}
+
+	for(u = 0; u < sizeof(transform_operators) / sizeof(transform_operators[0]); u++){
+		if(strlen(transform_operators[u].name) == next - token
+				&& !strncmp(transform_operators[u].name, token, next - token)){
+			break;
+		}
+	}
+
+	if(u == sizeof(transform_operators) / sizeof(transform_operators[0])){
+		LOGPF("Unknown transform %.*s", (int) (next - token), token);
+		return 1;
+	}
+	op.type = transform_operators[u].type;
+
+	//read numeric parameters
+	for(token = next; ; params++){
+		for(; isspace(*token); token++){
+		}
+		if(!*token){
+			break;
+		}
+
+		if(params == sizeof(param) / sizeof(param[0])){
+			LOGPF("Too many parameters for transform %s, at most %" PRIsize_t " are supported",
+					transform_operators[u].name, sizeof(param) / sizeof(param[0]));
+			return 1;
+		}
+
+		param[params] = strtod(token, &next);
+		if(next == token){
+			LOGPF("Invalid parameter %s for transform %s", token, transform_operators[u].name);
+			return 1;
+		}
+		token = next;
+	}
+
+	if(params < transform_operators[u].min || params > transform_operators[u].max
+			|| (op.type == transform_range && params == 3)){
+		LOGPF("Invalid number of parameters for transform %s", transform_operators[u].name);
+		return 1;
+	}
+
+	switch(op.type){
+		case transform_range:
+			//the short form maps the full input range
+			if(params == 2){
+				op.param[0] = 0.0;
+				op.param[1] = 1.0;
+				op.param[2] = param[0];
+				op.param[3] = param[1];
+			}
+			else{
+				memcpy(op.param, param, 4 * sizeof(double));
+			}
+
+			if(op.param[0] == op.param[1]){
+				LOG("Transform range requires a non-empty input range");
+				return 1;
+			}
+			break;
+		case transform_gamma:
+			if(param[0] <= 0.0){
+				LOG("Transform gamma requires a positive exponent");
+				return 1;
+			}
+			op.param[0] = param[0];
+			break;
+		case transform_lut:
+			op.points = params;
+			op.table = calloc(params, sizeof(double));
+			if(!op.table){
+				LOG("Failed to allocate memory");
+				return 1;
+			}
+			memcpy(op.table, param, params * sizeof(double));
+			break;
+		case transform_threshold:
+		case transform_deadband:
+			op.param[0] = param[0];
+			break;
+		case transform_invert:
+			break;
+	}
+
+	if(transform_append(chain, &op)){
+		free(op.table);
+		return 1;
+	}
+	return 0;
+}
+
+transform_chain* transform_parse(char* spec){
+	char* op = spec, *next = NULL;
+	transform_chain* chain = calloc(1, sizeof(transform_chain));
+
+	if(!chain){
+		LOG("Failed to allocate memory");
+		return NULL;
+	}
+
+	//operators are separated by pipes and applied in order
+	for(; op; op = next){
+		next = strchr(op, '|');
+		if(next){
+			*next = 0;
+			next++;
+		}
+
+		if(transform_parse_op(chain, op)){
+			transform_free(chain);
+			return NULL;
+		}
+
+		//restore the specification for later edges
+		if(next){
+			next[-1] = '|';
+		}
+	}
+	return chain;
+}
+
+transform_chain* transform_clone(transform_chain* chain){
+	size_t u;
+	transform_chain* clone = calloc(1, sizeof(transform_chain));
+
+	if(!clone || (chain->n && !(clone->op = calloc(chain->n, sizeof(transform_op))))){
+		LOG("Failed to allocate memory");
+		free(clone);
+		return NULL;
+	}
+
+	memcpy(clone->op, chain->op, chain->n * sizeof(transform_op));
+	clone->n = chain->n;
+	clone->attributes = chain->attributes;
+	for(u = 0; u < clone->n; u++){
+		clone->op[u].last = -1.0;
+		if(chain->op[u].table){
+			clone->op[u].table = calloc(chain->op[u].points, sizeof(double));
+			if(!clone->op[u].table){
+				LOG("Failed to allocate memory");
+				clone->n = u;
+				transform_free(clone);
+				return NULL;
+			}
+			memcpy(clone->op[u].table, chain->op[u].table, chain->op[u].points * sizeof(double));
+		}
+	}
+	return clone;
+}
+
+int transform_equal(transform_chain* a, transform_chain* b){
+	size_t u;
+
+	if(!a || !b){
+		return a == b;
+	}
+
+	if(a->n != b->n || a->attributes != b->attributes){
+		return 0;
+	}
+
+	for(u = 0; u < a->n; u++){
+		if(a->op[u].type != b->op[u].type
+				|| memcmp(a->op[u].param, b->op[u].param, sizeof(a->op[u].param))
+				|| a->op[u].points != b->op[u].points
+				|| (a->op[u].points && memcmp(a->op[u].table, b->op[u].table, a->op[u].points * sizeof(double)))){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//writes the chain to data if it is not NULL, returns the length of the serialized chain
+size_t transform_serialize(transform_chain* chain, uint8_t* data){
+	size_t u, length = TRANSFORM_CHAIN_HEADER;
+	uint32_t count = chain->n, points;
+
+	if(data){
+		memcpy(data, &count, sizeof(count));
+		data[sizeof(count)] = chain->attributes;
+	}
+
+	for(u = 0; u < chain->n; u++){
+		points = chain->op[u].points;
+		if(data){
+			data[length] = chain->op[u].type;
+			memcpy(data + length + 1, chain->op[u].param, sizeof(chain->op[u].param));
+			memcpy(data + length + 1 + sizeof(chain->op[u].param), &points, sizeof(points));
+			memcpy(data + length + TRANSFORM_OP_HEADER, chain->op[u].table, points * sizeof(double));
+		}
+		length += TRANSFORM_OP_HEADER + points * sizeof(double);
+	}
+	return length;
+}
+
+transform_chain* transform_deserialize(uint8_t* data, size_t length, size_t* consumed){
+	size_t offset = TRANSFORM_CHAIN_HEADER;
+	uint32_t count, points;
+	transform_chain* chain = NULL;
+	transform_op op = {
+		.last = -1.0
+	};
+
+	if(length < TRANSFORM_CHAIN_HEADER){
+		LOG("Serialized transform chain is truncated");
+		return NULL;
+	}
+
+	chain = calloc(1, sizeof(transform_chain));
+	if(!chain){
+		LOG("Failed to allocate memory");
+		return NULL;
+	}
+
+	memcpy(&count, data, sizeof(count));
+	chain->attributes = data[sizeof(count)];
+	for(; chain->n < count; offset += TRANSFORM_OP_HEADER + points * sizeof(double)){
+		if(offset + TRANSFORM_OP_HEADER > length){
+			LOG("Serialized transform chain is truncated");
+			goto bail;
+		}
+
+		op.type = data[offset];
+		memcpy(op.param, data + offset + 1, sizeof(op.param));
+		memcpy(&points, data + offset + 1 + sizeof(op.param), sizeof(points));
+		//the interpolation requires at least two points
+		if(op.type > transform_deadband
+				|| (op.type == transform_lut && points < 2)
+				|| (op.type != transform_lut && points)
+				|| (length - offset - TRANSFORM_OP_HEADER) / sizeof(double) < points){
+			LOG("Invalid serialized transform chain");
+			goto bail;
+		}
+
+		op.points = points;
+		op.table = NULL;
+		if(points){
+			op.table = calloc(points, sizeof(double));
+			if(!op.table){
+				LOG("Failed to allocate memory");
+				goto bail;
+			}
+			memcpy(op.table, data + offset + TRANSFORM_OP_HEADER, points * sizeof(double));
+		}
+
+		if(transform_append(chain, &op)){
+			free(op.table);
+			goto bail;
+		}
+	}
+
+	*consumed = offset;
+	return chain;
+
+bail:
+	transform_free(chain);
+	return NULL;
+}
+
+int transform_apply(transform_chain* chain, channel_value* value){
+	size_t u, point;
+	double v = value->normalised, position;
+	transform_op* op = NULL;
+
+	for(u = 0; u < chain->n; u++){
+		op = chain->op + u;
+		switch(op->type){
+			case transform_range:
+				v = (v - op->param[0]) / (op->param[1] - op->param[0]);
+				v = op->param[2] + clamp(v, 1.0, 0.0) * (op->param[3] - op->param[2]);
+				break;
+			case transform_invert:
+				v = 1.0 - v;
+				break;
+			case transform_gamma:
+				v = pow(clamp(v, 1.0, 0.0), op->param[0]);
+				break;
+			case transform_lut:
+				//linear interpolation between evenly spaced points
+				position = clamp(v, 1.0, 0.0) * (op->points - 1);
+				point = min((size_t) position, op->points - 2);
+				v = op->table[point] + (position - point) * (op->table[point + 1] - op->table[point]);
+				break;
+			case transform_threshold:
+				v = (v >= op->param[0]) ? 1.0 : 0.0;
+				break;
+			case transform_deadband:
+				//suppress changes smaller than the band around the last value passed
+				if(op->last >= 0.0 && fabs(v - op->last) < op->param[0]){
+					return 1;
+				}
+				op->last = v;
+				break;
+		}
+	}
+
+	value->normalised = clamp(v, 1.0, 0.0);
+	return 0;
+}
+
+void transform_free(transform_chain* chain){
+	size_t u;
+
+	if(!chain){
+		return;
+	}
+
+	for(u = 0; u < chain->n; u++){
+		free(chain->op[u].table);
+	}
+	free(chain->op);
+	free(chain);
+}
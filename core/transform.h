@@ -0,0 +1,58 @@
+/*
+ * Value transforms applied to the normalised value of an event on a single
+ * mapping edge, specified as `| <operator> [<parameters>]` after a mapping.
+ * Every edge owns its chain, as some operators keep state.
+ * Chains may additionally carry delivery attributes, which apply to the
+ * destination channel of the edge and are evaluated by the routing core.
+ */
+typedef enum {
+	transform_range,
+	transform_invert,
+	transform_gamma,
+	transform_lut,
+	transform_threshold,
+	transform_deadband
+} transform_type;
+
+typedef struct /*_mm_transform_op*/ {
+	transform_type type;
+	double param[4];
+	//lookup table points for transform_lut
+	size_t points;
+	double* table;
+	//last value passed by transform_deadband, negative if none yet
+	double last;
+} transform_op;
+
+//delivery attributes, applied per destination channel
+enum /*_mm_transform_attribute*/ {
+	//deliver only the last event per destination channel and batch
+	transform_coalesce = 1,
+	//drop events repeating the value last delivered to the destination channel
+	transform_changed = 2
+};
+
+typedef struct _mm_transform_chain {
+	size_t n;
+	transform_op* op;
+	uint8_t attributes;
+} transform_chain;
+
+/*
+ * Serialized chain format, as stored in compiled configurations: the operator
+ * count (32 bit) and the attributes (8 bit), followed by the operators.
+ * Every operator is stored as its type (8 bit), its parameters and the number
+ * of lookup table points (32 bit), followed by the table. All values are
+ * stored in host byte order.
+ */
+#define TRANSFORM_CHAIN_HEADER (sizeof(uint32_t) + 1)
+#define TRANSFORM_OP_HEADER (1 + 4 * sizeof(double) + sizeof(uint32_t))
+
+/* Internal API */
+transform_chain* transform_parse(char* spec);
+transform_chain* transform_clone(transform_chain* chain);
+int transform_equal(transform_chain* a, transform_chain* b);
+size_t transform_serialize(transform_chain* chain, uint8_t* data);
+transform_chain* transform_deserialize(uint8_t* data, size_t length, size_t* consumed);
+int transform_apply(transform_chain* chain, channel_value* value);
+void transform_free(transform_chain* chain);
@@ -1,6 +1,12 @@
 #include <string.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <time.h>
+#include <stdatomic.h>
+#ifdef __linux__
+	#include <pthread.h>
+	#include <semaphore.h>
+#endif
 #ifndef _WIN32
 	#define MM_API __attribute__((visibility("default")))
 #else
@@ -13,18 +19,296 @@
 #include "core/config.h"
 
 volatile static sig_atomic_t shutdown_requested = 0;
+volatile static sig_atomic_t report_requested = 0;
+volatile static sig_atomic_t reload_requested = 0;
+
+/*
+ * Messages logged while the core is processing events (i.e. from within receive and
+ * transmit paths) are rate-limited per call site, identified by the format string.
+ * Startup, shutdown and messages flagged as reports are never limited. The number
+ * of suppressed messages per site is reported once per second and on shutdown.
+ * On Linux, messages are formatted into a bounded ring and written to stderr by a
+ * separate thread, so a slow log consumer can not stall the event processing.
+ * Messages not fitting into the ring are dropped and counted.
+ */
+#define LOG_SITES 256
+#define LOG_SITE_LIMIT 20
+#ifdef __linux__
+	#define MM_ASYNC_LOG
+	#define LOG_RING_SLOTS 1024
+	#define LOG_MESSAGE_LENGTH 512
+#endif
+
+typedef struct /*_log_site*/ {
+	_Atomic(char*) format;
+	_Atomic(char*) module;
+	atomic_uint_fast64_t window;
+	atomic_uint_fast32_t count;
+	atomic_uint_fast32_t suppressed;
+} log_site;
+
+#ifdef MM_ASYNC_LOG
+typedef struct /*_log_slot*/ {
+	atomic_size_t sequence;
+	size_t length;
+	char message[LOG_MESSAGE_LENGTH];
+} log_slot;
+#endif
+
+static struct {
+	log_site site[LOG_SITES];
+	//time of the last suppression report, in seconds
+	uint64_t flushed;
+	atomic_uint_fast64_t suppressed;
+	atomic_uint_fast64_t dropped;
+	#ifdef MM_ASYNC_LOG
+	//multi-producer ring, messages are consumed in order by the log thread
+	log_slot slot[LOG_RING_SLOTS];
+	atomic_size_t head;
+	size_t tail;
+	sem_t pending;
+	pthread_t thread;
+	atomic_int running;
+	#endif
+} logger = {
+	.suppressed = 0,
+	.dropped = 0
+};
+
+//returns 1 if the message is to be suppressed
+static int log_limit(int level, char* module, char* fmt){
+	size_t u, slot = ((uintptr_t) fmt >> 3) % LOG_SITES;
+	uint64_t now, window;
+	char* expected = NULL;
+	log_site* site = NULL;
+
+	if((level & MM_LOG_REPORT) || !core_processing()){
+		return 0;
+	}
+
+	//find or claim the site, messages from sites not fitting into the table are not limited
+	for(u = 0; u < LOG_SITES && !site; u++, slot = (slot + 1) % LOG_SITES){
+		expected = NULL;
+		if(atomic_load(&logger.site[slot].format) == fmt
+				|| atomic_compare_exchange_strong(&logger.site[slot].format, &expected, fmt)
+				|| expected == fmt){
+			site = logger.site + slot;
+			atomic_store(&site->module, module);
+		}
+	}
+	if(!site){
+		return 0;
+	}
+
+	//fixed one-second windows, concurrent resets may let a few additional messages pass
+	now = time(NULL);
+	window = atomic_load(&site->window);
+	if(window != now && atomic_compare_exchange_strong(&site->window, &window, now)){
+		atomic_store(&site->count, 0);
+	}
+
+	if(atomic_fetch_add(&site->count, 1) >= LOG_SITE_LIMIT){
+		atomic_fetch_add(&site->suppressed, 1);
+		atomic_fetch_add(&logger.suppressed, 1);
+		return 1;
+	}
+	return 0;
+}
+
+//report suppressed messages for all sites whose window has passed, or all sites if requested
+static void log_flush(uint8_t all){
+	size_t u, length;
+	uint64_t now = time(NULL), suppressed;
+	char* format = NULL, *module = NULL;
+
+	if(!all && now == logger.flushed){
+		return;
+	}
+	logger.flushed = now;
+
+	for(u = 0; u < LOG_SITES; u++){
+		format = atomic_load(&logger.site[u].format);
+		module = atomic_load(&logger.site[u].module);
+		if(!format || !module || !atomic_load(&logger.site[u].suppressed)
+				|| (!all && atomic_load(&logger.site[u].window) == now)){
+			continue;
+		}
+
+		suppressed = atomic_exchange(&logger.site[u].suppressed, 0);
+		length = strlen(format);
+		//messages end with a newline, which is not included in the report
+		if(length && format[length - 1] == '\n'){
+			length--;
+		}
+		fprintf(stderr, "%s\t(%" PRIu64 " messages suppressed like \"%.*s\")\n", module, suppressed, (int) length, format);
+	}
+}
+
+static size_t log_format(char* buffer, size_t length, int level, char* module, char* fmt, va_list args){
+	int prefix, message;
+
+	prefix = snprintf(buffer, length, "%s%s\t", (level & MM_LOG_DEBUG) ? "debug/" : "", module);
+	message = vsnprintf(buffer + prefix, length - prefix, fmt, args);
+	if(message < 0){
+		message = 0;
+	}
+
+	//truncated messages still end with a newline
+	if(prefix + message >= length){
+		buffer[length - 2] = '\n';
+		message = length - 1 - prefix;
+	}
+	return prefix + message;
+}
+
+#ifdef MM_ASYNC_LOG
+static int log_push(int level, char* module, char* fmt, va_list args){
+	size_t position = atomic_load(&logger.head);
+	log_slot* slot = NULL;
+	intptr_t distance;
+
+	for(;;){
+		slot = logger.slot + (position % LOG_RING_SLOTS);
+		distance = (intptr_t) atomic_load_explicit(&slot->sequence, memory_order_acquire) - (intptr_t) position;
+		if(!distance){
+			if(atomic_compare_exchange_weak(&logger.head, &position, position + 1)){
+				break;
+			}
+		}
+		else if(distance < 0){
+			//ring full, never wait for the log thread
+			atomic_fetch_add(&logger.dropped, 1);
+			return 0;
+		}
+		else{
+			position = atomic_load(&logger.head);
+		}
+	}
+
+	slot->length = log_format(slot->message, sizeof(slot->message), level, module, fmt, args);
+	atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+	sem_post(&logger.pending);
+	return slot->length;
+}
+
+static void log_drain(){
+	log_slot* slot = logger.slot + (logger.tail % LOG_RING_SLOTS);
+
+	while(atomic_load_explicit(&slot->sequence, memory_order_acquire) == logger.tail + 1){
+		fwrite(slot->message, 1, slot->length, stderr);
+		atomic_store_explicit(&slot->sequence, logger.tail + LOG_RING_SLOTS, memory_order_release);
+		logger.tail++;
+		slot = logger.slot + (logger.tail % LOG_RING_SLOTS);
+	}
+}
+
+static void* log_thread(void* arg){
+	uint64_t dropped, reported = 0;
+	struct timespec deadline;
+
+	while(atomic_load(&logger.running)){
+		//wake up at least once per second to report suppressed messages
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec++;
+		sem_timedwait(&logger.pending, &deadline);
+		log_drain();
+		log_flush(0);
+
+		//report dropped messages as soon as there is room again
+		dropped = atomic_load(&logger.dropped);
+		if(dropped != reported){
+			fprintf(stderr, "%s\t%" PRIu64 " log messages dropped, log output too slow\n", BACKEND_NAME, dropped - reported);
+			reported = dropped;
+		}
+	}
+	log_drain();
+	return NULL;
+}
+#endif
 
 MM_API int log_printf(int level, char* module, char* fmt, ...){
 	int rv = 0;
 	va_list args;
+
+	if(log_limit(level, module, fmt)){
+		return 0;
+	}
+
 	va_start(args, fmt);
-	fprintf(stderr, "%s%s\t", level ? "debug/" : "", module);
+	#ifdef MM_ASYNC_LOG
+	if(atomic_load(&logger.running)){
+		rv = log_push(level, module, fmt, args);
+		va_end(args);
+		return rv;
+	}
+	#endif
+	fprintf(stderr, "%s%s\t", (level & MM_LOG_DEBUG) ? "debug/" : "", module);
 	rv = vfprintf(stderr, fmt, args);
 	va_end(args);
+	//without a log thread, suppressed messages are reported along with other output
+	log_flush(0);
 	return rv;
 }
 
+static void log_start(){
+	#ifdef MM_ASYNC_LOG
+	size_t u;
+	sigset_t signals, previous;
+
+	for(u = 0; u < LOG_RING_SLOTS; u++){
+		atomic_init(&logger.slot[u].sequence, u);
+	}
+
+	if(sem_init(&logger.pending, 0, 0)){
+		fprintf(stderr, "Failed to initialize log queue, logging synchronously\n");
+		return;
+	}
+
+	//signals are only handled by the main thread
+	sigfillset(&signals);
+	pthread_sigmask(SIG_BLOCK, &signals, &previous);
+	atomic_store(&logger.running, 1);
+	if(pthread_create(&logger.thread, NULL, log_thread, NULL)){
+		atomic_store(&logger.running, 0);
+		sem_destroy(&logger.pending);
+		fprintf(stderr, "Failed to start log thread, logging synchronously\n");
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	#endif
+}
+
+static void log_stop(){
+	#ifdef MM_ASYNC_LOG
+	if(atomic_load(&logger.running)){
+		atomic_store(&logger.running, 0);
+		sem_post(&logger.pending);
+		pthread_join(logger.thread, NULL);
+		sem_destroy(&logger.pending);
+	}
+	#endif
+
+	log_flush(1);
+	if(atomic_load(&logger.suppressed) || atomic_load(&logger.dropped)){
+		fprintf(stderr, "%s\t%" PRIu64 " log messages suppressed by rate limiting, %" PRIu64 " dropped in total\n", BACKEND_NAME,
+				(uint64_t) atomic_load(&logger.suppressed), (uint64_t) atomic_load(&logger.dropped));
+		atomic_store(&logger.suppressed, 0);
+		atomic_store(&logger.dropped, 0);
+	}
+}
+
 static void signal_handler(int signum){
+	#ifdef SIGUSR1
+	if(signum == SIGUSR1){
+		report_requested = 1;
+		return;
+	}
+	#endif
+	#ifdef SIGHUP
+	if(signum == SIGHUP){
+		reload_requested = 1;
+		return;
+	}
+	#endif
 	shutdown_requested = 1;
 }
 
@@ -40,6 +324,8 @@ static int usage(char* fn){
 	fprintf(stderr, "\t-v,--version  - show version\n");
 	fprintf(stderr, "\t-b <backend>  - override backend options (can be used multiple times)\n");
 	fprintf(stderr, "\t-i <instance> - override instance options (can be used multiple times)\n");
+	fprintf(stderr, "\t-c <file>     - compile the configuration into <file> and exit\n");
+	fprintf(stderr, "\t-l            - only load the backend plugins used by the configuration\n");
 	fprintf(stderr, "\t-h,--help     - show this usage info\n");
 	fprintf(stderr, "\nInstance/Backend options format:\n");
 	fprintf(stderr, "<instance/backend>.<option>=<value>\n");
@@ -68,7 +354,15 @@ static int platform_shutdown(){
 	return 0;
 }
 
-static int args_parse(int argc, char** argv, char** cfg_file){
+static void free_backend_list(char** backends){
+	size_t u;
+	for(u = 0; backends && backends[u]; u++){
+		free(backends[u]);
+	}
+	free(backends);
+}
+
+static int args_parse(int argc, char** argv, char** cfg_file, char** compile_file, uint8_t* lazy){
 	size_t u;
 	for(u = 1; u < argc; u++){
 		if(!strcmp(argv[u], "-v") || !strcmp(argv[u], "--version")){
@@ -99,6 +393,17 @@ static int args_parse(int argc, char** argv, char** cfg_file){
 			}
 			u++;
 		}
+		else if(!strcmp(argv[u], "-l") || !strcmp(argv[u], "--lazy-plugins")){
+			*lazy = 1;
+		}
+		else if(!strcmp(argv[u], "-c") || !strcmp(argv[u], "--compile-config")){
+			if(!argv[u + 1]){
+				fprintf(stderr, "Missing compiled configuration output file\n");
+				return 1;
+			}
+			*compile_file = argv[u + 1];
+			u++;
+		}
 		else{
 			//if nothing else matches, it's probably the configuration file
 			*cfg_file = argv[u];
@@ -110,10 +415,11 @@ static int args_parse(int argc, char** argv, char** cfg_file){
 
 int main(int argc, char** argv){
 	int rv = EXIT_FAILURE;
-	char* cfg_file = DEFAULT_CFG;
+	char* cfg_file = DEFAULT_CFG, *compile_file = NULL, **backends = NULL;
+	uint8_t lazy = 0;
 
 	//parse commandline arguments
-	if(args_parse(argc, argv, &cfg_file)){
+	if(args_parse(argc, argv, &cfg_file, &compile_file, &lazy)){
 		return EXIT_FAILURE;
 	}
 
@@ -123,13 +429,39 @@ int main(int argc, char** argv){
 		return EXIT_FAILURE;
 	}
 
+	//find the backends used by the configuration
+	if(lazy){
+		backends = config_backends(cfg_file);
+		if(!backends){
+			fprintf(stderr, "Failed to scan configuration file %s\n", cfg_file);
+			return (usage(argv[0]) | platform_shutdown());
+		}
+	}
+
 	//initialize backends
-	if(core_initialize()){
+	log_start();
+	if(core_initialize(backends)){
+		free_backend_list(backends);
+		goto bail;
+	}
+	free_backend_list(backends);
+
+	//only compile the configuration
+	if(compile_file){
+		if(config_compile(cfg_file, compile_file)){
+			log_stop();
+			fprintf(stderr, "Failed to compile configuration file %s\n", cfg_file);
+		}
+		else{
+			rv = EXIT_SUCCESS;
+		}
 		goto bail;
 	}
 
 	//read config
 	if(config_read(cfg_file)){
+		//flush queued messages before writing to stderr directly
+		log_stop();
 		fprintf(stderr, "Failed to parse master configuration file %s\n", cfg_file);
 		core_shutdown();
 		return (usage(argv[0]) | platform_shutdown());
@@ -141,16 +473,34 @@ int main(int argc, char** argv){
 	}
 
 	signal(SIGINT, signal_handler);
+	#ifdef SIGUSR1
+	signal(SIGUSR1, signal_handler);
+	#endif
+	#ifdef SIGHUP
+	signal(SIGHUP, signal_handler);
+	#endif
 
 	//run the core loop
 	while(!shutdown_requested){
 		if(core_iteration()){
 			goto bail;
 		}
+
+		if(report_requested){
+			report_requested = 0;
+			core_report();
+		}
+
+		//a failed reload keeps the current mappings
+		if(reload_requested){
+			reload_requested = 0;
+			config_reload(cfg_file);
+		}
 	}
 
 	rv = EXIT_SUCCESS;
 bail:
 	core_shutdown();
+	log_stop();
 	return rv;
 }
@@ -40,12 +40,16 @@
 /* Clamp a value to a range */
 #define clamp(val,max,min) (((val) > (max)) ? (max) : (((val) < (min)) ? (min) : (val)))
 
-/* Log function prototype - do not use directly. Use the LOG/LOGPF/DBGPF macros below instead */
+/* Log function prototype - do not use directly. Use the LOG/LOGPF/LOGRPF/DBGPF macros below instead */
 MM_API __attribute__((format(printf, 3, 4))) int log_printf(int level, char* module, char* fmt, ...);
 
+/* Flags for the level argument of log_printf */
+#define MM_LOG_DEBUG 1
+#define MM_LOG_REPORT 2
+
 /* Debug messages only compile in when DEBUG is set */
 #ifdef DEBUG
-	#define DBGPF(format, ...) log_printf(1, (BACKEND_NAME), format "\n", __VA_ARGS__)
+	#define DBGPF(format, ...) log_printf(MM_LOG_DEBUG, (BACKEND_NAME), format "\n", __VA_ARGS__)
 #else
 	#define DBGPF(format, ...)
 #endif
@@ -54,6 +58,13 @@ MM_API __attribute__((format(printf, 3, 4))) int log_printf(int level, char* mod
 #define LOGPF(format, ...) log_printf(0, (BACKEND_NAME), format "\n", __VA_ARGS__)
 #define LOG(message) log_printf(0, (BACKEND_NAME), message "\n")
 
+/*
+ * Messages logged while processing events may be rate-limited per call site by the frontend.
+ * Reports logging multiple lines from one call site (e.g. periodic statistics) should use
+ * this macro, which is never rate-limited.
+ */
+#define LOGRPF(format, ...) log_printf(MM_LOG_REPORT, (BACKEND_NAME), format "\n", __VA_ARGS__)
+
 /* Stop compilation if the build system reports an error */
 #ifdef BUILD_ERROR
 	#error The build system reported an error, compilation stopped. Refer to the invocation for this compilation unit for more information.
@@ -108,6 +119,28 @@ struct _managed_fd;
  * 		queried for use as input (to the MIDIMonster core) and/or output
  * 		(from the MIDIMonster core) channel (on a per-query basis).
  * 		Returning NULL signals an out-of-memory condition and terminates the program.
+ * 		Also called for running instances when the mappings are reloaded. Channels
+ * 		created with mm_channel for a reload that fails are removed from the core
+ * 		again (see mmbackend_free_channel), other state should thus not depend
+ * 		on the channel being mapped.
+ * 	* (optional) mmbackend_parse_channel_range
+ * 		Create a contiguous block of channels in one call. Used for channel specs
+ * 		containing a single ascending numeric range glob, e.g. `out.{1..512}`.
+ * 		The spec is split into the text before (`prefix`) and after (`suffix`)
+ * 		the glob. The channels for the values `first` to `first + count - 1`
+ * 		are to be stored to the `channels` array in order.
+ * 		Returning anything other than `count` makes the core fall back to
+ * 		calling mmbackend_channel for each element, which should be done
+ * 		for all specs the backend does not want to handle in bulk.
+ * 	* (optional) mmbackend_restore_channel
+ * 		Recreate a channel from its identifier when loading a compiled configuration,
+ * 		instead of parsing the channel-spec again. Only called for instances whose
+ * 		configuration is unchanged since the configuration was compiled. The `flags`
+ * 		parameter contains all directions the channel is mapped in. Backends keeping
+ * 		state for mapped channels that can not be derived from the identifier should
+ * 		not implement this, the core then calls mmbackend_channel with the
+ * 		channel-spec recorded when compiling.
+ * 		Returning NULL fails loading the configuration.
  * 	* mmbackend_start
  * 		Called after all instances have been created and all mappings
  * 		have been set up. Only backends for which instances have been configured
@@ -121,7 +154,8 @@ struct _managed_fd;
  * 			Push generated events to the core with mm_channel_event.
  * 			All registered fds that are ready to read are pushed at once.
  * 			Backends that have not registered any fds are still called with
- * 			nfds set to 0 in order to support polling backends.
+ * 			nfds set to 0 in order to support polling backends, unless they
+ * 			set the mmbackend_no_polling flag in their backend structure.
  * 			Returning a non-zero value signals an error and gracefully terminates
  * 			the program.
  *		* mmbackend_handle_event
@@ -134,6 +168,14 @@ struct _managed_fd;
  *			If not implemented, a maximum interval of one second is used.
  *			Returning 0 signals that the backend does not have a minimum
  *			interval.
+ *			Backends should prefer scheduling their periodic work with
+ *			mm_timer_add, which does not require polling.
+ *		* (optional) mmbackend_timer
+ *			Called once the deadline of a timer registered with mm_timer_add
+ *			has passed. The `inst` argument is the instance the timer was
+ *			registered for (may be NULL).
+ *			Returning a non-zero value signals an error and gracefully terminates
+ *			the program.
  *	* mmbackend_shutdown
  *		Clean up all allocations, finalize all hardware connections. All registered
  *		backends receive the shutdown call, regardless of whether they have been
@@ -143,12 +185,15 @@ struct _managed_fd;
 typedef int (*mmbackend_handle_event)(struct _backend_instance* inst, size_t channels, struct _backend_channel** c, struct _channel_value* v);
 typedef int (*mmbackend_create_instance)(struct _backend_instance* inst);
 typedef struct _backend_channel* (*mmbackend_parse_channel)(struct _backend_instance* instance, char* spec, uint8_t flags);
+typedef size_t (*mmbackend_parse_channel_range)(struct _backend_instance* instance, char* prefix, uint64_t first, size_t count, char* suffix, uint8_t flags, struct _backend_channel** channels);
+typedef struct _backend_channel* (*mmbackend_restore_channel)(struct _backend_instance* instance, uint64_t ident, uint8_t flags);
 typedef void (*mmbackend_free_channel)(struct _backend_channel* c);
 typedef int (*mmbackend_configure)(char* option, char* value);
 typedef int (*mmbackend_configure_instance)(struct _backend_instance* instance, char* option, char* value);
 typedef int (*mmbackend_process_fd)(size_t nfds, struct _managed_fd* fds);
 typedef int (*mmbackend_start)(size_t ninstances, struct _backend_instance** inst);
 typedef uint32_t (*mmbackend_interval)();
+typedef int (*mmbackend_timer)(struct _backend_instance* inst);
 typedef int (*mmbackend_shutdown)(size_t ninstances, struct _backend_instance** inst);
 
 /* Bit masks for the `flags` parameter to mmbackend_parse_channel */
@@ -157,6 +202,30 @@ typedef enum {
 	mmchannel_output = 0x2
 } mmbe_channel_flags;
 
+/* Bit masks for the `flags` member of the backend structure */
+typedef enum {
+	//only call mmbackend_process_fd when registered descriptors are signaled
+	mmbackend_no_polling = 0x1,
+	/*
+	 * The backend may run on a worker thread when the core is configured with multiple threads.
+	 * All callbacks except configuration and shutdown are then called from that thread, and
+	 * all descriptors and timers must be registered from mmbackend_start or later.
+	 * Such backends must not create channels after mmbackend_start.
+	 */
+	mmbackend_shard_safe = 0x2,
+	//setting a channel generates an input event on the same channel (used for loop detection)
+	mmbackend_echo = 0x4,
+	//setting a channel may generate input events on any channel of the instance (used for loop detection)
+	mmbackend_feedback = 0x8,
+	/*
+	 * Together with mmbackend_shard_safe: the instances of the backend do not share any state
+	 * and may be distributed across worker threads individually. mmbackend_start and
+	 * mmbackend_process_fd are then called on every thread running instances of the backend,
+	 * with the instances assigned to that thread and the descriptors registered from it.
+	 */
+	mmbackend_shard_instances = 0x10
+} mmbe_backend_flags;
+
 /* Channel event value, .normalised is used by backends to determine channel values */
 typedef struct _channel_value {
 	union {
@@ -182,28 +251,52 @@ typedef struct /*_mm_backend*/ {
 	mmbackend_shutdown shutdown;
 	mmbackend_free_channel channel_free;
 	mmbackend_interval interval;
+	mmbackend_parse_channel_range channel_range;
+	mmbackend_restore_channel channel_restore;
+	uint32_t flags;
 } backend;
 
+/*
+ * Per-instance traffic counters, reported via the control socket.
+ * Event counters are maintained by the core, backends should update the
+ * byte and packet counters when sending or receiving data for an instance.
+ */
+typedef struct /*_mm_instance_stats*/ {
+	uint64_t events_in;
+	uint64_t events_out;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t packets_in;
+	uint64_t packets_out;
+} instance_stats;
+
 /* 
  * Backend instance structure - do not allocate directly!
  * Use the memory returned by mm_instance()
+ * The `index` member is a dense, core-assigned instance number and
+ * must not be modified by backends.
  */
 typedef struct _backend_instance {
 	backend* backend;
 	uint64_t ident;
 	void* impl;
 	char* name;
+	size_t index;
+	instance_stats stats;
 } instance;
 
 /* 
  * Instance channel structure
  * Backends may either manage their own channel registry or use the global
  * channel store via the mm_channel() API
+ * The `route` member is managed by the core routing graph and must be
+ * initialized to zero and otherwise left untouched by backends.
  */
 typedef struct _backend_channel {
 	instance* instance;
 	uint64_t ident;
 	void* impl;
+	size_t route;
 } channel;
 
 /*
@@ -229,6 +322,21 @@ MM_API int mm_backend_register(backend b);
  */
 MM_API instance* mm_instance_find(char* backend, uint64_t ident);
 
+/*
+ * Builds a hashed lookup table over the current identifiers of all instances
+ * of a backend and returns a token for use with mm_instance_lookup, or 0 on failure.
+ * The table reflects the identifiers at the time of the call, so it should be
+ * requested after all identifiers have been set (e.g. at the end of mmbackend_start).
+ * Calling this function again rebuilds the table and returns the same token.
+ */
+MM_API size_t mm_instance_namespace(char* backend);
+
+/*
+ * Finds an instance by identifier in constant time, using a token returned
+ * by mm_instance_namespace. Behaves like mm_instance_find otherwise.
+ */
+MM_API instance* mm_instance_lookup(size_t token, uint64_t ident);
+
 /*
  * This function is the main interface to the core-provided channel registry.
  * This API is just a convenience function. Creating and managing a
@@ -276,12 +384,36 @@ MM_API int mm_manage_fd(int fd, char* backend, int manage, void* impl);
  */
 MM_API int mm_channel_event(channel* c, channel_value v);
 
+/*
+ * Notifies the core of multiple channel events at once. Equivalent to calling
+ * mm_channel_event for each (c[u], v[u]) pair in order, but reserves event
+ * storage only once. Backends generating many events per input frame
+ * should prefer this API.
+ */
+MM_API int mm_channel_events(size_t n, channel** c, channel_value* v);
+
+/*
+ * Query all channels of the named instance that are the source of a mapping in
+ * the routing graph. Returns 1 if no such instance exists.
+ * *channels will need to be freed by the caller.
+ */
+MM_API int mm_routed_channels(char* name, size_t* n, channel*** channels);
+
 /*
  * Query all active instances for a given backend.
  * *i will need to be freed by the caller.
  */
 MM_API int mm_backend_instances(char* backend, size_t* n, instance*** i);
 
+/*
+ * Query all active instances for a given backend without copying.
+ * *i points into the core instance registry and must neither be modified nor freed.
+ * As instances are only created while parsing the configuration, the list
+ * stays valid from the start callback until the backend has been shut down.
+ * Periodic paths (timers, polling) should prefer this API.
+ */
+MM_API int mm_backend_instances_borrow(char* backend, size_t* n, instance*** i);
+
 /*
  * Query an internal timestamp, which is updated every core iteration.
  * This timestamp should not be used as a performance counter, but can be used
@@ -289,9 +421,30 @@ MM_API int mm_backend_instances(char* backend, size_t* n, instance*** i);
  */
 MM_API uint64_t mm_timestamp();
 
+/*
+ * Query the same internal timestamp as mm_timestamp() in microseconds.
+ * Both timestamps are read from the same monotonic clock sample once per core
+ * iteration. Use this for frame pacing and other timing-sensitive computations.
+ */
+MM_API uint64_t mm_timestamp_us();
+
+/*
+ * Schedule a call to `callback` once mm_timestamp() reaches the absolute
+ * deadline `due` (in milliseconds). Timers are one-shot, periodic work
+ * should re-add the timer from within the callback.
+ * Only one deadline is kept per (inst, callback) tuple, adding an existing
+ * timer moves its deadline. Passing a `due` of 0 cancels a pending timer.
+ * `inst` may be NULL for backend-global timers. Pending timers keep the core
+ * from sleeping past their deadline.
+ */
+MM_API int mm_timer_add(instance* inst, uint64_t due, mmbackend_timer callback);
+
 /*
  * Create a channel-to-channel mapping. This API should not be used by backends.
- * It is only exported for core modules.
+ * It is only exported for core modules. Mappings are compiled into the routing
+ * graph when the core is started, mappings created afterwards are not routed.
+ * The optional value transform chain is owned by the mapping afterwards.
  */
-int mm_map_channel(channel* from, channel* to);
+struct _mm_transform_chain;
+int mm_map_channel(channel* from, channel* to, struct _mm_transform_chain* transform);
 #endif
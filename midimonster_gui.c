@@ -43,7 +43,7 @@ MM_API int log_printf(int level, char* module, char* fmt, ...){
 	int rv = 0;
 	va_list args;
 	va_start(args, fmt);
-	fprintf(stderr, "%s%s\t", level ? "debug/" : "", module);
+	fprintf(stderr, "%s%s\t", (level & MM_LOG_DEBUG) ? "debug/" : "", module);
 	rv = vfprintf(stderr, fmt, args);
 	va_end(args);
 	return rv;